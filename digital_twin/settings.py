@@ -167,12 +167,18 @@ LOGGING = {
 MEDIA_ROOT = Path(BASE_DIR, 'Data')
 MEDIA_URL = '/Data/'  # '/Data/CSV_Dateien/'
 
+# the live material removal simulation runs as long running service (manage.py livemrs). while it is in use, the
+# periodic doCut of task_two must not cut the same cnc rows again
+LIVE_MRS_DAEMON = True
+
 CELERY_BEAT_SCHEDULE = {  # scheduler configuration
-    """ 'Task_one_schedule': {  # whatever the name you want
-        'task': 'live_data.tasks.task_one',  # name of task with path
-        'schedule': 1,
-    }, """
-    'Task_two_schedule': {  # whatever the name you want
+    # 'Task_one_schedule': {  # whatever the name you want
+    #     'task': 'live_data.tasks.task_one',  # name of task with path
+    #     'schedule': 1,
+    # },
+}
+if not LIVE_MRS_DAEMON:
+    CELERY_BEAT_SCHEDULE['Task_two_schedule'] = {  # whatever the name you want
         'task': 'live_data.tasks.task_two',  # name of task with path
         'schedule': 3,
-    }, }
+    }
@@ -32,16 +32,36 @@
 typedef mwMachSimVerifier::float3d float3d;
 typedef mwMachSimVerifier::float2d float2d;
 
+#pragma pack(push, 8)
+// view of a pinned stock mesh of get_stock_mesh, valid until release_mesh
+struct MeshView
+{
+	// num_points xyz float triples, the point array of the mesh itself
+	const float* points;
+	// num_triangles triples of point indices
+	const unsigned int* indices;
+	// num_triangles xyz float face normals
+	const float* normals;
+	unsigned long long num_points;
+	unsigned long long num_triangles;
+};
+#pragma pack(pop)
+// keeps the mesh of a MeshView alive
+struct MeshBuffer;
+
 extern "C" MWCAMSIM_API void init();
 extern "C" MWCAMSIM_API void load_file(char* inputfile);
 extern "C" MWCAMSIM_API void set_precision(float precision);
 extern "C" MWCAMSIM_API void set_stock(char* inputStock);
+extern "C" MWCAMSIM_API void set_stock_cache(char* cache_dir);
 extern "C" MWCAMSIM_API void new_stock(float init_x, float init_y, float init_z, float end_x, float end_y, float end_z, char* location);
 extern "C" MWCAMSIM_API void set_tool(float fDiameter, float fDiameterTop, float fShoulderHeight, float fHeight, int tool_id);
 extern "C" MWCAMSIM_API void set_tool_chamfer(float cDiameter, float cDiameterOut, float cDiameterTop, float cShoulderHeight, float cHeight, float taperangle, int tool_id);
 extern "C" MWCAMSIM_API void set_current_tool(int tool_id);
 extern "C" MWCAMSIM_API void set_visualization(bool visual_mode);
 extern "C" MWCAMSIM_API void export_mesh(char* stlfile);
+extern "C" MWCAMSIM_API MeshBuffer* get_stock_mesh(MeshView* view);
+extern "C" MWCAMSIM_API void release_mesh(MeshBuffer* mesh);
 extern "C" MWCAMSIM_API void DoCut(
 								   float x_start, 
 								   float y_start, 
@@ -58,6 +78,8 @@ extern "C" MWCAMSIM_API void DoCut(
 								   bool isTrace,
 	char* stlPath);
 
+extern "C" MWCAMSIM_API int live_cut(const float* x, const float* y, const float* z, const float* i, const float* j, const float* k, int count);
+
 extern "C" MWCAMSIM_API void cut(float x_start,
 	float y_start,
 	float z_start,
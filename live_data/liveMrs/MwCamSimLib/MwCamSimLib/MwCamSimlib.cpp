@@ -1,5 +1,12 @@
 #include "pch.h"
 #include "MwCamSimLib.h"
+#include "mwChecksum.hpp"
+
+#include <cstdio>
+#include <string>
+
+// bump when the cache key or the stored stock changes its meaning, old entries are then ignored
+#define STOCK_CACHE_VERSION 1
 
 static std::unique_ptr<mwMachSimVerifier> verifier;
 static std::ifstream tool_path_file;
@@ -10,6 +17,12 @@ static GLFWwindow* sim_window;
 static VerifierUtil::SetToolsParameters m_tools;
 // record the number of tools 
 static int num_tool = 0;
+// folder of the cached initial stocks, empty disables the cache
+static std::string stock_cache_dir;
+// tool frame after the last live position, the first position after new_stock only places the tool
+static bool has_live_position = false;
+static float3d live_position;
+static float3d live_orientation(0, 0, 1);
 
 //@brief: init a object of moduleworks machine simulation 
 //@param: void
@@ -17,6 +30,9 @@ static int num_tool = 0;
 void init()  //
 {
 	verifier = mwMachSimVerifier::Create();
+	// the new verifier starts with an empty tool set
+	m_tools.clear();
+	num_tool = 0;
 	std::wcout << L"[\033[1;32mOK\033[0m]  MWCam startup" << std::endl;
 }
 
@@ -64,18 +80,108 @@ void set_stock(char* inputStock)
 
 	misc::mwAutoPointer<cadcam::mwTMesh<float>> pStockMesh(new cadcam::mwTMesh<float>(measures::mwUnitsFactory::METRIC));
 	misc::mwFileName fileName(inputStock);
-	cadcam::mwfSTLTranslator::ReadSTL(fileName, *pStockMesh);
+	if (cadcam::mwfSTLTranslator::IsSTLFileBinary(fileName))
+	{
+		// binary stock files are mapped and decoded in parallel, the shared points are welded afterwards
+		cadcam::mwfSTLTranslator::HeaderData header;
+		cadcam::mwfSTLTranslator::ReadSTLBinaryMapped(fileName, *pStockMesh, header);
+	}
+	else
+	{
+		// ReadSTL already welds the shared points
+		cadcam::mwfSTLTranslator::ReadSTL(fileName, *pStockMesh);
+	}
 	verifier->ForceDataModel(mwMachSimVerifier::MWV_FM_DEXELBLOCK);
 	verifier->SetMesh(pStockMesh);	
 }
 
+//@brief: set the folder of the stock cache. new_stock stores every built stock cube in it and loads
+//        it from there when the same cube is requested again with the same precision and data model
+//@param: cache_dir: existing folder, NULL or empty disables the cache
+//@ret: void
+void set_stock_cache(char* cache_dir)
+{
+	stock_cache_dir = cache_dir ? cache_dir : "";
+}
+
+//@brief: file of a stock cube in the stock cache, named by the md5 of everything the dexel block depends on
+//@param: lowercorner: lower corner of the stock cube
+//@param: uppercorner: upper corner of the stock cube
+//@ret: full path of the cache file
+static std::string stock_cache_file(const float3d& lowercorner, const float3d& uppercorner)
+{
+	const float key[9] = {
+		lowercorner.x(), lowercorner.y(), lowercorner.z(),
+		uppercorner.x(), uppercorner.y(), uppercorner.z(),
+		verifier->GetPrecision(),
+		(float)verifier->GetDataModel(),
+		(float)STOCK_CACHE_VERSION };
+	const std::string hash = misc::mwChecksum::md5Binary(reinterpret_cast<const char*>(key), (unsigned int)sizeof(key));
+	return stock_cache_dir + "\\" + hash + ".stock";
+}
+
+//@brief: creat a stock cube and save its mesh. with a stock cache the dexel block is only built once
+//        per cube, precision and data model
+//@param: init_x: x coordinate of lower corner of workpiece
+//@param: init_y: y coordinate of lower corner of workpiece
+//@param: init_z: z coordinate of lower corner of workpiece
+//@param: end_x: x coordinate of upper corner of workpiece
+//@param: end_y: y coordinate of upper corner of workpiece
+//@param: end_z: z coordinate of upper corner of workpiece
+//@param: location: stl file of the stock mesh, NULL or empty to skip it (see get_stock_mesh)
+//@ret: void
 void new_stock(float init_x, float init_y, float init_z, float end_x, float end_y, float end_z, char* location)
 {
 	float3d lowercorner(init_x, init_y, init_z);
 	float3d uppercorner(end_x, end_y, end_z);
-	std::cout << "[  ]  Configuring the work stock cube(it may takes serveral minutes)...\r";
-	verifier->SetStockCube(lowercorner, uppercorner);
-	std::cout << "[\033[1;32mOK\033[0m]  Configuring the work stock cube(it may takes serveral minutes)    " << std::endl;
+	const std::string cache_file = stock_cache_dir.empty() ? std::string() : stock_cache_file(lowercorner, uppercorner);
+
+	bool is_cached = false;
+	if (!cache_file.empty() && std::ifstream(cache_file, std::ios::binary).good())
+	{
+		try
+		{
+			verifier->LoadStock(misc::mwstring(cache_file.c_str()));
+			is_cached = true;
+			std::cout << "[\033[1;32mOK\033[0m]  Load the work stock cube from the stock cache: " << cache_file << std::endl;
+		}
+		catch (...)
+		{
+			// an entry of an older sdk or a partly written file, it is rebuilt and replaced below
+			std::cout << "\033[1;33mWARNING: Invalid stock cache entry, rebuild the work stock cube\033[0m" << std::endl;
+		}
+	}
+
+	if (!is_cached)
+	{
+		std::cout << "[  ]  Configuring the work stock cube(it may takes serveral minutes)...\r";
+		verifier->SetStockCube(lowercorner, uppercorner);
+		std::cout << "[\033[1;32mOK\033[0m]  Configuring the work stock cube(it may takes serveral minutes)    " << std::endl;
+
+		if (!cache_file.empty())
+		{
+			// write under a temporary name first, so a concurrent run never loads a half written entry
+			const std::string temp_file = cache_file + ".tmp";
+			try
+			{
+				verifier->SaveStock(misc::mwstring(temp_file.c_str()));
+				std::remove(cache_file.c_str());
+				if (std::rename(temp_file.c_str(), cache_file.c_str()) != 0)
+					std::remove(temp_file.c_str());
+			}
+			catch (...)
+			{
+				std::remove(temp_file.c_str());
+				std::cout << "\033[1;33mWARNING: Could not write the stock cache entry " << cache_file << "\033[0m" << std::endl;
+			}
+		}
+	}
+
+	// the live positions of the new stock start a new tool path
+	has_live_position = false;
+
+	if (location == nullptr || location[0] == '\0')
+		return;
 	misc::mwstring startName = location; //"C:\\Users\\Minh\\OneDrive\\MasterThesis\\Skripts\\LiveMRS\\StartMesh.stl";
 	verifier->GetMesh(&startName);
 
@@ -299,6 +405,59 @@ void DoCut(
 	}
 }
 
+//@brief: cut the next positions of the running machine, the tool moves from the last live position
+//        through all of them. the first position after new_stock only places the tool
+//@param: x: TCP x positions in workpiece coordinates (mm)
+//@param: y: TCP y positions in workpiece coordinates (mm)
+//@param: z: TCP z positions in workpiece coordinates (mm)
+//@param: i: x components of the tool vectors, NULL for a vertical tool
+//@param: j: y components of the tool vectors, NULL for a vertical tool
+//@param: k: z components of the tool vectors, NULL for a vertical tool
+//@param: count: number of positions
+//@ret: number of simulated cuts
+int live_cut(const float* x, const float* y, const float* z, const float* i, const float* j, const float* k, int count)
+{
+	int num_cuts = 0;
+	for (int n = 0; n < count; ++n)
+	{
+		const float3d position(x[n], y[n], z[n]);
+		float3d orientation(0, 0, 1);
+		if (i && j && k && (i[n] != 0 || j[n] != 0 || k[n] != 0))
+		{
+			orientation = float3d(i[n], j[n], k[n]);
+			orientation.Normalize();
+		}
+
+		// the machine reports its position every cycle, also while it stands still
+		if (has_live_position && position == live_position && orientation == live_orientation)
+			continue;
+		if (has_live_position)
+		{
+			mwMachSimVerifier::Frame from(
+				live_position,
+				MATH::OrientationToQuaternion<float>(live_orientation, 0)
+			);
+			mwMachSimVerifier::Frame to(
+				position,
+				MATH::OrientationToQuaternion<float>(orientation, 0)
+			);
+			verifier->BufferedCut(from, to);
+			++num_cuts;
+		}
+		live_position = position;
+		live_orientation = orientation;
+		has_live_position = true;
+	}
+
+	// the new positions are simulated together
+	if (num_cuts > 0)
+	{
+		mwMachSimVerifier::VerificationResultVector results;
+		verifier->SimulateBufferedCuts(results);
+	}
+	return num_cuts;
+}
+
 //@brief: calculate engagement analysis and removal volume. record the result 
 //@param: void  
 //@ret: void
@@ -400,6 +559,65 @@ void export_mesh(char* stlfile)
 	std::cout << "*  The generated mesh file is saved in: " << stlfile << std::endl;
 }
 
+// the points are read in place as float triples
+static_assert(sizeof(float3d) == 3 * sizeof(float), "mesh points are expected to be three packed floats");
+
+// the triangles of the mesh also hold their normal indices, so the point indices and face normals are
+// gathered once into flat arrays, the points are handed out in place
+struct MeshBuffer
+{
+	mwMachSimVerifier::MeshPtr mesh;
+	std::vector<unsigned int> indices;
+	std::vector<float> normals;
+};
+
+//@brief: mesh the current stock and hand it over without writing a file
+//@param: view: receives the point, index and normal arrays of the mesh
+//@ret: handle that keeps the arrays alive, pass it to release_mesh. NULL if there is no stock
+MeshBuffer* get_stock_mesh(MeshView* view)
+{
+	mwMachSimVerifier::MeshPtr mesh = verifier->GetMesh();
+	if (mesh.IsNull())
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  The stock could not be meshed" << std::endl;
+		return nullptr;
+	}
+
+	MeshBuffer* buffer = new MeshBuffer();
+	buffer->mesh = mesh;
+	const mwMachSimVerifier::Mesh::pointArray& points = mesh->GetPoints();
+	const mwMachSimVerifier::Mesh::TriangleArray& triangles = mesh->GetTriangles();
+	buffer->indices.resize(triangles.size() * 3);
+	buffer->normals.resize(triangles.size() * 3);
+	for (size_t n = 0; n < triangles.size(); ++n)
+	{
+		size_t first, second, third;
+		triangles[n].GetIndices(first, second, third);
+		buffer->indices[3 * n] = (unsigned int)first;
+		buffer->indices[3 * n + 1] = (unsigned int)second;
+		buffer->indices[3 * n + 2] = (unsigned int)third;
+		const float3d normal = triangles[n].GetNormalVector();
+		buffer->normals[3 * n] = normal.x();
+		buffer->normals[3 * n + 1] = normal.y();
+		buffer->normals[3 * n + 2] = normal.z();
+	}
+
+	view->points = points.empty() ? nullptr : reinterpret_cast<const float*>(&points[0]);
+	view->indices = buffer->indices.empty() ? nullptr : &buffer->indices[0];
+	view->normals = buffer->normals.empty() ? nullptr : &buffer->normals[0];
+	view->num_points = points.size();
+	view->num_triangles = triangles.size();
+	return buffer;
+}
+
+//@brief: release a mesh of get_stock_mesh, its arrays must not be used afterwards
+//@param: mesh: handle of get_stock_mesh, NULL is ignored
+//@ret: void
+void release_mesh(MeshBuffer* mesh)
+{
+	delete mesh;
+}
+
 
 //@brief: configurate the animation scene  
 //@param: void  
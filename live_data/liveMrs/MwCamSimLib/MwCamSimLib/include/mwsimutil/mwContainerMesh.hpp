@@ -16,8 +16,12 @@
 #include "mwLanguageFeatures.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 #include <vector>
+#ifndef MW_USE_VS2008_COMPATIBILITY
+#include <thread>
+#endif
 
 #ifndef MW_FORCEINLINE
 #if defined(_WIN32)
@@ -32,6 +36,8 @@ namespace cadcam
 #pragma CACHING_INTERNAL_BEGIN
 template <typename T, typename _TVertex, typename _TFaceNormal>
 class mwContainerMesh;
+template <typename T, typename TVertex, typename TFaceNormal>
+class MW_5AXUTIL_API mwTSTLTranslator;
 
 /// type definitions for mwContainerMesh
 template <typename T, typename _TVertex = mwTPoint3d<T>, typename _TFaceNormal = mwTPoint3d<T>>
@@ -306,8 +312,14 @@ public:
 		const TVertex& pt1, const TVertex& pt2, const T fEpsilon = (T)(1e-12 * 1e-12));
 	inline static bool RemoveDegeneratedTrianglePredicate(const Triangle& t);
 	inline void RemoveDuplicatesSlow(const T fEpsilon = (T)(1e-12 * 1e-12));
+#ifndef MW_USE_VS2008_COMPATIBILITY
+	inline void RemoveDuplicates(const T fEpsilon = (T)(1e-12 * 1e-12), const unsigned numThreads = 0);
+#endif
 	inline void GarbageCollect();
 	inline virtual void SetTriangles(const TriangleVector& triVectToSet);
+#ifndef MW_USE_VS2008_COMPATIBILITY
+	inline void SetTrianglesRadixSort(const TriangleVector& triVectToSet, const unsigned numThreads = 0);
+#endif
 	inline const TVertex& GetTriangleFirstVertexData(const size_t szTriangle) const;
 	inline const TVertex& GetTriangleSecondVertexData(const size_t szTriangle) const;
 	inline const TVertex& GetTriangleThirdVertexData(const size_t szTriangle) const;
@@ -389,6 +401,18 @@ protected:
 	inline void RemapTrianglePointIndices(
 		const TriangleIt& first, const TriangleIt& last, const std::vector<unsigned>& indexMap);
 
+	// thread helpers of the mesh algorithms, the STL reader fills meshes with them too
+#ifndef MW_USE_VS2008_COMPATIBILITY
+	inline static size_t GetChunkCount(const size_t count, const unsigned numThreads);
+	template <class Func>
+	inline static void ForEachChunk(const size_t chunkCount, const Func& func);
+	template <class Func>
+	inline static void ForEachRange(const size_t count, const unsigned numThreads, const Func& func);
+
+	template <typename, typename, typename>
+	friend class mwTSTLTranslator;
+#endif
+
 #pragma warning(suppress : 4251)  // needs to have dll-interface to be used by clients of class
 	misc::mwAutoPointer<TriangleArray> mTriangles;
 #pragma warning(suppress : 4251)  // needs to have dll-interface to be used by clients of class
@@ -401,6 +425,9 @@ private:
 	template <class Value>
 	inline void ReserveAndReallocate(std::vector<Value>& array, size_t newCapacity);
 	inline void RecalculateNormalsForATriangleNoCheck(const size_t szTriangle);
+#ifndef MW_USE_VS2008_COMPATIBILITY
+	inline static unsigned long long HashCell(long long x, long long y, long long z);
+#endif
 	// the sorting predicated
 	class SortPred
 	{
@@ -2218,6 +2245,188 @@ inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::SetTriangles(
 		}
 	}
 }
+#ifndef MW_USE_VS2008_COMPATIBILITY
+/// Set Triangles from the given array of triangles to current mesh, for large triangle soups
+///
+/// Same as SetTriangles, but the repeated points are found without comparing points. Every point
+/// is quantized to the point coordinate precision of triVectToSet and its (x, y, z) key is sorted
+/// together with its index by a parallel LSD radix sort. Points of equal key become one point, the
+/// first of them in triVectToSet is kept. Unlike the tolerance based sort of SetTriangles, two
+/// points closer than the precision are merged only if they round to the same key. If the
+/// coordinates are too large for 32 bit keys at this precision, the quantization step is coarsened
+/// to the largest coordinate / 2^30. The result does not depend on the number of threads. Below
+/// 65536 points the counters of the radix passes cost more than they save, such triangle vectors
+/// are set with SetTriangles.
+/// @param triVectToSet triangles to set
+/// @param numThreads threads of the quantization, sort and remapping, 0 for one per core
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::SetTrianglesRadixSort(
+	const TriangleVector& triVectToSet, const unsigned numThreads)
+{
+	if (triVectToSet.GetNumberOfTriangles() <= 0)
+	{
+		ResetMesh();
+		return;
+	}
+
+	const size_t minRadixSortPoints = 65536;
+	if (triVectToSet.mVertex->size() < minRadixSortPoints)
+	{
+		SetTriangles(triVectToSet);
+		return;
+	}
+
+	// obtain precision
+	mPointCoordPrec = triVectToSet.mPointCoordPrec;
+
+	const pointArray& vertices = *(triVectToSet.mVertex);
+	const size_t size = vertices.size();
+
+	// quantization step: the precision, but coarse enough for 32 bit keys
+	double maxCoord = 0;
+	for (size_t idx = 0; idx < size; ++idx)
+	{
+		const double coords[3] = {
+			(double)vertices[idx].x(), (double)vertices[idx].y(), (double)vertices[idx].z()};
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double absCoord = coords[axis] < 0 ? -coords[axis] : coords[axis];
+			maxCoord = absCoord > maxCoord ? absCoord : maxCoord;
+		}
+	}
+	double step = (double)mPointCoordPrec;
+	const double minStep = maxCoord / 1073741824.0;
+	step = step > minStep ? step : minStep;
+	step = step > 0 ? step : 1;
+	const double invStep = 1 / step;
+
+	// sort entries: the quantized coordinates (biased to unsigned, x most significant) and the
+	// index of the point in triVectToSet
+	struct SortEntry
+	{
+		unsigned key[3];
+		unsigned index;
+	};
+	std::vector<SortEntry> entries(size);
+	std::vector<SortEntry> sorted(size);
+	ForEachRange(size, numThreads, [&](size_t begin, size_t end) {
+		for (size_t idx = begin; idx < end; ++idx)
+		{
+			const double coords[3] = {
+				(double)vertices[idx].x(), (double)vertices[idx].y(), (double)vertices[idx].z()};
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				entries[idx].key[axis] =
+					(unsigned)((long long)std::floor(coords[axis] * invStep + 0.5) + 2147483648LL);
+			}
+			entries[idx].index = (unsigned)idx;
+		}
+	});
+
+	// LSD radix sort by 16 bit digits, from the low half of z to the high half of x. every chunk
+	// counts its digits, then scatters its entries to its own offsets, which keeps the sort stable
+	const size_t digitCount = 1 << 16;
+	const size_t chunkCount = GetChunkCount(size, numThreads);
+	std::vector<unsigned> chunkOffsets(chunkCount * digitCount);
+	for (int pass = 0; pass < 6; ++pass)
+	{
+		const int axis = 2 - pass / 2;
+		const int shift = (pass % 2) * 16;
+		ForEachChunk(chunkCount, [&](size_t chunk) {
+			unsigned* counts = &chunkOffsets[chunk * digitCount];
+			std::fill(counts, counts + digitCount, 0u);
+			const size_t end = size * (chunk + 1) / chunkCount;
+			for (size_t idx = size * chunk / chunkCount; idx < end; ++idx)
+				++counts[(entries[idx].key[axis] >> shift) & 0xFFFF];
+		});
+
+		// a digit all entries share does not reorder anything
+		const unsigned firstDigit = (entries[0].key[axis] >> shift) & 0xFFFF;
+		size_t firstDigitCount = 0;
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			firstDigitCount += chunkOffsets[chunk * digitCount + firstDigit];
+		if (firstDigitCount == size)
+			continue;
+
+		unsigned offset = 0;
+		for (size_t digit = 0; digit < digitCount; ++digit)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				const unsigned count = chunkOffsets[chunk * digitCount + digit];
+				chunkOffsets[chunk * digitCount + digit] = offset;
+				offset += count;
+			}
+		}
+
+		ForEachChunk(chunkCount, [&](size_t chunk) {
+			unsigned* offsets = &chunkOffsets[chunk * digitCount];
+			const size_t end = size * (chunk + 1) / chunkCount;
+			for (size_t idx = size * chunk / chunkCount; idx < end; ++idx)
+				sorted[offsets[(entries[idx].key[axis] >> shift) & 0xFFFF]++] = entries[idx];
+		});
+		entries.swap(sorted);
+	}
+
+	// runs of equal keys become one point, the first entry of a run has the lowest index
+	std::vector<unsigned> oldIdx2NewIdx(size);
+	std::vector<unsigned> firstOfRun;
+	firstOfRun.reserve(size);
+	for (size_t idx = 0; idx < size; ++idx)
+	{
+		if (idx == 0 || entries[idx].key[0] != entries[idx - 1].key[0] ||
+			entries[idx].key[1] != entries[idx - 1].key[1] ||
+			entries[idx].key[2] != entries[idx - 1].key[2])
+		{
+			firstOfRun.push_back(entries[idx].index);
+		}
+		oldIdx2NewIdx[entries[idx].index] = (unsigned)(firstOfRun.size() - 1);
+	}
+
+	{
+		bool shareTrianglesPointer =
+			(mTriangles.operator->() == triVectToSet.mTriangles.operator->());
+		if (!shareTrianglesPointer)
+		{
+			// create a copy of triangles
+			mTriangles = new TriangleArray(*triVectToSet.mTriangles);
+		}
+
+		// map the triangle point indices to the new indices of points
+		ForEachRange(mTriangles->size(), numThreads, [&](size_t begin, size_t end) {
+			RemapTrianglePointIndices(
+				mTriangles->begin() + begin, mTriangles->begin() + end, oldIdx2NewIdx);
+		});
+	}
+
+	{
+		// copy the different points to new pointArray
+		bool sharePointsPointer =
+			(mPoints.operator->() == triVectToSet.mVertex.operator->());
+
+		misc::mwAutoPointer<pointArray> differentPoints(new pointArray(firstOfRun.size()));
+		for (size_t idx = 0; idx < firstOfRun.size(); ++idx)
+			(*differentPoints)[idx] = vertices[firstOfRun[idx]];
+		if (sharePointsPointer)
+			mPoints = differentPoints;
+		else
+			mPoints->swap(*differentPoints);
+	}
+
+	{
+		bool shareNormalsPointer =
+			(mNormals.operator->() == triVectToSet.mNormals.operator->());
+		if (!shareNormalsPointer)
+		{
+			// copy the normals
+			mNormals = new normalArray(*triVectToSet.mNormals);
+		}
+	}
+}
+#endif
 /// Remove repeated points in mPoints and updates mTriangles
 ///
 /// Removes points considered to be equal according to PointsCloseEnough
@@ -2333,6 +2542,248 @@ inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::RemoveDuplicatesSlow(con
 	// replace the points vector by the new one
 	mPoints->swap(unreferencedFree);
 }
+#ifndef MW_USE_VS2008_COMPATIBILITY
+/// Remove repeated points in mPoints and updates mTriangles in linear time
+///
+/// Replacement of RemoveDuplicatesSlow for large meshes. The points are sorted into a hashed grid
+/// whose cells are as large as the welding distance, so the points close enough to a point are
+/// found in its own and the 26 neighbor cells. Every point is merged into the point of lowest index
+/// that is close enough to it (or into the point that one was merged into), the kept points stay in
+/// their original order. The result does not depend on the number of threads and is the same as the
+/// one of RemoveDuplicatesSlow for exactly repeated points. Degenerated triangles and points no
+/// triangle uses are removed as well.
+/// @param fEpsilon square of the minimum distance between points to be considered close enough to
+/// be considered equal
+/// @param numThreads threads used for the grid lookups and the remapping, 0 for one per core
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::RemoveDuplicates(
+	const T fEpsilon, const unsigned numThreads)
+{
+	const pointArray& points = *mPoints;
+	const size_t initPointCount = points.size();
+	if (initPointCount == 0)
+		return;
+
+	// cell size: the welding distance (with a margin for the rounding of the cell coordinates), but
+	// at least so coarse that no cell coordinate exceeds 2^32
+	double maxCoord = 0;
+	for (size_t idx = 0; idx < initPointCount; ++idx)
+	{
+		const double coords[3] = {
+			(double)points[idx].x(), (double)points[idx].y(), (double)points[idx].z()};
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double absCoord = coords[axis] < 0 ? -coords[axis] : coords[axis];
+			maxCoord = absCoord > maxCoord ? absCoord : maxCoord;
+		}
+	}
+	double cellSize = fEpsilon > 0 ? std::sqrt((double)fEpsilon) * 1.001 : 0;
+	const double minCellSize = maxCoord / 4294967296.0;
+	cellSize = cellSize > minCellSize ? cellSize : minCellSize;
+	cellSize = cellSize > 0 ? cellSize : 1;
+	const double invCellSize = 1 / cellSize;
+
+	// hashed grid: the points of a bucket are listed in ascending order in
+	// bucketPoints[bucketBegin[bucket], bucketBegin[bucket + 1])
+	size_t bucketCount = 1;
+	while (bucketCount < initPointCount)
+		bucketCount <<= 1;
+	const unsigned long long bucketMask = bucketCount - 1;
+	std::vector<unsigned> pointBucket(initPointCount);
+	ForEachRange(initPointCount, numThreads, [&](size_t begin, size_t end) {
+		for (size_t idx = begin; idx < end; ++idx)
+		{
+			pointBucket[idx] = (unsigned)(
+				HashCell(
+					(long long)std::floor(points[idx].x() * invCellSize),
+					(long long)std::floor(points[idx].y() * invCellSize),
+					(long long)std::floor(points[idx].z() * invCellSize)) &
+				bucketMask);
+		}
+	});
+	std::vector<unsigned> bucketBegin(bucketCount + 1, 0);
+	for (size_t idx = 0; idx < initPointCount; ++idx)
+		++bucketBegin[pointBucket[idx] + 1];
+	for (size_t bucket = 0; bucket < bucketCount; ++bucket)
+		bucketBegin[bucket + 1] += bucketBegin[bucket];
+	std::vector<unsigned> bucketPoints(initPointCount);
+	{
+		std::vector<unsigned> bucketFill(bucketBegin.begin(), bucketBegin.end() - 1);
+		for (size_t idx = 0; idx < initPointCount; ++idx)
+			bucketPoints[bucketFill[pointBucket[idx]]++] = (unsigned)idx;
+	}
+
+	// lowest point index close enough to every point, a point is never merged into a later one
+	std::vector<unsigned> indexMap(initPointCount);
+	ForEachRange(initPointCount, numThreads, [&](size_t begin, size_t end) {
+		for (size_t idx = begin; idx < end; ++idx)
+		{
+			const long long cellX = (long long)std::floor(points[idx].x() * invCellSize);
+			const long long cellY = (long long)std::floor(points[idx].y() * invCellSize);
+			const long long cellZ = (long long)std::floor(points[idx].z() * invCellSize);
+			unsigned lowest = (unsigned)idx;
+			for (long long dx = -1; dx <= 1; ++dx)
+			{
+				for (long long dy = -1; dy <= 1; ++dy)
+				{
+					for (long long dz = -1; dz <= 1; ++dz)
+					{
+						const size_t bucket =
+							(size_t)(HashCell(cellX + dx, cellY + dy, cellZ + dz) & bucketMask);
+						// the bucket is sorted, the first close point is its lowest one
+						for (unsigned entry = bucketBegin[bucket];
+							 entry < bucketBegin[bucket + 1] && bucketPoints[entry] < lowest;
+							 ++entry)
+						{
+							if (PointsCloseEnough(points[idx], points[bucketPoints[entry]], fEpsilon))
+							{
+								lowest = bucketPoints[entry];
+								break;
+							}
+						}
+					}
+				}
+			}
+			indexMap[idx] = lowest;
+		}
+	});
+
+	// follow the merges, the kept point of a lower index is already known
+	bool hadDuplicates = false;
+	for (size_t idx = 0; idx < initPointCount; ++idx)
+	{
+		if (indexMap[idx] != idx)
+		{
+			indexMap[idx] = indexMap[indexMap[idx]];
+			hadDuplicates = true;
+		}
+	}
+	if (hadDuplicates)
+	{
+		ForEachRange(mTriangles->size(), numThreads, [&](size_t begin, size_t end) {
+			RemapTrianglePointIndices(
+				mTriangles->begin() + begin, mTriangles->begin() + end, indexMap);
+		});
+	}
+
+	/// erase possible degenerate triangles
+	mTriangles->erase(
+		std::remove_if(mTriangles->begin(), mTriangles->end(), RemoveDegeneratedTrianglePredicate),
+		mTriangles->end());
+
+	// keep the referenced points, which are only the kept ones after the merge
+	std::vector<bool> isReferenced(initPointCount, false);
+	typename TriangleArray::iterator triEnd = mTriangles->end();
+	for (typename TriangleArray::iterator tri = mTriangles->begin(); tri != triEnd; ++tri)
+	{
+		isReferenced[tri->GetFirstPointIndex()] = true;
+		isReferenced[tri->GetSecondPointIndex()] = true;
+		isReferenced[tri->GetThirdPointIndex()] = true;
+	}
+
+	std::vector<TVertex> duplicateFree;
+	duplicateFree.reserve(initPointCount);
+	for (size_t idx = 0; idx < initPointCount; ++idx)
+	{
+		if (isReferenced[idx])
+		{
+			indexMap[idx] = (unsigned)duplicateFree.size();
+			duplicateFree.push_back(points[idx]);
+		}
+	}
+
+	ForEachRange(mTriangles->size(), numThreads, [&](size_t begin, size_t end) {
+		RemapTrianglePointIndices(mTriangles->begin() + begin, mTriangles->begin() + end, indexMap);
+	});
+
+	// replace the points vector by the new one
+	mPoints->swap(duplicateFree);
+}
+/// Number of chunks a parallel loop over count elements is split into
+///
+/// @param count number of elements
+/// @param numThreads number of threads, 0 for one per core
+/// @return one chunk per thread, but fewer if the chunks would be too small to pay for their thread
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+inline size_t mwContainerMesh<T, _TVertex, _TFaceNormal>::GetChunkCount(
+	const size_t count, const unsigned numThreads)
+{
+	// below this many elements per thread, starting the thread costs more than it saves
+	const size_t minRange = 16384;
+	size_t chunkCount = numThreads ? numThreads : std::thread::hardware_concurrency();
+	const size_t maxChunks = count / minRange;
+	chunkCount = chunkCount < maxChunks ? chunkCount : maxChunks;
+	return chunkCount ? chunkCount : 1;
+}
+/// Run a function once per chunk, each chunk on its own thread
+///
+/// @param chunkCount number of chunks, the last one runs on the calling thread
+/// @param func called as func(chunk)
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+template <class Func>
+inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::ForEachChunk(
+	const size_t chunkCount, const Func& func)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(chunkCount);
+	for (size_t chunk = 0; chunk + 1 < chunkCount; ++chunk)
+		threads.emplace_back(func, chunk);
+	if (chunkCount)
+		func(chunkCount - 1);
+	for (size_t thread = 0; thread < threads.size(); ++thread)
+		threads[thread].join();
+}
+/// Run a function on consecutive ranges of [0, count)
+///
+/// The ranges are split evenly across the threads, small counts are run on the calling thread.
+/// @param count number of elements
+/// @param numThreads number of threads, 0 for one per core
+/// @param func called as func(begin, end) once per range
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+template <class Func>
+inline void mwContainerMesh<T, _TVertex, _TFaceNormal>::ForEachRange(
+	const size_t count, const unsigned numThreads, const Func& func)
+{
+	const size_t chunkCount = GetChunkCount(count, numThreads);
+	if (chunkCount < 2)
+	{
+		func((size_t)0, count);
+		return;
+	}
+	ForEachChunk(chunkCount, [&](size_t chunk) {
+		func(count * chunk / chunkCount, count * (chunk + 1) / chunkCount);
+	});
+}
+/// Hash of a grid cell of RemoveDuplicates
+///
+/// @param x,y,z cell coordinates
+template <
+	typename T,
+	typename _TVertex /*= mwTPoint3d<T>*/,
+	typename _TFaceNormal /*= mwTPoint3d<T> */>
+inline unsigned long long mwContainerMesh<T, _TVertex, _TFaceNormal>::HashCell(
+	long long x, long long y, long long z)
+{
+	unsigned long long hash = (unsigned long long)x * 0x9E3779B97F4A7C15ULL ^
+		(unsigned long long)y * 0xC2B2AE3D27D4EB4FULL ^ (unsigned long long)z * 0x165667B19E3779F9ULL;
+	hash ^= hash >> 31;
+	hash *= 0xBF58476D1CE4E5B9ULL;
+	hash ^= hash >> 29;
+	return hash;
+}
+#endif
 template <
 	typename T,
 	typename _TVertex /*= mwTPoint3d<T>*/,
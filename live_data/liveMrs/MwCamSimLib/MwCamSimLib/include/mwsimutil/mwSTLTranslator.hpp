@@ -7,6 +7,7 @@
 #include "mwFileName.hpp"
 #include "mwFileStream.hpp"
 #include "mwFileSystem.hpp"
+#include "mwMappedFile.hpp"
 #include "mwMesh.hpp"
 #include "mwParserSTL.hpp"
 #include "mwSTLFile.hpp"
@@ -18,7 +19,11 @@
 #include "mwmiscException.hpp"
 #include "mwWarningPragmas.hpp"
 
+#include <cstring>
 #include <fstream>
+#ifndef MW_USE_VS2008_COMPATIBILITY
+#include <exception>
+#endif
 
 
 #ifndef MW_FORCEINLINE
@@ -180,6 +185,27 @@ public:
 		bool compressMesh = true,
 		UpdateHandlerPtr updateHandler = UpdateHandlerPtr());
 
+#ifndef MW_USE_VS2008_COMPATIBILITY
+	/// Read STL binary mapped
+	///
+	/// Reads a binary STL file through a memory mapping. The triangle records are decoded in
+	/// parallel straight into the point and triangle arrays of the mesh, the points shared by
+	/// several triangles are welded afterwards by Mesh::SetTrianglesRadixSort.
+	///	@param fileName the name of the external file, it has to be a binary STL
+	///	@param mesh reference to the mesh that will be created
+	///	@param header header data struct
+	///	@param useFileNormals use the facet normals of the file instead of computing them
+	///	@param compressMesh weld the points shared by several triangles
+	///	@param numThreads number of threads, 0 for one per core
+	inline static void ReadSTLBinaryMapped(
+		const misc::mwFileName& fileName,
+		Mesh& mesh,
+		HeaderData& header,
+		bool useFileNormals = true,
+		bool compressMesh = true,
+		const unsigned numThreads = 0);
+#endif
+
 	/// Write STL
 	///
 	/// Writers an existing mesh to an external file, in STL format
@@ -512,6 +538,120 @@ inline void mwTSTLTranslator<T, TVertex, TFaceNormal>::ReadSTL(
 }
 
 
+#ifndef MW_USE_VS2008_COMPATIBILITY
+template <typename T, typename TVertex, typename TFaceNormal>
+inline void mwTSTLTranslator<T, TVertex, TFaceNormal>::ReadSTLBinaryMapped(
+	const misc::mwFileName& fileName,
+	Mesh& mesh,
+	HeaderData& header,
+	bool useFileNormals,
+	bool compressMesh,
+	const unsigned numThreads)
+{
+	misc::mwMappedFile file;
+	if (!file.Open(fileName))
+	{
+		throw mwSTLParserException(mwSTLParserException::FILE_OPEN_ERROR);
+	}
+
+	// header, triangle count and per triangle the normal, three points and a 2 byte attribute
+	const size_t countSize = sizeof(unsigned int);
+	const size_t recordSize = 12 * sizeof(float) + 2;
+	if (file.GetSize() < g_stlHeaderLength + countSize)
+	{
+		throw mwSTLParserException(mwSTLParserException::INVALID_FILE_FORMAT);
+	}
+	const char* data = file.GetData();
+	unsigned int fileTriangles = 0;
+	memcpy(&fileTriangles, data + g_stlHeaderLength, countSize);
+	if ((file.GetSize() - g_stlHeaderLength - countSize) / recordSize < fileTriangles)
+	{
+		throw mwSTLParserException(mwSTLParserException::INVALID_NUMBER_OF_TRIANGLES);
+	}
+	ParseBinaryHeader(data, header);
+	const char* records = data + g_stlHeaderLength + countSize;
+
+	// degenerated triangles are skipped like TriangleVector::AddTriangle does. every chunk counts
+	// its triangles in the first pass and decodes them behind the ones of the previous chunks in the
+	// second pass, so the arrays are allocated once and the triangles keep the file order
+	TriangleVector triangleCheck;  // IsTriangle only reads the precision, it is shared by the threads
+	misc::mwAutoPointer<typename Mesh::pointArray> points = new typename Mesh::pointArray();
+	misc::mwAutoPointer<typename Mesh::TriangleArray> triangles = new typename Mesh::TriangleArray();
+	const size_t chunkCount = Mesh::GetChunkCount(fileTriangles, numThreads);
+	std::vector<size_t> chunkBegin(chunkCount + 1, 0);
+	std::vector<std::exception_ptr> chunkErrors(chunkCount);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 1)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+				chunkBegin[chunk + 1] += chunkBegin[chunk];
+			points->resize(3 * chunkBegin[chunkCount]);
+			triangles->resize(chunkBegin[chunkCount]);
+		}
+		Mesh::ForEachChunk(chunkCount, [&](size_t chunk) {
+			try
+			{
+				size_t next = chunkBegin[chunk];
+				size_t validTriangles = 0;
+				const size_t last = fileTriangles * (chunk + 1) / chunkCount;
+				for (size_t tri = fileTriangles * chunk / chunkCount; tri < last; ++tri)
+				{
+					float buffer[12];
+					memcpy(buffer, records + tri * recordSize, sizeof(buffer));
+					point3d normal, point1, point2, point3;
+					ReadPointFromBuffer(point1, buffer, 3);
+					ReadPointFromBuffer(point2, buffer, 6);
+					ReadPointFromBuffer(point3, buffer, 9);
+					if (!triangleCheck.IsTriangle(point1, point2, point3))
+						continue;
+					if (pass == 0)
+					{
+						++validTriangles;
+						continue;
+					}
+
+					if (useFileNormals)
+						ReadPointFromBuffer(normal, buffer, 0);
+					else
+						normal = (point3 - point2) % (point1 - point2);
+					(*points)[3 * next] = point1;
+					(*points)[3 * next + 1] = point2;
+					(*points)[3 * next + 2] = point3;
+					(*triangles)[next] =
+						typename Mesh::Triangle(3 * next, 3 * next + 1, 3 * next + 2, normal);
+					++next;
+				}
+				if (pass == 0)
+					chunkBegin[chunk + 1] = validTriangles;
+			}
+			catch (...)
+			{
+				chunkErrors[chunk] = std::current_exception();
+			}
+		});
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			if (chunkErrors[chunk])
+				std::rethrow_exception(chunkErrors[chunk]);
+		}
+	}
+	file.Close();
+
+	mesh.ResetMesh();
+	mesh.SetTriangles(points, triangles);
+	if (compressMesh)
+	{
+		// the triangle vector shares the arrays of the mesh, so they are welded in place
+		TriangleVector soup;
+		soup.mVertex = points;
+		soup.mTriangles = triangles;
+		mesh.SetTrianglesRadixSort(soup, numThreads);
+	}
+}
+#endif
+
+
 #ifdef _WIN32
 template <typename T, typename TVertex, typename TFaceNormal>
 inline void mwTSTLTranslator<T, TVertex, TFaceNormal>::WriteSTL(
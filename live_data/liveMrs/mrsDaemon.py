@@ -0,0 +1,114 @@
+from ..models import Prog, Wcs, LiveMrs, Cnc
+from django.db.models import F
+from live_data.liveMrs.mwWrapper import loadLibrary, newStock, setTool, liveCut, stockStl
+import time
+from django.core.files.base import ContentFile
+
+# machine positions of the cnc table are stored in 1/10000 mm
+POSITION_SCALE = 10000.
+# stand-in tool of the live simulation until the tool table is tracked live (mm)
+LIVE_TOOL = {"diameter": 10., "diameterTop": 10., "shoulderHeight": 40., "height": 30.}
+
+
+class MrsDaemon:
+    """
+    long running live material removal simulation. it keeps one verifier warm for the active program, cuts the new
+    cnc positions since the last poll and publishes the stock as LiveMrs entry at a bounded rate
+    """
+
+    def __init__(self, pollInterval=0.5, publishInterval=5., batchSize=5000):
+        """
+        :param pollInterval: float, seconds between two polls of the cnc table
+        :param publishInterval: float, minimum seconds between two published stock meshes
+        :param batchSize: int, maximum number of cnc rows cut per poll
+        """
+        self.mw_dll = loadLibrary()
+        self.pollInterval = pollInterval
+        self.publishInterval = publishInterval
+        self.batchSize = batchSize
+        # timestamp of the program the stock belongs to and of the last cut cnc row
+        self.progTimestamp = None
+        self.progName = None
+        self.lastTimestamp = None
+        # workpiece origin in machine coordinates
+        self.origin = (0., 0., 0.)
+        self.lastPublish = 0.
+        self.isDirty = False
+        # false while the active program has no raw stock, its cnc rows are not cut
+        self.hasStock = False
+
+    def run(self):
+        while True:
+            try:
+                self.step()
+            except Exception as e:
+                # a broken poll must not end the service, the next poll starts from the last cut row
+                print("Live MRS step failed: ", e)
+            time.sleep(self.pollInterval)
+
+    def step(self):
+        lastProg = Prog.objects.exclude(programname="none").last()
+        if lastProg is None:
+            return
+        if lastProg.timestamp != self.progTimestamp:
+            self.startProgram(lastProg)
+        if not self.hasStock:
+            return
+
+        rows = list(Cnc.objects.filter(timestamp__gt=self.lastTimestamp).order_by("timestamp").values_list(
+            "timestamp", "xcurrpos", "ycurrpos", "zcurrpos", "tbvec0", "tbvec1", "tbvec2")[:self.batchSize])
+        if rows:
+            self.lastTimestamp = rows[-1][0]
+            positions = []
+            orientations = []
+            for timestamp, x, y, z, i, j, k in rows:
+                if x is None or y is None or z is None:
+                    continue
+                positions.append((x / POSITION_SCALE - self.origin[0],
+                                  y / POSITION_SCALE - self.origin[1],
+                                  z / POSITION_SCALE - self.origin[2]))
+                orientations.append((i or 0, j or 0, k or 0))
+            if liveCut(self.mw_dll, positions, orientations) > 0:
+                self.isDirty = True
+
+        if self.isDirty and time.monotonic() - self.lastPublish >= self.publishInterval:
+            self.publish()
+
+    def startProgram(self, prog):
+        """
+        set up the raw stock of a new program and publish it, the cnc rows before its start are not cut
+        :param prog: Prog, latest program
+        :return: None
+        """
+        self.hasStock = False
+        wcs = Wcs.objects.filter(timestamp__lt=prog.timestamp).order_by(
+            F('timestamp').desc()).first()
+        if wcs is None:
+            # the program is remembered, so the warning is not repeated on every poll
+            self.progTimestamp = prog.timestamp
+            self.progName = prog.programname
+            print("WARNING: Live MRS found no work coordinate system before program ", self.progName,
+                  ", its cnc rows are not cut")
+            return
+        newStock(self.mw_dll, wcs.minedgex, wcs.minedgey, wcs.minedgez,
+                 wcs.maxedgex, wcs.maxedgey, wcs.maxedgez)
+        setTool(self.mw_dll, **LIVE_TOOL)
+        self.origin = (wcs.x, wcs.y, wcs.z)
+        self.progTimestamp = prog.timestamp
+        self.progName = prog.programname
+        self.lastTimestamp = prog.timestamp
+        self.hasStock = True
+        print("Live MRS follows program ", self.progName)
+        # the raw stock is shown until the first cut is published
+        self.publish()
+
+    def publish(self):
+        currentTimestamp = round(time.time() * 1000)
+        fileName = str(currentTimestamp) + "_" + str(self.progName) + ".stl"
+        # the stock is handed over in memory, no temporary stl file is written
+        stl = stockStl(self.mw_dll)
+        if stl is not None:
+            LiveMrs.objects.create(timestamp=currentTimestamp,
+                                   stlFile=ContentFile(stl, name=fileName), programname=self.progName)
+        self.lastPublish = time.monotonic()
+        self.isDirty = False
@@ -2,6 +2,7 @@ import ctypes as ct
 from ctypes import *
 import time
 import pathlib
+import numpy as np
 from django.conf import settings
 
 
@@ -26,23 +27,107 @@ def doCut():
     mw_dll.cut(x_start_c, y_start_c, z_start_c, x_end_c, y_end_c, z_end_c)
 
 
-def createStock(xStart, yStart, zStart, xEnd, yEnd, zEnd, location):
+def loadLibrary():
     libraryPath = pathlib.Path(settings.BASE_DIR, "live_data",
                                "liveMrs", "MwCamSimLib", "x64", "Debug", "MwCamSimLib.dll")
-    location_c = ct.c_char_p(str(location).encode())
+    return ct.cdll.LoadLibrary(str(libraryPath))
+
+
+def newStock(mw_dll, xStart, yStart, zStart, xEnd, yEnd, zEnd, location=None, precision=1):
+    # without a location the start mesh is not written, getStockMesh hands it over in memory
+    location_c = ct.c_char_p(None if location is None else str(location).encode())
     x_start_c = ct.c_float(xStart)
     y_start_c = ct.c_float(yStart)
     z_start_c = ct.c_float(zStart)
     x_end_c = ct.c_float(xEnd)
     y_end_c = ct.c_float(yEnd)
     z_end_c = ct.c_float(zEnd)
-    mw_dll = ct.cdll.LoadLibrary(str(libraryPath))
     mw_dll.init()
-    mw_dll.set_precision(ct.c_float(1))
+    mw_dll.set_precision(ct.c_float(precision))
+    # the dexel block of a stock cube is built once per cube and precision, later calls load it from the cache
+    stockCache = pathlib.Path(settings.MEDIA_ROOT) / "stock_cache"
+    stockCache.mkdir(parents=True, exist_ok=True)
+    mw_dll.set_stock_cache(ct.c_char_p(str(stockCache).encode()))
     mw_dll.new_stock(x_start_c, y_start_c, z_start_c,
                      x_end_c, y_end_c, z_end_c, location_c)
 
 
+def createStock(xStart, yStart, zStart, xEnd, yEnd, zEnd, location):
+    mw_dll = loadLibrary()
+    newStock(mw_dll, xStart, yStart, zStart, xEnd, yEnd, zEnd, location)
+
+
+def setTool(mw_dll, diameter, diameterTop, shoulderHeight, height, toolId=0):
+    mw_dll.set_tool(ct.c_float(diameter), ct.c_float(diameterTop),
+                    ct.c_float(shoulderHeight), ct.c_float(height), ct.c_int(toolId))
+    mw_dll.set_current_tool(ct.c_int(toolId))
+
+
+def liveCut(mw_dll, positions, orientations=None):
+    # positions and orientations are lists of (x, y, z) and (i, j, k), the tool moves through all positions
+    count = len(positions)
+    if count == 0:
+        return 0
+    xs, ys, zs = ((ct.c_float * count)(*axis) for axis in zip(*positions))
+    if orientations is None:
+        iv = jv = kv = None
+    else:
+        iv, jv, kv = ((ct.c_float * count)(*axis) for axis in zip(*orientations))
+    mw_dll.live_cut.restype = ct.c_int
+    return mw_dll.live_cut(xs, ys, zs, iv, jv, kv, ct.c_int(count))
+
+
+def exportMesh(mw_dll, location):
+    mw_dll.export_mesh(ct.c_char_p(str(location).encode()))
+
+
+class MeshView(ct.Structure):
+    # view of a stock mesh of get_stock_mesh, MeshView of MwCamSimLib.h
+    _fields_ = [("points", ct.POINTER(ct.c_float)),
+                ("indices", ct.POINTER(ct.c_uint)),
+                ("normals", ct.POINTER(ct.c_float)),
+                ("num_points", ct.c_ulonglong),
+                ("num_triangles", ct.c_ulonglong)]
+
+
+def getStockMesh(mw_dll):
+    # mesh the current stock without a file. returns the handle and the points (n, 3), point indices (m, 3) and face
+    # normals (m, 3) as numpy arrays over the memory of the dll, they stay valid until releaseMesh(handle)
+    view = MeshView()
+    mw_dll.get_stock_mesh.restype = ct.c_void_p
+    handle = mw_dll.get_stock_mesh(ct.byref(view))
+    if not handle:
+        return None, None, None, None
+    if view.num_triangles == 0:
+        return (ct.c_void_p(handle), np.zeros((0, 3), np.float32), np.zeros((0, 3), np.uint32),
+                np.zeros((0, 3), np.float32))
+    points = np.ctypeslib.as_array(view.points, shape=(view.num_points, 3))
+    indices = np.ctypeslib.as_array(view.indices, shape=(view.num_triangles, 3))
+    normals = np.ctypeslib.as_array(view.normals, shape=(view.num_triangles, 3))
+    return ct.c_void_p(handle), points, indices, normals
+
+
+def releaseMesh(mw_dll, handle):
+    # free a mesh of getStockMesh, its arrays must not be used afterwards
+    if handle is not None:
+        mw_dll.release_mesh(handle)
+
+
+def stockStl(mw_dll):
+    # binary stl of the current stock, built in memory from getStockMesh
+    handle, points, indices, normals = getStockMesh(mw_dll)
+    if handle is None:
+        return None
+    try:
+        facets = np.zeros(len(indices), dtype=[("normal", "<f4", 3), ("vertices", "<f4", (3, 3)),
+                                               ("attribute", "<u2")])
+        facets["normal"] = normals
+        facets["vertices"] = points[indices]
+        return bytes(80) + np.uint32(len(facets)).tobytes() + facets.tobytes()
+    finally:
+        releaseMesh(mw_dll, handle)
+
+
 if __name__ == "__main__":
     start_time = time.time()
 
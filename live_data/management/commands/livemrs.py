@@ -0,0 +1,18 @@
+from django.core.management.base import BaseCommand
+from live_data.liveMrs.mrsDaemon import MrsDaemon
+
+
+class Command(BaseCommand):
+    help = "Run the live material removal simulation, it follows the cnc positions of the active program"
+
+    def add_arguments(self, parser):
+        parser.add_argument("--poll", type=float, default=0.5,
+                            help="seconds between two polls of the cnc table")
+        parser.add_argument("--publish", type=float, default=5.,
+                            help="minimum seconds between two published stock meshes")
+        parser.add_argument("--batch", type=int, default=5000,
+                            help="maximum number of cnc rows cut per poll")
+
+    def handle(self, *args, **options):
+        MrsDaemon(pollInterval=options["poll"], publishInterval=options["publish"],
+                  batchSize=options["batch"]).run()
@@ -60,6 +60,9 @@ def task_one():
 
 @shared_task
 def task_two():
+    # the live mrs service owns the stock, a second simulation would cut the rows again
+    if settings.LIVE_MRS_DAEMON:
+        return "skipped"
     try:
         doCut()
         return "success"
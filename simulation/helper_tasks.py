@@ -4,21 +4,9 @@ import numpy as np
 from pathlib import Path
 from .models import PredictedData
 from django.core.files import File
-import shutil
 from django.conf import settings
 
 
-def copyDll(filename):  # filename
-    shutil.copy(Path(settings.BASE_DIR) / "simulation" / "machine_learning" / "Code" / "SimPy" / "MwCamSimLib.dll",
-                Path(settings.MEDIA_ROOT) / filename / "MwCamSimLib.dll")
-    shutil.copy(Path(settings.BASE_DIR) / "simulation" / "machine_learning" / "Code" / "SimPy" / "mwsimutil.dll",
-                Path(settings.MEDIA_ROOT) / filename / "mwsimutil.dll")
-    shutil.copy(Path(settings.BASE_DIR) / "simulation" / "machine_learning" / "Code" / "SimPy" / "mwSupport.dll",
-                Path(settings.MEDIA_ROOT) / filename / "mwSupport.dll")
-    shutil.copy(Path(settings.BASE_DIR) / "simulation" / "machine_learning" / "Code" / "SimPy" / "mwVerifier.dll",
-                Path(settings.MEDIA_ROOT) / filename / "mwVerifier.dll")
-
-
 def listStlFiles(path, fileName):
     pathPredData = Path(path) / "PredData.csv"
     pathSimData = Path(path) / "SimPathData.txt"
@@ -28,7 +16,8 @@ def listStlFiles(path, fileName):
 
     df = pd.read_csv(pathSimData, sep=' ')
     for file in os.listdir(pathMrs):
-        if file.endswith(".stl"):
+        # delta snapshots (<step>_delta.stl) only hold the changed region, the keyframes are complete meshes
+        if file.endswith(".stl") and Path(file).stem.isdigit():
             filepath = Path(pathMrs) / file
             relativeFilepath = Path(fileName) / "MRS" / file
             line = int(Path(file).stem)
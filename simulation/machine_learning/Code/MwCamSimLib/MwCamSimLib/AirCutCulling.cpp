@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "AirCutCulling.h"
+
+AirCutCulling::AirCutCulling()
+	: last_culled(false), num_culled(0), m_has_box(false), m_has_stock(false), m_stale(false), m_moves_since_refresh(0)
+{
+}
+
+void AirCutCulling::set_policy(const AirCutPolicy &policy)
+{
+	m_policy = policy;
+	m_has_box = false;
+	last_culled = false;
+	num_culled = 0;
+}
+
+void AirCutCulling::set_tool_envelope(int tool_id, float radius, float height)
+{
+	if (tool_id < 0)
+		return;
+	if ((size_t)tool_id >= m_tool_envelopes.size())
+		m_tool_envelopes.resize((size_t)tool_id + 1, ToolEnvelope{0, 0});
+	m_tool_envelopes[tool_id].radius = radius;
+	m_tool_envelopes[tool_id].height = height;
+}
+
+void AirCutCulling::update(const mwMachSimVerifier &verifier)
+{
+	if (!m_policy.enabled)
+		return;
+	if (m_has_box && !(m_stale && m_moves_since_refresh >= m_policy.refresh_moves))
+		return;
+	const mwMachSimVerifier::BoundingBox3d box = verifier.GetCurrentStockBoundingBox();
+	m_has_stock = box.IsInitialized();
+	if (m_has_stock)
+	{
+		m_box_min = box.GetMin();
+		m_box_max = box.GetMax();
+	}
+	m_has_box = true;
+	m_stale = false;
+	m_moves_since_refresh = 0;
+}
+
+bool AirCutCulling::is_air(size_t tool_id, const mwMachSimVerifier::float3d &p1, const mwMachSimVerifier::float3d &p2) const
+{
+	if (!m_policy.enabled || !m_has_box || !m_has_stock)
+		return false;
+	// an unknown tool has no envelope, its moves are always cut
+	if (tool_id >= m_tool_envelopes.size() || m_tool_envelopes[tool_id].radius <= 0)
+		return false;
+	// the tool points up from the tcp, so the envelope reaches radius around it and height above it
+	const ToolEnvelope &envelope = m_tool_envelopes[tool_id];
+	const float radius = envelope.radius + m_policy.margin;
+	const float low_x = (p1.x() < p2.x() ? p1.x() : p2.x()) - radius;
+	const float low_y = (p1.y() < p2.y() ? p1.y() : p2.y()) - radius;
+	const float low_z = (p1.z() < p2.z() ? p1.z() : p2.z()) - m_policy.margin;
+	const float high_x = (p1.x() > p2.x() ? p1.x() : p2.x()) + radius;
+	const float high_y = (p1.y() > p2.y() ? p1.y() : p2.y()) + radius;
+	const float high_z = (p1.z() > p2.z() ? p1.z() : p2.z()) + envelope.height + m_policy.margin;
+	return high_x < m_box_min.x() || low_x > m_box_max.x() ||
+		   high_y < m_box_min.y() || low_y > m_box_max.y() ||
+		   high_z < m_box_min.z() || low_z > m_box_max.z();
+}
+
+void AirCutCulling::simulated(int moves, bool removed_material)
+{
+	m_moves_since_refresh += moves;
+	m_stale |= removed_material;
+}
+
+//@brief: skip the moves whose swept tool envelope stays outside the remaining stock. they are not cut and
+//        report zero engagement, e.g. rapids, approach moves and retractions above the part
+//@param: ctx: simulation context
+//@param: enabled: if cull the air moves
+//@param: margin: safety distance around the tool envelope (mm)
+//@param: refresh_moves: recompute the stock box at most every refresh_moves moves, 0 at every batch
+//@ret: void
+void set_air_cut_culling(SimContext *ctx, bool enabled, float margin, int refresh_moves)
+{
+	AirCutPolicy policy;
+	policy.enabled = enabled;
+	policy.margin = margin > 0 ? margin : 0;
+	policy.refresh_moves = refresh_moves > 0 ? refresh_moves : 0;
+	ctx->air_cuts.set_policy(policy);
+}
+
+//@brief: number of moves culled as air moves since set_air_cut_culling
+//@param: ctx: simulation context
+//@ret: number of culled moves
+long long get_air_cut_count(SimContext *ctx)
+{
+	return ctx->air_cuts.num_culled;
+}
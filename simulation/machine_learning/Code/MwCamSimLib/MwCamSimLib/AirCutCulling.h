@@ -0,0 +1,58 @@
+#pragma once
+// skipping of moves whose swept tool envelope stays outside the remaining stock
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+#include "SnapshotExporter.h"
+
+//@brief: settings of the air cut culling in DoCut and DoCutBatch, disabled by default
+struct AirCutPolicy
+{
+	bool enabled = false;
+	// safety distance added around the tool envelope (mm)
+	float margin = 1;
+	// the stock box is refreshed at most every refresh_moves moves after material was removed, 0 at every batch.
+	// a box that is not refreshed only shrinks late, so it never culls a cutting move
+	int refresh_moves = 0;
+};
+
+//@brief: decides which moves run through the air and can skip the verifier
+//
+// the bounding box of the remaining stock (GetCurrentStockBoundingBox) is compared with the box swept by the
+// tool envelope along a move. a move whose box does not touch the stock removes nothing and has no engagement,
+// so it is not cut and reports zero results. the stock box is recomputed lazily: cutting only shrinks the
+// stock, so the last box stays a valid bound until it is refreshed; a new or loaded stock forces a refresh.
+class AirCutCulling
+{
+public:
+	AirCutCulling();
+
+	void set_policy(const AirCutPolicy &policy);
+	bool enabled() const { return m_policy.enabled; }
+	void set_tool_envelope(int tool_id, float radius, float height);
+	// the stock was replaced (set_stock, a loaded checkpoint), the old box is no bound of it anymore
+	void reset_stock() { m_has_box = false; }
+	// refresh the stock box if it is missing or due, called before the moves of a batch are tested
+	void update(const mwMachSimVerifier &verifier);
+	// true if the tool moving from p1 to p2 stays outside the stock box
+	bool is_air(size_t tool_id, const mwMachSimVerifier::float3d &p1, const mwMachSimVerifier::float3d &p2) const;
+	// account simulated moves and if they may have removed material
+	void simulated(int moves, bool removed_material);
+
+	// the last DoCut was culled, engagement_analysis reports zero results for it
+	bool last_culled;
+	// moves culled since the policy was set
+	long long num_culled;
+
+private:
+	AirCutPolicy m_policy;
+	std::vector<ToolEnvelope> m_tool_envelopes;
+	bool m_has_box;
+	// false if the verifier has no stock, nothing is culled then
+	bool m_has_stock;
+	// material was removed since the box was computed
+	bool m_stale;
+	int m_moves_since_refresh;
+	mwMachSimVerifier::float3d m_box_min;
+	mwMachSimVerifier::float3d m_box_max;
+};
@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "Checkpointer.h"
+
+#include <cstdio>
+#include <vector>
+
+// upper bound of the path strings in a checkpoint file, longer lengths mean a damaged file
+static const unsigned int CHECKPOINT_MAX_STRING = 1 << 16;
+
+//@brief: move a file over another one in a single step, so a reader sees either the old or the new file
+//@param: from: file to move
+//@param: to: file to replace
+//@ret: false if the file could not be moved
+static bool replace_file(const std::string &from, const std::string &to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void write_string(std::ofstream &file, const std::string &value)
+{
+	const unsigned int length = (unsigned int)value.size();
+	file.write((const char *)&length, sizeof(length));
+	file.write(value.data(), length);
+}
+
+static bool read_string(std::ifstream &file, std::string &value)
+{
+	unsigned int length = 0;
+	file.read((char *)&length, sizeof(length));
+	if (!file.good() || length > CHECKPOINT_MAX_STRING)
+		return false;
+	value.resize(length);
+	if (length > 0)
+		file.read(&value[0], length);
+	return file.good();
+}
+
+//@brief: read the state of <folder>\checkpoint.bin
+//@param: folder: checkpoint folder
+//@param: state: receives the state of the run
+//@param: restore_point: receives the restore point of the verifier, NULL to skip it
+//@ret: false if there is no valid checkpoint in the folder
+static bool read_state(const std::string &folder, CheckpointState &state, std::vector<char> *restore_point)
+{
+	std::ifstream file(folder + "\\checkpoint.bin", std::ios::binary);
+	if (!file.good())
+		return false;
+	file.read((char *)&state.header, sizeof(state.header));
+	if (!file.good() || state.header.magic != CHECKPOINT_MAGIC || state.header.version != CHECKPOINT_VERSION)
+		return false;
+	if (!read_string(file, state.toolpath_file) || !read_string(file, state.snapshot_dir) ||
+		!read_string(file, state.feature_file) || !read_string(file, state.base_file))
+		return false;
+	if (restore_point)
+	{
+		restore_point->resize((size_t)state.header.restore_point_size);
+		if (!restore_point->empty())
+			file.read(&(*restore_point)[0], (std::streamsize)restore_point->size());
+	}
+	return file.good();
+}
+
+Checkpointer::Checkpointer()
+	: m_last_cut_id(0), m_last_checkpoint(std::chrono::steady_clock::now()), m_busy(false), m_stop(false)
+{
+}
+
+Checkpointer::~Checkpointer()
+{
+	// the pending checkpoint is still written before the thread ends
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_job_ready.notify_one();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void Checkpointer::set_policy(const char *folder, const CheckpointPolicy &policy)
+{
+	flush();
+	m_folder = folder ? folder : "";
+	m_policy = policy;
+	m_last_cut_id = 0;
+	m_last_checkpoint = std::chrono::steady_clock::now();
+	// the first checkpoint of the new run writes its own base
+	m_base_file.clear();
+	m_stale_bases.clear();
+}
+
+bool Checkpointer::due(int cut_id) const
+{
+	if (m_policy.every_moves > 0 && cut_id - m_last_cut_id >= m_policy.every_moves)
+		return true;
+	if (m_policy.every_seconds > 0)
+	{
+		const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - m_last_checkpoint;
+		return elapsed.count() >= m_policy.every_seconds;
+	}
+	return false;
+}
+
+void Checkpointer::resumed(const std::string &folder, const CheckpointState &state)
+{
+	flush();
+	m_last_cut_id = state.header.cut_id;
+	m_last_checkpoint = std::chrono::steady_clock::now();
+	// the restore points of the resumed run are taken against a new base, the loaded one is removed
+	// as soon as the first of them is written
+	m_base_file.clear();
+	if (folder == m_folder)
+		m_stale_bases.push_back(state.base_file);
+}
+
+bool Checkpointer::save(mwMachSimVerifier &verifier, CheckpointState &state)
+{
+	// a failed checkpoint also restarts the triggers, otherwise every following batch would retry it
+	m_last_cut_id = state.header.cut_id;
+	m_last_checkpoint = std::chrono::steady_clock::now();
+
+	std::unique_ptr<Job> job(new Job());
+	job->folder = m_folder;
+	try
+	{
+		if (m_base_file.empty())
+		{
+			// the checkpoint of an earlier run in this folder needs its base until the new checkpoint is written
+			CheckpointState previous;
+			if (m_stale_bases.empty() && read_state(m_folder, previous, NULL))
+				m_stale_bases.push_back(previous.base_file);
+			const long long now = (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+			const std::string base_file = "simulation_" + std::to_string(state.header.cut_id) + "_" + std::to_string(now) + ".mwsim";
+			verifier.SaveSimulation(misc::mwstring(m_folder + "\\" + base_file));
+			m_base_file = base_file;
+		}
+		job->restore_point.reset(new misc::mwMemoryIOStream());
+		verifier.SaveRestorePoint(*job->restore_point);
+	}
+	catch (...)
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Checkpoint " << state.header.cut_id << " in " << m_folder << " could not be saved" << std::endl;
+		return false;
+	}
+
+	state.header.magic = CHECKPOINT_MAGIC;
+	state.header.version = CHECKPOINT_VERSION;
+	state.header.restore_point_size = (unsigned long long)job->restore_point->GetDataLength();
+	state.base_file = m_base_file;
+	job->state = state;
+	job->stale_bases.swap(m_stale_bases);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// only the newest checkpoint is worth writing, the bases the replaced one would have removed are kept
+		if (m_pending)
+			job->stale_bases.insert(job->stale_bases.end(), m_pending->stale_bases.begin(), m_pending->stale_bases.end());
+		m_pending = std::move(job);
+		if (!m_thread.joinable())
+			m_thread = std::thread(&Checkpointer::work, this);
+	}
+	m_job_ready.notify_one();
+	return true;
+}
+
+//@brief: write a checkpoint file next to the current one and replace it
+//@param: job: checkpoint to write
+//@ret: false if the checkpoint could not be written
+bool Checkpointer::write(const Job &job)
+{
+	const std::string path = job.folder + "\\checkpoint.bin";
+	const std::string temp_path = path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write((const char *)&job.state.header, sizeof(job.state.header));
+		write_string(file, job.state.toolpath_file);
+		write_string(file, job.state.snapshot_dir);
+		write_string(file, job.state.feature_file);
+		write_string(file, job.state.base_file);
+		file.write((const char *)job.restore_point->GetBuffer(), (std::streamsize)job.restore_point->GetDataLength());
+		if (!file.good())
+			return false;
+	}
+	if (!replace_file(temp_path, path))
+		return false;
+
+	for (size_t i = 0; i < job.stale_bases.size(); ++i)
+		if (!job.stale_bases[i].empty() && job.stale_bases[i] != job.state.base_file)
+			std::remove((job.folder + "\\" + job.stale_bases[i]).c_str());
+	return true;
+}
+
+void Checkpointer::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return !m_pending && !m_busy; });
+}
+
+//@brief: writer thread, writes the newest pending checkpoint
+void Checkpointer::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_job_ready.wait(lock, [this] { return m_stop || m_pending; });
+		if (!m_pending)
+			break;
+		std::unique_ptr<Job> job = std::move(m_pending);
+		m_busy = true;
+		lock.unlock();
+
+		if (!write(*job))
+			std::cout << "[\033[1;31mERROR\033[0m]  Checkpoint " << job->state.header.cut_id << " in " << job->folder << " could not be written" << std::endl;
+
+		lock.lock();
+		m_busy = false;
+		m_idle.notify_all();
+	}
+}
+
+bool Checkpointer::load(const std::string &folder, mwMachSimVerifier &verifier, CheckpointState &state)
+{
+	std::vector<char> restore_point;
+	if (!read_state(folder, state, &restore_point))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  No valid checkpoint in " << folder << std::endl;
+		return false;
+	}
+	try
+	{
+		// a restore point only holds the changes since its base simulation
+		verifier.LoadSimulation(misc::mwstring(folder + "\\" + state.base_file));
+		misc::mwMemoryIOStream stream(restore_point.empty() ? NULL : &restore_point[0], (misc::mwMemoryIOStream::uint64_t)restore_point.size());
+		verifier.LoadRestorePoint(stream);
+	}
+	catch (...)
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Checkpoint in " << folder << " could not be loaded" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//@brief: restore the verifier, the feature file and the current tool of a simulation context from a checkpoint
+//@param: ctx: simulation context, tools (with tool numbers) and config have to be set up
+//@param: checkpoint_dir: checkpoint folder
+//@param: state: receives the state of the checkpointed run
+//@ret: false if the checkpoint could not be loaded
+bool restore_checkpoint(SimContext *ctx, const char *checkpoint_dir, CheckpointState &state)
+{
+	ctx->checkpoints.flush();
+	if (!Checkpointer::load(checkpoint_dir, *ctx->verifier, state))
+		return false;
+	ctx->air_cuts.reset_stock();
+
+	// rows written after the checkpoint are dropped, the resumed run writes them again
+	if (state.header.result_format >= 0 && !state.feature_file.empty())
+	{
+		ctx->feature_file.reset(resume_engagement_writer(state.feature_file.c_str(), state.header.result_format, state.header.feature_position));
+		if (!ctx->feature_file->good())
+		{
+			std::cout << "[\033[1;31mERROR\033[0m]  Feature file " << state.feature_file << " of the checkpoint could not be continued" << std::endl;
+			ctx->feature_file.reset();
+			return false;
+		}
+		ctx->feature_file->set_time_step(ctx->feature_time_step);
+		ctx->feature_path = state.feature_file;
+		ctx->result_format = state.header.result_format;
+	}
+	set_current_tool(ctx, state.header.tool_idx);
+	ctx->checkpoints.resumed(checkpoint_dir, state);
+	std::cout << "[\033[1;32mOK\033[0m]  Load the checkpoint of step " << state.header.cut_id << " from " << checkpoint_dir << std::endl;
+	return true;
+}
+
+//@brief: set when simulate_toolpath writes checkpoints into the checkpoint folder. a checkpoint is taken
+//        after the first batch that reaches a trigger
+//@param: ctx: simulation context
+//@param: checkpoint_dir: existing folder of the checkpoint, NULL disables the checkpoints
+//@param: every_moves: checkpoint after this many simulated steps, 0 disables
+//@param: every_seconds: checkpoint after this wall time (s), 0 disables
+//@ret: void
+void set_checkpoint_policy(SimContext *ctx, char *checkpoint_dir, int every_moves, float every_seconds)
+{
+	CheckpointPolicy policy;
+	policy.every_moves = every_moves;
+	policy.every_seconds = every_seconds;
+	ctx->checkpoints.set_policy(checkpoint_dir, policy);
+}
+
+//@brief: restore the simulation state of a checkpoint without continuing the tool path, e.g. to simulate
+//        other moves from there with DoCut or DoCutBatch
+//@param: ctx: simulation context, tools (with tool numbers) and config have to be set up
+//@param: checkpoint_dir: checkpoint folder
+//@ret: last simulated step of the checkpoint, -1 on error
+int load_checkpoint(SimContext *ctx, char *checkpoint_dir)
+{
+	CheckpointState state;
+	if (!restore_checkpoint(ctx, checkpoint_dir, state))
+		return -1;
+	return state.header.cut_id;
+}
@@ -0,0 +1,123 @@
+#pragma once
+// periodic checkpoints of a tool path simulation, continued with resume_from_checkpoint
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+#include "mwMemoryIOStream.hpp"
+#include "EngagementWriter.h"
+
+// header of <folder>\checkpoint.bin
+#define CHECKPOINT_MAGIC 0x5043574d // "MWCP"
+#define CHECKPOINT_VERSION 1
+
+//@brief: when simulate_toolpath takes a checkpoint, every trigger set to 0 is disabled
+struct CheckpointPolicy
+{
+	// checkpoint when this many steps were simulated since the last checkpoint
+	int every_moves = 0;
+	// checkpoint when this much wall time (s) passed since the last checkpoint
+	float every_seconds = 0;
+};
+
+#pragma pack(push, 8)
+// fixed part of <folder>\checkpoint.bin. it is followed by the tool path file, the snapshot folder, the
+// feature file and the base simulation file name (uint32 length + characters each) and by the restore point
+struct CheckpointHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	// last simulated step and the machine state after it
+	int cut_id;
+	int tool_idx;
+	int tool_number;
+	int block_nr;
+	float x;
+	float y;
+	float z;
+	// tool path reader position of the next sample, see ToolpathReader::Position
+	long long toolpath_offset;
+	long long toolpath_line;
+	int sample_interval;
+	int is_trace;
+	// format of the feature file, -1 if the simulation writes none
+	int result_format;
+	int reserved;
+	EngagementFilePosition feature_position;
+	unsigned long long restore_point_size;
+};
+#pragma pack(pop)
+
+// everything a checkpoint stores besides the verifier
+struct CheckpointState
+{
+	CheckpointHeader header;
+	std::string toolpath_file;
+	std::string snapshot_dir;
+	std::string feature_file;
+	// file name of the base simulation in the checkpoint folder
+	std::string base_file;
+};
+
+//@brief: takes the checkpoints of one simulation context
+//
+// the first checkpoint of a run stores the whole simulation (SaveSimulation) as base file in the folder.
+// every checkpoint then serializes a restore point (SaveRestorePoint) into memory on the cutting thread;
+// a background thread writes it together with the state of the run to <folder>\checkpoint.bin and
+// replaces the previous checkpoint atomically. if the writer is still busy, only the newest checkpoint
+// is kept. a checkpoint is loaded by LoadSimulation of its base file followed by LoadRestorePoint.
+class Checkpointer
+{
+public:
+	Checkpointer();
+	~Checkpointer();
+
+	// start a new run writing to folder, an empty folder disables the checkpoints
+	void set_policy(const char *folder, const CheckpointPolicy &policy);
+	bool enabled() const { return !m_folder.empty() && (m_policy.every_moves > 0 || m_policy.every_seconds > 0); }
+	// check the triggers after the step cut_id was simulated
+	bool due(int cut_id) const;
+	// checkpoint the verifier and the state of the run, the header is completed here
+	bool save(mwMachSimVerifier &verifier, CheckpointState &state);
+	// the verifier was restored from the checkpoint in folder, the next checkpoint writes a new base
+	void resumed(const std::string &folder, const CheckpointState &state);
+	// wait until the pending checkpoint is written
+	void flush();
+
+	// read <folder>\checkpoint.bin and restore the verifier from it
+	static bool load(const std::string &folder, mwMachSimVerifier &verifier, CheckpointState &state);
+
+private:
+	struct Job
+	{
+		std::unique_ptr<misc::mwMemoryIOStream> restore_point;
+		std::string folder;
+		CheckpointState state;
+		// base files replaced by this checkpoint, removed once the checkpoint is written
+		std::vector<std::string> stale_bases;
+	};
+
+	void work();
+	bool write(const Job &job);
+
+	std::string m_folder;
+	CheckpointPolicy m_policy;
+	int m_last_cut_id;
+	std::chrono::steady_clock::time_point m_last_checkpoint;
+	// base of the restore points of this run, empty until the first checkpoint
+	std::string m_base_file;
+	std::vector<std::string> m_stale_bases;
+
+	std::mutex m_mutex;
+	std::condition_variable m_job_ready;
+	std::condition_variable m_idle;
+	std::unique_ptr<Job> m_pending;
+	bool m_busy;
+	bool m_stop;
+	std::thread m_thread;
+};
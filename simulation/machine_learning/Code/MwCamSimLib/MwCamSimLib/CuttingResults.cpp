@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "CuttingResults.h"
+
+void EngagementResults::fetch(mwMachSimVerifier &verifier)
+{
+	// the vectors are cleared instead of recreated, their capacity carries over to the next cuts
+	tool_profiles.clear();
+	angles.clear();
+	areas.clear();
+	depths.clear();
+	widths.clear();
+	removed_volumes.clear();
+	verifier.GetRemovedVolumes(removed_volumes);
+	verifier.GetEngagementAngles(tool_profiles, angles);
+	verifier.GetEngagementAreas(areas);
+	verifier.GetEngagementDepths(depths);
+	verifier.GetEngagementWidths(widths);
+}
+
+CuttingResultStream::CuttingResultStream()
+	: m_head(0), m_size(0), m_dropped(0)
+{
+}
+
+void CuttingResultStream::enable(mwMachSimVerifier &verifier, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ring.assign(capacity, CuttingResultRecord());
+	m_head = 0;
+	m_size = 0;
+	m_dropped = 0;
+	for (int axis = 0; axis < 3; ++axis)
+		m_results[axis].clear();
+
+	// only the cutting part of the tool removes material
+	const cadcam::mwToolPartSelector cutting_part(true, false, false, false);
+	if (capacity == 0)
+		verifier.SetCuttingResultCallback_And_GetTransformationInfo(m_transformation, cutting_part);
+	else
+		verifier.SetCuttingResultCallback_And_GetTransformationInfo(m_transformation, cutting_part, &m_results[0], &m_results[1], &m_results[2]);
+}
+
+//@brief: convert the entries of one nail direction into ring buffer records
+//@param: entries: results of the verifier for this nail direction
+//@param: axis: 0 for the XYZ field (nails along z), 1 for ZXY (along y), 2 for YZX (along x)
+//@ret: void
+void CuttingResultStream::push(const mwMachSimVerifier::CuttingResultVector &entries, int axis)
+{
+	// Coord1 and Coord2 index the two grid directions of the field, the heights run along the nail
+	const VerifierUtil::mwFieldCoordinateScaling *scalings[3][2] = {
+		{&m_transformation.ScalingX, &m_transformation.ScalingY},
+		{&m_transformation.ScalingZ, &m_transformation.ScalingX},
+		{&m_transformation.ScalingY, &m_transformation.ScalingZ}};
+	const VerifierUtil::mwFieldCoordinateScaling &scaling1 = *scalings[axis][0];
+	const VerifierUtil::mwFieldCoordinateScaling &scaling2 = *scalings[axis][1];
+	const float area = scaling1.GetScaling() * scaling2.GetScaling();
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (m_size == m_ring.size())
+		{
+			m_dropped += (long long)(entries.size() - i);
+			return;
+		}
+		const mwMachSimVerifier::CuttingResultEntry &entry = entries[i];
+		const float coord1 = scaling1.IndexToWorld(entry.Coord1);
+		const float coord2 = scaling2.IndexToWorld(entry.Coord2);
+
+		CuttingResultRecord &record = m_ring[(m_head + m_size) % m_ring.size()];
+		record.move_id = entry.MoveId;
+		record.axis = axis;
+		record.x = axis == 0 ? coord1 : (axis == 1 ? coord2 : entry.Height1);
+		record.y = axis == 0 ? coord2 : (axis == 1 ? entry.Height1 : coord1);
+		record.z = axis == 0 ? entry.Height1 : (axis == 1 ? coord1 : coord2);
+		record.length = entry.Height2 - entry.Height1;
+		record.area = area;
+		record.distribution = (int)entry.HeightValueDistribution;
+		++m_size;
+	}
+}
+
+void CuttingResultStream::collect()
+{
+	if (m_ring.empty())
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		push(m_results[axis], axis);
+		m_results[axis].clear();
+	}
+}
+
+size_t CuttingResultStream::drain(CuttingResultRecord *records, size_t max_count, long long &dropped)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t count = m_size < max_count ? m_size : max_count;
+	// at most two contiguous pieces: up to the end of the ring and from its start
+	const size_t first = m_ring.size() - m_head < count ? m_ring.size() - m_head : count;
+	std::copy(m_ring.begin() + m_head, m_ring.begin() + m_head + first, records);
+	std::copy(m_ring.begin(), m_ring.begin() + (count - first), records + first);
+	m_head = m_ring.empty() ? 0 : (m_head + count) % m_ring.size();
+	m_size -= count;
+	dropped = m_dropped;
+	m_dropped = 0;
+	return count;
+}
+
+//@brief: stream the raw cutting results (removed nail intervals) of every simulated cut into a ring buffer.
+//        has to be called after set_stock, the verifier unregisters the stream when the stock is reset
+//@param: ctx: simulation context
+//@param: capacity: number of records the buffer holds until they are drained, 0 disables the stream
+//@ret: void
+void enable_cutting_results(SimContext *ctx, int capacity)
+{
+	ctx->cutting_results.enable(*ctx->verifier, capacity > 0 ? (size_t)capacity : 0);
+}
+
+//@brief: take the oldest cutting results out of the buffer
+//@param: ctx: simulation context
+//@param: records: output array with max_count elements
+//@param: max_count: maximum number of records to take
+//@param: dropped: receives the number of records lost since the last call because the buffer was full, may be NULL
+//@ret: number of records written to records
+int drain_cutting_results(SimContext *ctx, CuttingResultRecord *records, int max_count, long long *dropped)
+{
+	long long num_dropped = 0;
+	const size_t count = ctx->cutting_results.drain(records, max_count > 0 ? (size_t)max_count : 0, num_dropped);
+	if (dropped)
+		*dropped = num_dropped;
+	return (int)count;
+}
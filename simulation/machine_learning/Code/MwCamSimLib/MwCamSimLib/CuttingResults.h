@@ -0,0 +1,73 @@
+#pragma once
+// results of the simulated cuts: reused engagement vectors and the raw cutting result stream
+#include <mutex>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+
+//@brief: engagement results of the last simulated cuts, kept per context so the vectors are reused
+struct EngagementResults
+{
+	std::vector<mwMachSimVerifier::EngagementProfilePtr> tool_profiles;
+	std::vector<mwMachSimVerifier::EngagementAngleListList> angles;
+	std::vector<float> areas;
+	std::vector<float> depths;
+	std::vector<float> widths;
+	std::vector<float> removed_volumes;
+
+	// fetch the results of the cuts simulated since the last call, one entry per cut
+	void fetch(mwMachSimVerifier &verifier);
+};
+
+#pragma pack(push, 4)
+// one removed nail interval of the stock, a world space copy of mwCuttingResultEntry.
+// the interval starts at (x, y, z) and reaches length along the nail axis
+struct CuttingResultRecord
+{
+	// move id of the cut (SetMoveID, the simulation step index)
+	float move_id;
+	// nail axis: 0 z, 1 y, 2 x
+	int axis;
+	float x;
+	float y;
+	float z;
+	float length;
+	// cross section of the nail (mm^2), |length| * area is the removed volume
+	float area;
+	// mwCuttingResultEntry::HeightValueDistributionType
+	int distribution;
+};
+#pragma pack(pop)
+
+//@brief: collects the raw cutting results of a verifier into a fixed size ring buffer
+//
+// the verifier appends the results to the registered vectors while it simulates. collect() moves them
+// into the ring buffer after every simulation call and clears the vectors, which keep their capacity,
+// so a running simulation allocates nothing. consumers take the records in bulk with drain(). if the
+// buffer is full, the newest records are dropped and counted.
+class CuttingResultStream
+{
+public:
+	CuttingResultStream();
+
+	// register the result vectors at the verifier, capacity 0 unregisters them
+	void enable(mwMachSimVerifier &verifier, size_t capacity);
+	bool enabled() const { return !m_ring.empty(); }
+	// move the results of the last simulation call into the ring buffer
+	void collect();
+	// copy up to max_count of the oldest records and remove them from the buffer
+	size_t drain(CuttingResultRecord *records, size_t max_count, long long &dropped);
+
+private:
+	void push(const mwMachSimVerifier::CuttingResultVector &entries, int axis);
+
+	mwMachSimVerifier::CuttingResult_TransformationInfo m_transformation;
+	// nails along z, y and x
+	mwMachSimVerifier::CuttingResultVector m_results[3];
+
+	std::mutex m_mutex;
+	std::vector<CuttingResultRecord> m_ring;
+	size_t m_head;
+	size_t m_size;
+	long long m_dropped;
+};
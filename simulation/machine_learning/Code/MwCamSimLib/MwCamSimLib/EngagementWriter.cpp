@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "EngagementWriter.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+//@brief: name of a result file for the mapped file
+//@param: path: file path
+//@ret: file name
+static misc::mwFileName result_file_name(const std::string &path)
+{
+	return misc::mwFileName(misc::mwstring(path.c_str()));
+}
+
+//@brief: unmap a result file and cut it to the written size
+//@param: file: mapped result file
+//@param: path: file path for the warning
+//@ret: void
+static void close_result_file(misc::mwMappedFile &file, const std::string &path)
+{
+	if (!file.Close())
+		std::cout << "\033[1;33mWARNING: Could not truncate result file " << path << "\033[0m" << std::endl;
+}
+
+TextEngagementWriter::TextEngagementWriter(const char *path)
+	: m_file(path)
+{
+	if (m_file.good())
+	{
+		m_file << "Timestamp;"
+			   << "XCurrPos;"
+			   << "YCurrPos;"
+			   << "ZCurrPos;"
+			   << "S1Actrev;"
+			   << "Actfeed;"
+			   << "ToolID;"
+			   << "Area;"
+			   << "Depth;"
+			   << "Width;"
+			   << "Removal_Volume;"
+			   << "Angles" << std::endl;
+	}
+}
+
+TextEngagementWriter::TextEngagementWriter(const char *path, unsigned long long resume_bytes)
+{
+	// the rows written after the checkpoint are cut off before appending
+	misc::mwMappedFile file;
+	if (!file.OpenWritable(result_file_name(path), (size_t)resume_bytes))
+	{
+		m_file.setstate(std::ios::failbit);
+		return;
+	}
+	close_result_file(file, path);
+	m_file.open(path, std::ios::out | std::ios::app);
+}
+
+EngagementFilePosition TextEngagementWriter::position()
+{
+	EngagementFilePosition position;
+	std::memset(&position, 0, sizeof(position));
+	m_file.flush();
+	position.bytes = (unsigned long long)m_file.tellp();
+	return position;
+}
+
+void TextEngagementWriter::begin_move(long long timestamp, float x, float y, float z, float s1actrev, float actfeed, int toolid)
+{
+	m_file << timestamp << ";" << x << ";" << y << ";" << z << ";" << s1actrev << ";" << actfeed << ";" << toolid << ";";
+}
+
+void TextEngagementWriter::end_move(float area, float depth, float width, float removed_volume,
+									const mwMachSimVerifier::EngagementAngleListList *angles)
+{
+	typedef mwMachSimVerifier::EngagementAngleListList::const_iterator Iter1;
+	typedef mwMachSimVerifier::EngagementAngleList::const_iterator Iter2;
+
+	m_file << area << ";" << depth << ";" << width << ";" << removed_volume << ";";
+
+	// engagement angles are recorded per tool profile segment, empty segments are skipped
+	m_file << "[";
+	if (angles)
+	{
+		for (Iter1 j = angles->begin(); j != angles->end(); j++)
+		{
+			if (!j->empty())
+				m_file << "[";
+			for (Iter2 k = j->begin(); k != j->end(); k++)
+			{
+				const float angle_left = k->first * (float)mathdef::MW_R2D;
+				const float angle_right = k->second * (float)mathdef::MW_R2D;
+
+				m_file << angle_right - angle_left;
+				if (k + 1 != j->end())
+					m_file << ",";
+			}
+			if (!j->empty())
+				m_file << "]";
+		}
+	}
+	m_file << "]" << std::endl;
+}
+
+BinaryEngagementWriter::BinaryEngagementWriter(const char *path)
+	: m_segment_count(0), m_value_count(0), m_good(false), m_time_step(RESULT_DEFAULT_TIME_STEP), m_has_previous(false),
+	  m_previous_x(0), m_previous_y(0), m_previous_z(0), m_previous_s1actrev(0), m_previous_dx(0), m_previous_dy(0), m_previous_dz(0)
+{
+	std::memset(&m_pending, 0, sizeof(m_pending));
+	m_path = path;
+	m_good = m_records.Create(result_file_name(m_path), sizeof(EngagementFileHeader)) &&
+			 m_segments.Create(result_file_name(m_path + ".seg"), 0) && m_values.Create(result_file_name(m_path + ".val"), 0);
+	if (!m_good)
+		return;
+
+	EngagementFileHeader *header = (EngagementFileHeader *)m_records.GetWritableData();
+	header->magic = RESULT_BINARY_MAGIC;
+	header->version = RESULT_BINARY_VERSION;
+	header->record_size = sizeof(EngagementRecord);
+	header->count = 0;
+}
+
+BinaryEngagementWriter::BinaryEngagementWriter(const char *path, const EngagementFilePosition &resume)
+	: m_segment_count(resume.segments), m_value_count(resume.values), m_good(false), m_time_step(RESULT_DEFAULT_TIME_STEP), m_has_previous(false),
+	  m_previous_x(0), m_previous_y(0), m_previous_z(0), m_previous_s1actrev(0), m_previous_dx(0), m_previous_dy(0), m_previous_dz(0)
+{
+	std::memset(&m_pending, 0, sizeof(m_pending));
+	m_path = path;
+	m_good = m_records.OpenWritable(result_file_name(m_path), sizeof(EngagementFileHeader) + resume.records * sizeof(EngagementRecord)) &&
+			 m_segments.OpenWritable(result_file_name(m_path + ".seg"), resume.segments * sizeof(unsigned long long)) &&
+			 m_values.OpenWritable(result_file_name(m_path + ".val"), resume.values * sizeof(float));
+	if (!m_good)
+		return;
+	EngagementFileHeader *header = (EngagementFileHeader *)m_records.GetWritableData();
+	m_good = header->magic == RESULT_BINARY_MAGIC && header->record_size == sizeof(EngagementRecord);
+	header->count = resume.records;
+	if (!m_good || resume.records == 0)
+		return;
+
+	// the finite differences continue from the last kept records
+	const EngagementRecord *records = (const EngagementRecord *)(m_records.GetData() + sizeof(EngagementFileHeader));
+	const EngagementRecord &last = records[resume.records - 1];
+	m_has_previous = true;
+	m_previous_x = last.x;
+	m_previous_y = last.y;
+	m_previous_z = last.z;
+	m_previous_s1actrev = last.s1actrev;
+	if (resume.records > 1)
+	{
+		const EngagementRecord &before_last = records[resume.records - 2];
+		m_previous_dx = (double)last.x - before_last.x;
+		m_previous_dy = (double)last.y - before_last.y;
+		m_previous_dz = (double)last.z - before_last.z;
+	}
+}
+
+BinaryEngagementWriter::~BinaryEngagementWriter()
+{
+	close_result_file(m_records, m_path);
+	close_result_file(m_segments, m_path + ".seg");
+	close_result_file(m_values, m_path + ".val");
+}
+
+void BinaryEngagementWriter::begin_move(long long timestamp, float x, float y, float z, float s1actrev, float actfeed, int toolid)
+{
+	m_pending.timestamp = timestamp;
+	m_pending.x = x;
+	m_pending.y = y;
+	m_pending.z = z;
+	m_pending.s1actrev = s1actrev;
+	m_pending.actfeed = actfeed;
+	m_pending.toolid = toolid;
+}
+
+void BinaryEngagementWriter::end_move(float area, float depth, float width, float removed_volume,
+									  const mwMachSimVerifier::EngagementAngleListList *angles)
+{
+	if (!m_good)
+		return;
+
+	typedef mwMachSimVerifier::EngagementAngleListList::const_iterator Iter1;
+	typedef mwMachSimVerifier::EngagementAngleList::const_iterator Iter2;
+
+	// values and segments are appended before the record, so a reader never sees a record
+	// pointing behind the written data
+	double angle_sum = 0, angle_sin = 0, angle_cos = 0;
+	int angle_segments = 0;
+	if (angles)
+	{
+		for (Iter1 j = angles->begin(); j != angles->end(); j++)
+		{
+			if (j->empty())
+				continue;
+			// the segment sum is taken over the stored degree spans, like FeaturePreprocess.sum_up does
+			double segment_sum = 0;
+			for (Iter2 k = j->begin(); k != j->end(); k++)
+			{
+				const float span = (k->second - k->first) * (float)mathdef::MW_R2D;
+				m_good &= m_values.Append(&span, sizeof(span));
+				segment_sum += span;
+			}
+			segment_sum *= mathdef::MW_D2R;
+			angle_sum += segment_sum;
+			angle_sin += std::sin(segment_sum);
+			angle_cos += std::cos(segment_sum);
+			++angle_segments;
+			m_value_count += j->size();
+			m_good &= m_segments.Append(&m_value_count, sizeof(m_value_count));
+			++m_segment_count;
+		}
+	}
+
+	m_pending.area = area;
+	m_pending.depth = depth;
+	m_pending.width = width;
+	m_pending.removed_volume = removed_volume;
+	derive_features(angle_sum, angle_sin, angle_cos, angle_segments);
+	m_pending.segment_end = m_segment_count;
+	m_good &= m_records.Append(&m_pending, sizeof(m_pending));
+
+	EngagementFileHeader *header = (EngagementFileHeader *)m_records.GetWritableData();
+	if (header)
+		++header->count;
+
+	if (!m_good)
+		std::cout << "[\033[1;31mERROR\033[0m]  Could not grow the binary feature file" << std::endl;
+}
+
+//@brief: fill the derived features of the pending record, FeaturePreprocess.design_features and compute_acceleration
+//        in one pass. the acceleration of the previous record is corrected now that its forward difference is known
+//@param: angle_sum: sum of the engagement angle sums (rad) of the non-empty tool profile segments
+//@param: angle_sin: sum of their sines
+//@param: angle_cos: sum of their cosines
+//@param: angle_segments: number of non-empty tool profile segments
+//@ret: void
+void BinaryEngagementWriter::derive_features(double angle_sum, double angle_sin, double angle_cos, int angle_segments)
+{
+	m_pending.angle_mean = angle_segments ? (float)(angle_sum / angle_segments) : 0.f;
+	m_pending.angle_sin = angle_segments ? (float)(angle_sin / angle_segments) : 0.f;
+	m_pending.angle_cos = angle_segments ? (float)(angle_cos / angle_segments) : 0.f;
+	m_pending.chip_thickness = m_pending.actfeed * m_pending.area;
+	m_pending.reserved = 0;
+
+	// the first row has no predecessor, its differences are zero
+	const double dx = m_has_previous ? (double)m_pending.x - m_previous_x : 0.;
+	const double dy = m_has_previous ? (double)m_pending.y - m_previous_y : 0.;
+	const double dz = m_has_previous ? (double)m_pending.z - m_previous_z : 0.;
+	const double ds = m_has_previous ? (double)m_pending.s1actrev - m_previous_s1actrev : 0.;
+	const double dt2 = m_time_step * m_time_step;
+	m_pending.s1_accel = (float)(ds / m_time_step);
+	m_pending.x_vel = (float)(dx / m_time_step);
+	m_pending.y_vel = (float)(dy / m_time_step);
+	m_pending.z_vel = (float)(dz / m_time_step);
+	// no forward difference yet
+	m_pending.x_accel = (float)(-dx / dt2);
+	m_pending.y_accel = (float)(-dy / dt2);
+	m_pending.z_accel = (float)(-dz / dt2);
+
+	const EngagementFileHeader *header = (const EngagementFileHeader *)m_records.GetData();
+	if (m_has_previous && header && header->count > 0)
+	{
+		EngagementRecord *previous = (EngagementRecord *)(m_records.GetWritableData() + sizeof(EngagementFileHeader)) + (header->count - 1);
+		previous->x_accel = (float)((dx - m_previous_dx) / dt2);
+		previous->y_accel = (float)((dy - m_previous_dy) / dt2);
+		previous->z_accel = (float)((dz - m_previous_dz) / dt2);
+	}
+
+	m_has_previous = true;
+	m_previous_x = m_pending.x;
+	m_previous_y = m_pending.y;
+	m_previous_z = m_pending.z;
+	m_previous_s1actrev = m_pending.s1actrev;
+	m_previous_dx = dx;
+	m_previous_dy = dy;
+	m_previous_dz = dz;
+}
+
+void BinaryEngagementWriter::flush()
+{
+	m_records.Flush();
+	m_segments.Flush();
+	m_values.Flush();
+}
+
+EngagementFilePosition BinaryEngagementWriter::position()
+{
+	EngagementFilePosition position;
+	std::memset(&position, 0, sizeof(position));
+	const EngagementFileHeader *header = (const EngagementFileHeader *)m_records.GetData();
+	position.records = header ? header->count : 0;
+	position.segments = m_segment_count;
+	position.values = m_value_count;
+	return position;
+}
+
+unsigned long long BinaryEngagementWriter::bytes_written()
+{
+	const EngagementFileHeader *header = (const EngagementFileHeader *)m_records.GetData();
+	const unsigned long long records = header ? header->count : 0;
+	return sizeof(EngagementFileHeader) + records * sizeof(EngagementRecord) +
+		   m_segment_count * sizeof(unsigned long long) + m_value_count * sizeof(float);
+}
+
+//@brief: create the writer for the requested result format
+//@param: path: result file path
+//@param: result_format: RESULT_FORMAT_TEXT or RESULT_FORMAT_BINARY
+//@ret: writer, owned by the caller
+EngagementWriter *create_engagement_writer(const char *path, int result_format)
+{
+	if (result_format == RESULT_FORMAT_BINARY)
+		return new BinaryEngagementWriter(path);
+	return new TextEngagementWriter(path);
+}
+
+//@brief: reopen a result file and continue it at a position returned by EngagementWriter::position
+//@param: path: result file path
+//@param: result_format: RESULT_FORMAT_TEXT or RESULT_FORMAT_BINARY, the format the file was written with
+//@param: position: write position to continue at, everything written behind it is dropped
+//@ret: writer, owned by the caller
+EngagementWriter *resume_engagement_writer(const char *path, int result_format, const EngagementFilePosition &position)
+{
+	if (result_format == RESULT_FORMAT_BINARY)
+		return new BinaryEngagementWriter(path, position);
+	return new TextEngagementWriter(path, position.bytes);
+}
@@ -0,0 +1,171 @@
+#pragma once
+// writers for the per-move engagement results (feature file)
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+#include "mwMappedFile.hpp"
+
+// result file formats selectable in load_file
+#define RESULT_FORMAT_TEXT 0
+#define RESULT_FORMAT_BINARY 1
+
+// header of the binary record file, see BinaryEngagementWriter
+#define RESULT_BINARY_MAGIC 0x5245574d // "MWER"
+// version 2 added the derived feature columns of EngagementRecord
+#define RESULT_BINARY_VERSION 2
+
+// default time between two rows (s) for the finite differences of the derived features
+#define RESULT_DEFAULT_TIME_STEP 0.01f
+
+#pragma pack(push, 8)
+// file header of the binary record file, followed by `count` EngagementRecord entries
+struct EngagementFileHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int record_size;
+	unsigned int reserved;
+	unsigned long long count;
+	unsigned long long reserved2[5];
+};
+
+// fixed-width per-move record of the binary result file
+struct EngagementRecord
+{
+	long long timestamp;
+	float x;
+	float y;
+	float z;
+	float s1actrev;
+	float actfeed;
+	int toolid;
+	float area;
+	float depth;
+	float width;
+	float removed_volume;
+	// derived features, computed while writing (FeaturePreprocess names in brackets):
+	// mean, sine and cosine of the engagement angle sum (rad) of the tool profile segments [Angle_Mean, Angle_Sin, Angle_Cos]
+	float angle_mean;
+	float angle_sin;
+	float angle_cos;
+	// actfeed * area [ChipThickness]
+	float chip_thickness;
+	// backward difference of s1actrev [S1ActAccel]
+	float s1_accel;
+	// backward difference of the position [XCurrVel, YCurrVel, ZCurrVel]
+	float x_vel;
+	float y_vel;
+	float z_vel;
+	// central second difference of the position, the last record assumes a standstill and is
+	// corrected once the next record is written [XCurrAccel, YCurrAccel, ZCurrAccel]
+	float x_accel;
+	float y_accel;
+	float z_accel;
+	float reserved;
+	// exclusive end index of this move in the segment section (begin is the end of the previous move)
+	unsigned long long segment_end;
+};
+#pragma pack(pop)
+
+// write position of a feature file, stored by a checkpoint to cut the file back when it is resumed
+struct EngagementFilePosition
+{
+	// size of the text file in bytes
+	unsigned long long bytes;
+	// number of records, segments and values of the binary file
+	unsigned long long records;
+	unsigned long long segments;
+	unsigned long long values;
+};
+
+//@brief: interface of the engagement result writers
+class EngagementWriter
+{
+public:
+	virtual ~EngagementWriter() {}
+
+	virtual bool good() const = 0;
+	// start a new row with the machine state of the move
+	virtual void begin_move(long long timestamp, float x, float y, float z, float s1actrev, float actfeed, int toolid) = 0;
+	// complete the row with the engagement results of the move. angles may be NULL if no engagement was reported
+	virtual void end_move(float area, float depth, float width, float removed_volume,
+						  const mwMachSimVerifier::EngagementAngleListList *angles) = 0;
+	virtual void flush() = 0;
+	// flush and return the current write position
+	virtual EngagementFilePosition position() = 0;
+	// size of the written rows including the ones not flushed yet, cheap enough for every batch
+	virtual unsigned long long bytes_written() = 0;
+	// time between two rows (s) of the derived features, only used by the formats that contain them
+	virtual void set_time_step(float seconds) {}
+};
+
+//@brief: semicolon separated text feature file, angles as nested bracket lists (degree)
+class TextEngagementWriter : public EngagementWriter
+{
+public:
+	explicit TextEngagementWriter(const char *path);
+	// continue an existing file behind its first resume_bytes bytes
+	TextEngagementWriter(const char *path, unsigned long long resume_bytes);
+
+	bool good() const override { return m_file.good(); }
+	void begin_move(long long timestamp, float x, float y, float z, float s1actrev, float actfeed, int toolid) override;
+	void end_move(float area, float depth, float width, float removed_volume,
+				  const mwMachSimVerifier::EngagementAngleListList *angles) override;
+	void flush() override { m_file.flush(); }
+	EngagementFilePosition position() override;
+	unsigned long long bytes_written() override { return (unsigned long long)m_file.tellp(); }
+
+private:
+	std::ofstream m_file;
+};
+
+//@brief: columnar binary result file readable zero-copy with numpy
+//
+// <path>      EngagementFileHeader followed by fixed-width EngagementRecord entries
+// <path>.seg  uint64 per non-empty tool profile segment: exclusive end index into <path>.val
+// <path>.val  float32 engagement angle spans (degree)
+//
+// the derived features of FeaturePreprocess are computed per row, so the file is ready for training as written
+class BinaryEngagementWriter : public EngagementWriter
+{
+public:
+	explicit BinaryEngagementWriter(const char *path);
+	// continue existing files at the given position
+	BinaryEngagementWriter(const char *path, const EngagementFilePosition &resume);
+	~BinaryEngagementWriter();
+
+	bool good() const override { return m_good; }
+	void begin_move(long long timestamp, float x, float y, float z, float s1actrev, float actfeed, int toolid) override;
+	void end_move(float area, float depth, float width, float removed_volume,
+				  const mwMachSimVerifier::EngagementAngleListList *angles) override;
+	void flush() override;
+	EngagementFilePosition position() override;
+	unsigned long long bytes_written() override;
+	void set_time_step(float seconds) override { m_time_step = seconds; }
+
+private:
+	// fill the derived features of m_pending and correct the acceleration of the previous record
+	void derive_features(double angle_sum, double angle_sin, double angle_cos, int angle_segments);
+
+	// path of the record file, the segment and value files append .seg and .val
+	std::string m_path;
+	misc::mwMappedFile m_records;
+	misc::mwMappedFile m_segments;
+	misc::mwMappedFile m_values;
+	EngagementRecord m_pending;
+	unsigned long long m_segment_count;
+	unsigned long long m_value_count;
+	bool m_good;
+	double m_time_step;
+	// state of the previous record for the finite differences
+	bool m_has_previous;
+	float m_previous_x, m_previous_y, m_previous_z, m_previous_s1actrev;
+	double m_previous_dx, m_previous_dy, m_previous_dz;
+};
+
+//@brief: create the writer for the requested result format
+EngagementWriter *create_engagement_writer(const char *path, int result_format);
+//@brief: reopen a result file written up to position and continue it from there
+EngagementWriter *resume_engagement_writer(const char *path, int result_format, const EngagementFilePosition &position);
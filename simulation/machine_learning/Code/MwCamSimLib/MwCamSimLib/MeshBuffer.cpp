@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "MeshBuffer.h"
+
+// the points are read in place as float triples
+static_assert(sizeof(float3d) == 3 * sizeof(float), "mesh points are expected to be three packed floats");
+
+MeshBuffer::MeshBuffer(const mwMachSimVerifier::MeshPtr &mesh)
+	: m_mesh(mesh)
+{
+	const mwMachSimVerifier::Mesh::pointArray &points = m_mesh->GetPoints();
+	const mwMachSimVerifier::Mesh::TriangleArray &triangles = m_mesh->GetTriangles();
+	m_indices.resize(triangles.size() * 3);
+	m_normals.resize(triangles.size() * 3);
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		size_t first, second, third;
+		triangles[i].GetIndices(first, second, third);
+		m_indices[3 * i] = (unsigned int)first;
+		m_indices[3 * i + 1] = (unsigned int)second;
+		m_indices[3 * i + 2] = (unsigned int)third;
+		const float3d normal = triangles[i].GetNormalVector();
+		m_normals[3 * i] = normal.x();
+		m_normals[3 * i + 1] = normal.y();
+		m_normals[3 * i + 2] = normal.z();
+	}
+
+	m_view.points = points.empty() ? nullptr : reinterpret_cast<const float *>(&points[0]);
+	m_view.indices = m_indices.empty() ? nullptr : &m_indices[0];
+	m_view.normals = m_normals.empty() ? nullptr : &m_normals[0];
+	m_view.num_points = points.size();
+	m_view.num_triangles = triangles.size();
+}
+
+//@brief: mesh the current stock and hand it over without writing a file
+//@param: ctx: simulation context
+//@param: view: receives the point, index and normal arrays of the mesh
+//@ret: handle that keeps the arrays alive, pass it to release_mesh. NULL if there is no stock
+MeshBuffer *get_stock_mesh(SimContext *ctx, MeshView *view)
+{
+	mwMachSimVerifier::MeshPtr mesh = ctx->verifier->GetMesh();
+	if (mesh.IsNull())
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  The stock could not be meshed" << std::endl;
+		return nullptr;
+	}
+	MeshBuffer *buffer = new MeshBuffer(mesh);
+	*view = buffer->view();
+	return buffer;
+}
+
+//@brief: release a mesh of get_stock_mesh, its arrays must not be used afterwards
+//@param: mesh: handle of get_stock_mesh, NULL is ignored
+//@ret: void
+void release_mesh(MeshBuffer *mesh)
+{
+	delete mesh;
+}
@@ -0,0 +1,38 @@
+#pragma once
+// hand-off of the stock mesh to the caller without a file, read with get_stock_mesh
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+
+#pragma pack(push, 8)
+// view of a pinned mesh, valid until release_mesh
+struct MeshView
+{
+	// num_points xyz float triples, the point array of the mesh itself
+	const float *points;
+	// num_triangles triples of point indices
+	const unsigned int *indices;
+	// num_triangles xyz float face normals
+	const float *normals;
+	unsigned long long num_points;
+	unsigned long long num_triangles;
+};
+#pragma pack(pop)
+
+//@brief: keeps a mesh alive while the caller reads its view
+//
+// the points are handed out in place. the triangles of the mesh also hold their normal indices, so the point
+// indices and face normals are gathered once into flat arrays owned by the buffer
+class MeshBuffer
+{
+public:
+	explicit MeshBuffer(const mwMachSimVerifier::MeshPtr &mesh);
+
+	const MeshView &view() const { return m_view; }
+
+private:
+	mwMachSimVerifier::MeshPtr m_mesh;
+	std::vector<unsigned int> m_indices;
+	std::vector<float> m_normals;
+	MeshView m_view;
+};
@@ -0,0 +1,190 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "MoveCoalescer.h"
+
+#include <cmath>
+
+float MovePoints::length(int i) const
+{
+	const float dx = x(i) - x(i - 1);
+	const float dy = y(i) - y(i - 1);
+	const float dz = z(i) - z(i - 1);
+	return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+//@brief: squared distance of point p from the segment a-b
+static float squared_segment_distance(const MovePoints &points, int p, int a, int b)
+{
+	const float abx = points.x(b) - points.x(a);
+	const float aby = points.y(b) - points.y(a);
+	const float abz = points.z(b) - points.z(a);
+	const float apx = points.x(p) - points.x(a);
+	const float apy = points.y(p) - points.y(a);
+	const float apz = points.z(p) - points.z(a);
+
+	const float ab_squared = abx * abx + aby * aby + abz * abz;
+	float t = ab_squared > 0 ? (apx * abx + apy * aby + apz * abz) / ab_squared : 0.f;
+	t = t < 0 ? 0.f : (t > 1 ? 1.f : t);
+
+	const float dx = apx - t * abx;
+	const float dy = apy - t * aby;
+	const float dz = apz - t * abz;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+//@brief: check if move `end` may be merged into the group that starts with move `begin`
+static bool can_extend(const int *tool_idx, const unsigned char *flags, int begin, int end)
+{
+	return tool_idx[end] == tool_idx[begin] && (flags[end] & MOVE_FLAG_CUT) == (flags[begin] & MOVE_FLAG_CUT);
+}
+
+int coalesce_moves(const MoveCoalescing &options, const MovePoints &points, const int *tool_idx, const unsigned char *flags,
+				   int begin, int limit)
+{
+	int end = begin + 1;
+	if (options.chord_tolerance <= 0)
+		return end;
+
+	const float tolerance_squared = options.chord_tolerance * options.chord_tolerance;
+	const float max_length_squared = options.max_length * options.max_length;
+	const int start = begin - 1;
+
+	while (end < limit && end - begin < COALESCE_MAX_MOVES)
+	{
+		if (!can_extend(tool_idx, flags, begin, end))
+			break;
+
+		if (options.max_length > 0)
+		{
+			const float dx = points.x(end) - points.x(start);
+			const float dy = points.y(end) - points.y(start);
+			const float dz = points.z(end) - points.z(start);
+			if (dx * dx + dy * dy + dz * dz > max_length_squared)
+				break;
+		}
+
+		// every merged sample point has to stay within the chord tolerance of the new linear move
+		bool collinear = true;
+		for (int i = begin; i < end && collinear; ++i)
+			collinear = squared_segment_distance(points, i, start, end) <= tolerance_squared;
+		if (!collinear)
+			break;
+
+		++end;
+	}
+	return end;
+}
+
+//@brief: circle through the points a, b and c in the xy plane
+//@ret: false if the points are (nearly) collinear
+static bool circumcircle(const MovePoints &points, int a, int b, int c, float &center_x, float &center_y, float &radius)
+{
+	const double ax = points.x(a), ay = points.y(a);
+	const double bx = points.x(b) - ax, by = points.y(b) - ay;
+	const double cx = points.x(c) - ax, cy = points.y(c) - ay;
+	const double d = 2 * (bx * cy - by * cx);
+	const double b_squared = bx * bx + by * by;
+	const double c_squared = cx * cx + cy * cy;
+	if (std::fabs(d) <= 1e-9 * (b_squared + c_squared))
+		return false;
+
+	const double ux = (cy * b_squared - by * c_squared) / d;
+	const double uy = (bx * c_squared - cx * b_squared) / d;
+	center_x = (float)(ax + ux);
+	center_y = (float)(ay + uy);
+	radius = (float)std::sqrt(ux * ux + uy * uy);
+	return true;
+}
+
+//@brief: check that the points start..end lie on an arc (helix) around the center within the tolerance
+//@ret: false if a point deviates, the direction of rotation changes or the sweep is too large
+static bool arc_within_tolerance(const ArcFitting &options, const MovePoints &points, int start, int end,
+								 float center_x, float center_y, float radius, float &direction)
+{
+	const double pi = 3.14159265358979323846;
+	double sweep = 0;
+	double previous = std::atan2(points.y(start) - center_y, points.x(start) - center_x);
+	direction = 0;
+	for (int i = start + 1; i <= end; ++i)
+	{
+		const float dx = points.x(i) - center_x;
+		const float dy = points.y(i) - center_y;
+		if (std::fabs(std::sqrt(dx * dx + dy * dy) - radius) > options.tolerance)
+			return false;
+
+		const double angle = std::atan2(dy, dx);
+		double delta = angle - previous;
+		if (delta > pi)
+			delta -= 2 * pi;
+		else if (delta <= -pi)
+			delta += 2 * pi;
+		// samples standing still do not decide the direction
+		if (delta * radius > options.tolerance || delta * radius < -options.tolerance)
+		{
+			if (direction == 0)
+				direction = delta > 0 ? 1.f : -1.f;
+			else if (delta * direction < 0)
+				return false;
+		}
+		sweep += delta;
+		previous = angle;
+	}
+	if (direction == 0 || std::fabs(sweep) > options.max_sweep * pi / 180)
+		return false;
+
+	// the height has to change linearly with the angle (plane arc or helix)
+	const float z_start = points.z(start);
+	const float z_change = points.z(end) - z_start;
+	double partial_sweep = 0;
+	previous = std::atan2(points.y(start) - center_y, points.x(start) - center_x);
+	for (int i = start + 1; i < end; ++i)
+	{
+		const double angle = std::atan2(points.y(i) - center_y, points.x(i) - center_x);
+		double delta = angle - previous;
+		if (delta > pi)
+			delta -= 2 * pi;
+		else if (delta <= -pi)
+			delta += 2 * pi;
+		partial_sweep += delta;
+		previous = angle;
+		if (std::fabs(points.z(i) - (z_start + (float)(partial_sweep / sweep) * z_change)) > options.tolerance)
+			return false;
+	}
+	return true;
+}
+
+int fit_arc(const ArcFitting &options, const MovePoints &points, const int *tool_idx, const unsigned char *flags,
+			int begin, int limit, CircularMove &arc)
+{
+	if (options.tolerance <= 0 || options.min_moves < 2 || begin + options.min_moves > limit)
+		return 0;
+	for (int end = begin + 1; end < begin + options.min_moves; ++end)
+		if (!can_extend(tool_idx, flags, begin, end))
+			return 0;
+
+	// grow the arc move by move as long as all samples stay on the circle through start, middle and end
+	const int start = begin - 1;
+	int fitted_end = 0;
+	for (int end = begin + options.min_moves; end <= limit && end - begin <= COALESCE_MAX_MOVES; ++end)
+	{
+		if (end > begin + options.min_moves && !can_extend(tool_idx, flags, begin, end - 1))
+			break;
+
+		// the circle through three close samples is sensitive to noise, so a failing short window gets a few longer tries
+		float center_x, center_y, radius, direction;
+		if (!circumcircle(points, start, (start + end - 1) / 2, end - 1, center_x, center_y, radius) ||
+			radius > options.max_radius || radius <= options.tolerance ||
+			!arc_within_tolerance(options, points, start, end - 1, center_x, center_y, radius, direction))
+		{
+			if (fitted_end > 0 || end - begin >= 2 * options.min_moves)
+				break;
+			continue;
+		}
+
+		arc.center_x = center_x;
+		arc.center_y = center_y;
+		arc.direction = direction;
+		fitted_end = end;
+	}
+	return fitted_end;
+}
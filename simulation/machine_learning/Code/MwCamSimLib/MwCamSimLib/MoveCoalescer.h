@@ -0,0 +1,80 @@
+#pragma once
+// merging of consecutive sampled moves into longer linear, circular and helical cuts
+
+// upper bound of moves merged into one cut, keeps the chord test of a group cheap
+#define COALESCE_MAX_MOVES 128
+
+//@brief: settings of the move coalescing in DoCutBatch, a chord tolerance of 0 disables the merging
+struct MoveCoalescing
+{
+	// maximum distance of a merged sample point from the resulting linear move
+	float chord_tolerance = 0;
+	// maximum length of a merged move, 0 for no limit
+	float max_length = 0;
+	// spread the results of a merged move over its original moves (true) or report them on the last one only (false)
+	bool redistribute = true;
+};
+
+//@brief: settings of the arc and helix fitting in DoCutBatch, a tolerance of 0 disables the fitting
+//
+// arcs are fitted in the xy plane (G17), a linear z change along the arc gives a helix
+struct ArcFitting
+{
+	// maximum distance of a sample point from the fitted arc or helix
+	float tolerance = 0;
+	// minimum number of sampled moves replaced by one circular cut
+	int min_moves = 4;
+	// larger radii are left to the linear coalescing
+	float max_radius = 1000;
+	// maximum sweep angle of one circular cut (degree), longer arcs are split
+	float max_sweep = 350;
+};
+
+//@brief: circular cut found by fit_arc, around an axis parallel to z through the center
+struct CircularMove
+{
+	float center_x;
+	float center_y;
+	// +1 counterclockwise, -1 clockwise seen from +z
+	float direction;
+};
+
+//@brief: slice of sampled moves, move i goes from point i-1 to point i. point -1 is the start point
+struct MovePoints
+{
+	float x_start;
+	float y_start;
+	float z_start;
+	const float *x_end;
+	const float *y_end;
+	const float *z_end;
+
+	float x(int i) const { return i < 0 ? x_start : x_end[i]; }
+	float y(int i) const { return i < 0 ? y_start : y_end[i]; }
+	float z(int i) const { return i < 0 ? z_start : z_end[i]; }
+	// length of move i
+	float length(int i) const;
+};
+
+//@brief: find the moves that can be simulated as one linear cut together with move `begin`
+//@param: options: coalescing settings
+//@param: points: sampled moves
+//@param: tool_idx: tool index per move, moves with a different tool are never merged
+//@param: flags: MOVE_FLAG_* per move, cutting and rapid moves are never merged
+//@param: begin: first move of the group
+//@param: limit: exclusive upper bound of the group end, the caller ends it after the next mesh snapshot step
+//@ret: exclusive end of the group, at least begin + 1
+int coalesce_moves(const MoveCoalescing &options, const MovePoints &points, const int *tool_idx, const unsigned char *flags,
+				   int begin, int limit);
+
+//@brief: fit an arc or helix to the moves starting at `begin`
+//@param: options: fitting settings
+//@param: points: sampled moves
+//@param: tool_idx: tool index per move, moves with a different tool are never merged
+//@param: flags: MOVE_FLAG_* per move, cutting and rapid moves are never merged
+//@param: begin: first move of the arc
+//@param: limit: exclusive upper bound of the arc end, the caller ends it after the next mesh snapshot step
+//@param: arc: receives the circle of the fitted cut
+//@ret: exclusive end of the fitted moves, 0 if no arc with at least options.min_moves moves fits
+int fit_arc(const ArcFitting &options, const MovePoints &points, const int *tool_idx, const unsigned char *flags,
+			int begin, int limit, CircularMove &arc);
@@ -0,0 +1,457 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "MoveRing.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// polls of an empty or full ring that only yield before the waiting side sleeps
+static const int RING_SPIN_POLLS = 64;
+
+//@brief: wait step of a producer on a full or a consumer on an empty ring
+//@param: polls: number of polls of this wait so far
+//@ret: void
+static void ring_wait(int polls)
+{
+	if (polls < RING_SPIN_POLLS)
+		std::this_thread::yield();
+	else
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+MoveRing::MoveRing()
+	: m_header(nullptr), m_records(nullptr), m_size(0),
+#ifdef _WIN32
+	  m_mapping(nullptr)
+#else
+	  m_owner(false)
+#endif
+{
+}
+
+MoveRing::~MoveRing()
+{
+	release();
+}
+
+//@brief: map the named shared memory block
+//@param: name: name of the block
+//@param: size: size of a new block, ignored when an existing block is opened
+//@param: is_new: create the block instead of opening it
+//@ret: false if the block could not be mapped
+bool MoveRing::map(const std::string &name, size_t size, bool is_new)
+{
+	release();
+	void *view = nullptr;
+#ifdef _WIN32
+	if (is_new)
+	{
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xffffffff), name.c_str());
+		// the block of a running producer or consumer is not taken over
+		if (m_mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+	}
+	else
+		m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (m_mapping == NULL)
+	{
+		m_mapping = nullptr;
+		return false;
+	}
+	view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+		return false;
+	}
+	if (!is_new)
+	{
+		MEMORY_BASIC_INFORMATION info;
+		size = VirtualQuery(view, &info, sizeof(info)) ? (size_t)info.RegionSize : 0;
+	}
+#else
+	// posix names of shared memory objects start with a slash
+	m_name = name.empty() || name[0] != '/' ? "/" + name : name;
+	// unlike windows, a block outlives its processes, a stale block of a crashed run is replaced
+	if (is_new)
+		shm_unlink(m_name.c_str());
+	const int file = shm_open(m_name.c_str(), is_new ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+	if (file < 0)
+		return false;
+	struct stat info;
+	if (is_new ? ftruncate(file, (off_t)size) != 0 : fstat(file, &info) != 0)
+	{
+		::close(file);
+		if (is_new)
+			shm_unlink(m_name.c_str());
+		return false;
+	}
+	if (!is_new)
+		size = (size_t)info.st_size;
+	view = size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+	::close(file);
+	if (view == MAP_FAILED)
+	{
+		if (is_new)
+			shm_unlink(m_name.c_str());
+		return false;
+	}
+	m_owner = is_new;
+#endif
+	m_size = size;
+	m_header = (Header *)view;
+	m_records = (MoveRecord *)((char *)view + sizeof(Header));
+	return true;
+}
+
+bool MoveRing::create(const std::string &name, unsigned long long capacity)
+{
+	// the indices are masked instead of taken modulo the capacity
+	unsigned long long rounded = 1;
+	while (rounded < capacity)
+		rounded <<= 1;
+	if (!map(name, sizeof(Header) + (size_t)rounded * sizeof(MoveRecord), true))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Move ring " << name << " could not be created" << std::endl;
+		return false;
+	}
+	Header *header = new (m_header) Header();
+	header->magic = MOVE_RING_MAGIC;
+	header->version = MOVE_RING_VERSION;
+	header->record_size = sizeof(MoveRecord);
+	header->reserved = 0;
+	header->capacity = rounded;
+	header->write_index.store(0, std::memory_order_relaxed);
+	header->read_index.store(0, std::memory_order_relaxed);
+	header->overruns.store(0, std::memory_order_relaxed);
+	header->high_water.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_release);
+	// a ring shared between processes only works with address free atomics
+	if (!header->write_index.is_lock_free())
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Move ring " << name << " needs lock-free 64 bit atomics" << std::endl;
+		release();
+		return false;
+	}
+	return true;
+}
+
+bool MoveRing::open(const std::string &name)
+{
+	if (!map(name, 0, false))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Move ring " << name << " does not exist" << std::endl;
+		return false;
+	}
+	const Header &header = *m_header;
+	const bool valid = m_size >= sizeof(Header) && header.magic == MOVE_RING_MAGIC && header.version == MOVE_RING_VERSION &&
+					   header.record_size == sizeof(MoveRecord) && header.capacity > 0 &&
+					   (header.capacity & (header.capacity - 1)) == 0 &&
+					   (m_size - sizeof(Header)) / sizeof(MoveRecord) >= header.capacity;
+	if (!valid)
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Move ring " << name << " has a different layout" << std::endl;
+		release();
+		return false;
+	}
+	return true;
+}
+
+void MoveRing::release()
+{
+#ifdef _WIN32
+	if (m_header)
+		UnmapViewOfFile(m_header);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	if (m_header)
+		munmap((void *)m_header, m_size);
+	// the block disappears with its creator, the other side keeps its mapping until it releases it
+	if (m_owner)
+		shm_unlink(m_name.c_str());
+	m_owner = false;
+	m_name.clear();
+#endif
+	m_header = nullptr;
+	m_records = nullptr;
+	m_size = 0;
+}
+
+size_t MoveRing::write(const MoveRecord *records, size_t count, int timeout_ms)
+{
+	const unsigned long long capacity = m_header->capacity;
+	const unsigned long long mask = capacity - 1;
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms > 0 ? timeout_ms : 0);
+	size_t written = 0;
+	int polls = 0;
+	while (written < count)
+	{
+		// only this side writes the write index, the read index is published by the consumer
+		const unsigned long long head = m_header->write_index.load(std::memory_order_relaxed);
+		const unsigned long long tail = m_header->read_index.load(std::memory_order_acquire);
+		const unsigned long long free = capacity - (head - tail);
+		if (free == 0)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+				break;
+			ring_wait(polls++);
+			continue;
+		}
+		polls = 0;
+
+		const size_t n = (size_t)(free < count - written ? free : count - written);
+		// at most two contiguous pieces: up to the end of the ring and from its start
+		const size_t start = (size_t)(head & mask);
+		const size_t first = (size_t)capacity - start < n ? (size_t)capacity - start : n;
+		std::memcpy(m_records + start, records + written, first * sizeof(MoveRecord));
+		std::memcpy(m_records, records + written + first, (n - first) * sizeof(MoveRecord));
+		// the release store publishes the copied records to the consumer
+		m_header->write_index.store(head + n, std::memory_order_release);
+		written += n;
+
+		const unsigned long long used = head + n - tail;
+		if (used > m_header->high_water.load(std::memory_order_relaxed))
+			m_header->high_water.store(used, std::memory_order_relaxed);
+	}
+	if (written < count)
+		m_header->overruns.fetch_add(count - written, std::memory_order_relaxed);
+	return written;
+}
+
+void MoveRing::close()
+{
+	m_header->closed.store(1, std::memory_order_release);
+}
+
+bool MoveRing::closed() const
+{
+	return m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+size_t MoveRing::read(MoveRecord *records, size_t max_count)
+{
+	const unsigned long long capacity = m_header->capacity;
+	const unsigned long long tail = m_header->read_index.load(std::memory_order_relaxed);
+	const unsigned long long head = m_header->write_index.load(std::memory_order_acquire);
+	const size_t count = (size_t)(head - tail < max_count ? head - tail : max_count);
+	const size_t start = (size_t)(tail & (capacity - 1));
+	const size_t first = (size_t)capacity - start < count ? (size_t)capacity - start : count;
+	std::memcpy(records, m_records + start, first * sizeof(MoveRecord));
+	std::memcpy(records + first, m_records, (count - first) * sizeof(MoveRecord));
+	// the slots are handed back to the producer after they were copied
+	m_header->read_index.store(tail + count, std::memory_order_release);
+	return count;
+}
+
+MoveRingStats MoveRing::stats() const
+{
+	MoveRingStats stats;
+	stats.capacity = m_header->capacity;
+	stats.read = m_header->read_index.load(std::memory_order_acquire);
+	stats.written = m_header->write_index.load(std::memory_order_acquire);
+	stats.overruns = m_header->overruns.load(std::memory_order_relaxed);
+	stats.high_water = m_header->high_water.load(std::memory_order_relaxed);
+	stats.closed = closed() ? 1 : 0;
+	stats.reserved = 0;
+	return stats;
+}
+
+//@brief: take the next records of a ring, waiting for the producer if it is empty
+//@param: ring: move ring
+//@param: records: output array with max_count elements
+//@param: max_count: maximum number of records to take
+//@param: idle_timeout_ms: longest wait for a record, negative to wait until the producer closes the ring
+//@ret: number of records taken, 0 if the ring is closed and drained or the wait timed out
+static size_t wait_read(MoveRing &ring, MoveRecord *records, size_t max_count, int idle_timeout_ms)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int polls = 0;
+	while (true)
+	{
+		const size_t count = ring.read(records, max_count);
+		if (count > 0)
+			return count;
+		// the records written before the ring was closed are visible once the close is
+		if (ring.closed())
+			return ring.read(records, max_count);
+		if (idle_timeout_ms >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(idle_timeout_ms))
+			return 0;
+		ring_wait(polls++);
+	}
+}
+
+//@brief: create a move ring in shared memory, the other side opens it with ring_open
+//@param: name: name of the shared memory block
+//@param: capacity: number of records, rounded up to a power of two
+//@ret: ring handle, NULL on error
+MoveRing *ring_create(char *name, long long capacity)
+{
+	std::unique_ptr<MoveRing> ring(new MoveRing());
+	if (!ring->create(name, capacity > 0 ? (unsigned long long)capacity : 1))
+		return nullptr;
+	return ring.release();
+}
+
+//@brief: open a move ring created by another process or thread
+//@param: name: name of the shared memory block
+//@ret: ring handle, NULL on error
+MoveRing *ring_open(char *name)
+{
+	std::unique_ptr<MoveRing> ring(new MoveRing());
+	if (!ring->open(name))
+		return nullptr;
+	return ring.release();
+}
+
+//@brief: unmap a move ring and release its handle, the block is removed when its creator releases it
+//@param: ring: ring handle
+//@ret: void
+void ring_release(MoveRing *ring)
+{
+	delete ring;
+}
+
+//@brief: producer side, append moves to a ring. if the ring stays full longer than the timeout, the
+//        remaining moves are not written and counted as overruns
+//@param: ring: ring handle
+//@param: records: moves to append
+//@param: count: number of moves
+//@param: timeout_ms: longest wait for free space, 0 to never wait
+//@ret: number of moves written
+int ring_write(MoveRing *ring, const MoveRecord *records, int count, int timeout_ms)
+{
+	return count > 0 ? (int)ring->write(records, (size_t)count, timeout_ms) : 0;
+}
+
+//@brief: producer side, no further moves follow, simulate_ring returns once the ring is drained
+//@param: ring: ring handle
+//@ret: void
+void ring_close(MoveRing *ring)
+{
+	ring->close();
+}
+
+//@brief: consumer side, take the oldest moves out of a ring without simulating them
+//@param: ring: ring handle
+//@param: records: output array with max_count elements
+//@param: max_count: maximum number of moves to take
+//@ret: number of moves taken
+int ring_read(MoveRing *ring, MoveRecord *records, int max_count)
+{
+	return max_count > 0 ? (int)ring->read(records, (size_t)max_count) : 0;
+}
+
+//@brief: read the counters of a ring
+//@param: ring: ring handle
+//@param: stats: receives the counters
+//@ret: void
+void ring_stats(MoveRing *ring, MoveRingStats *stats)
+{
+	*stats = ring->stats();
+}
+
+//@brief: simulate the moves of a ring as the producer writes them. the first record is the start position,
+//        every further record a move to its position with its own MOVE_FLAG_CUT and MOVE_FLAG_TRACE flags.
+//        all moves available at once are simulated as one batch (up to BATCH_FLUSH_SIZE), so the batches
+//        grow when the simulation falls behind the stream
+//@param: ctx: simulation context, stock, tools (with tool numbers) and config have to be set up
+//@param: ring: ring handle
+//@param: idle_timeout_ms: end the simulation when no move arrives for this long, negative to run until the
+//                         producer closes the ring
+//@param: stlPath: folder for the periodic mesh snapshots
+//@ret: last simulated step index, -1 on error
+int simulate_ring(SimContext *ctx, MoveRing *ring, int idle_timeout_ms, char *stlPath)
+{
+	std::vector<MoveRecord> records(BATCH_FLUSH_SIZE);
+	if (wait_read(*ring, &records[0], 1, idle_timeout_ms) == 0)
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Move ring has no start position" << std::endl;
+		return -1;
+	}
+	float x_start = records[0].x;
+	float y_start = records[0].y;
+	float z_start = records[0].z;
+	int tool_number_current = records[0].tool_number;
+	int tool_idx_current = find_tool_index(ctx, tool_number_current);
+	int block_nr_current = records[0].block_nr;
+	if (tool_idx_current < 0)
+		return -1;
+	set_current_tool(ctx, tool_idx_current);
+
+	std::vector<float> x(BATCH_FLUSH_SIZE), y(BATCH_FLUSH_SIZE), z(BATCH_FLUSH_SIZE);
+	std::vector<float> s1actrev(BATCH_FLUSH_SIZE), actfeed(BATCH_FLUSH_SIZE);
+	std::vector<long long> timestamp(BATCH_FLUSH_SIZE);
+	std::vector<int> toolid(BATCH_FLUSH_SIZE), tool_idx(BATCH_FLUSH_SIZE);
+	std::vector<unsigned char> move_flags(BATCH_FLUSH_SIZE);
+	int cut_id = 1;
+
+	size_t count;
+	while ((count = wait_read(*ring, &records[0], BATCH_FLUSH_SIZE, idle_timeout_ms)) > 0)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const MoveRecord &record = records[i];
+			// check if tool is changed
+			if (record.tool_number != tool_number_current)
+			{
+				tool_idx_current = find_tool_index(ctx, record.tool_number);
+				if (tool_idx_current < 0)
+					return -1;
+				tool_number_current = record.tool_number;
+			}
+			timestamp[i] = record.timestamp;
+			x[i] = record.x;
+			y[i] = record.y;
+			z[i] = record.z;
+			s1actrev[i] = record.s1actrev;
+			actfeed[i] = record.actfeed;
+			toolid[i] = record.tool_number;
+			tool_idx[i] = tool_idx_current;
+			move_flags[i] = (unsigned char)(record.flags & (MOVE_FLAG_CUT | MOVE_FLAG_TRACE));
+			block_nr_current = record.block_nr;
+		}
+
+		const int simulated = DoCutBatch(ctx, x_start, y_start, z_start, &x[0], &y[0], &z[0], &s1actrev[0], &actfeed[0],
+										 &timestamp[0], &toolid[0], &tool_idx[0], &move_flags[0], (int)count, cut_id, stlPath,
+										 NULL, NULL, NULL, NULL);
+		if (simulated != (int)count)
+			return -1;
+		x_start = x[count - 1];
+		y_start = y[count - 1];
+		z_start = z[count - 1];
+		cut_id += (int)count;
+
+		// the progress of a stream counts records instead of bytes: simulated and written so far
+		if (ctx->progress_callback)
+		{
+			const MoveRingStats stats = ring->stats();
+			ctx->progress_callback((long long)stats.read, (long long)stats.written, cut_id - 1, x_start, y_start, z_start,
+								   tool_number_current, block_nr_current);
+		}
+	}
+
+	const MoveRingStats stats = ring->stats();
+	if (stats.overruns > 0)
+		std::cout << "\033[1;33mWARNING: " << stats.overruns << " moves did not fit into the move ring (capacity " << stats.capacity << ")\033[0m" << std::endl;
+	if (ctx->feature_file)
+		ctx->feature_file->flush();
+	ctx->snapshots.flush();
+	ctx->stats.dump_if_due(true);
+	return cut_id - 1;
+}
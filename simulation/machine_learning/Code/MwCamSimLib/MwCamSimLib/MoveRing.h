@@ -0,0 +1,98 @@
+#pragma once
+// single producer / single consumer ring buffer of sampled moves in named shared memory
+#include <atomic>
+#include <string>
+
+// header of the shared memory block
+#define MOVE_RING_MAGIC 0x474e5252 // "RRNG"
+#define MOVE_RING_VERSION 1
+
+#pragma pack(push, 8)
+// one sampled machine state, written by the collectors. the first record of a stream is the start position
+struct MoveRecord
+{
+	long long timestamp;
+	float x;
+	float y;
+	float z;
+	float s1actrev;
+	float actfeed;
+	// tool number from the nc program
+	int tool_number;
+	// nc block number, 0 if unknown
+	int block_nr;
+	// MOVE_FLAG_CUT and MOVE_FLAG_TRACE
+	unsigned int flags;
+};
+
+// counters of a ring, see ring_stats
+struct MoveRingStats
+{
+	unsigned long long capacity;
+	// records written by the producer and read by the consumer since the ring was created
+	unsigned long long written;
+	unsigned long long read;
+	// records the producer could not write because the ring stayed full
+	unsigned long long overruns;
+	// highest fill level seen by the producer
+	unsigned long long high_water;
+	int closed;
+	int reserved;
+};
+#pragma pack(pop)
+
+//@brief: view of a move ring in shared memory, created by the producer and opened by the consumer or vice versa
+//
+// the block starts with a header holding the write and the read index on separate cache lines, followed by
+// capacity records (a power of two). the producer only advances the write index and the consumer only the
+// read index, so both sides work without locks; a record is published by the release store of the write
+// index after it was copied. a full ring pushes back: write waits up to a timeout for free space and counts
+// the records it could not write as overruns.
+class MoveRing
+{
+public:
+	MoveRing();
+	~MoveRing();
+
+	// create the named block, capacity is rounded up to a power of two
+	bool create(const std::string &name, unsigned long long capacity);
+	// map a block created by the other side
+	bool open(const std::string &name);
+	void release();
+
+	// producer: append up to count records, waiting at most timeout_ms for free space. returns the written count
+	size_t write(const MoveRecord *records, size_t count, int timeout_ms);
+	// producer: no further records follow, the consumer ends when the ring is drained
+	void close();
+	// consumer: take up to max_count of the oldest records
+	size_t read(MoveRecord *records, size_t max_count);
+	bool closed() const;
+	MoveRingStats stats() const;
+
+private:
+	struct Header
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned int record_size;
+		unsigned int reserved;
+		unsigned long long capacity;
+		alignas(64) std::atomic<unsigned long long> write_index;
+		alignas(64) std::atomic<unsigned long long> read_index;
+		alignas(64) std::atomic<unsigned long long> overruns;
+		std::atomic<unsigned long long> high_water;
+		std::atomic<int> closed;
+	};
+
+	bool map(const std::string &name, size_t size, bool is_new);
+
+	Header *m_header;
+	MoveRecord *m_records;
+	size_t m_size;
+#ifdef _WIN32
+	void *m_mapping;
+#else
+	std::string m_name;
+	bool m_owner;
+#endif
+};
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <map>
 
 #include "mwMachSimVerifier.hpp"
 #include "mwvEngagementHelpers.hpp"
@@ -24,6 +25,18 @@
 #include "mwTPoint2d.hpp"
 #include "mwTPoint3d.hpp"
 
+#include "AirCutCulling.h"
+#include "Checkpointer.h"
+#include "CuttingResults.h"
+#include "EngagementWriter.h"
+#include "MeshBuffer.h"
+#include "MoveCoalescer.h"
+#include "MoveRing.h"
+#include "SimStats.h"
+#include "SnapshotExporter.h"
+#include "StlWriter.h"
+#include "ThumbnailRenderer.h"
+
 // dependencies for visualzation:
 #define GLFW_INCLUDE_NONE
 #include "glfw3.h"
@@ -32,24 +45,91 @@
 // pop-up window size
 #define WIDTH 640
 
+// per-move flags of DoCutBatch
+#define MOVE_FLAG_CUT 0x01
+#define MOVE_FLAG_TRACE 0x02
+// number of buffered cuts simulated together by DoCutBatch
+#define BATCH_FLUSH_SIZE 2048
+// number of moves simulate_toolpath simulates between two animation refreshes of a visual run
+#define VISUAL_BATCH_SIZE 10
+
 typedef mwMachSimVerifier::float3d float3d;
 typedef mwMachSimVerifier::float2d float2d;
 
-extern "C" MWCAMSIM_API void init();
-extern "C" MWCAMSIM_API void load_file(char *inputfile);
-extern "C" MWCAMSIM_API void set_precision(float precision);
-extern "C" MWCAMSIM_API void set_stock(float init_x, float init_y, float init_z, float end_x, float end_y, float end_z);
+// progress of simulate_toolpath, called after every simulated batch with the last simulated move
+typedef void (*SimProgressCallback)(long long bytes_read, long long bytes_total, int cut_id, float x, float y, float z, int tool_number, int block_nr);
+
+// state of one independent simulation, created by create_context and passed to every export.
+// contexts share nothing, so different contexts may be driven from different threads
+struct SimContext
+{
+	std::unique_ptr<mwMachSimVerifier> verifier;
+	std::unique_ptr<EngagementWriter> feature_file;
+	bool isvisual = false;
+	float precision_mw = 0;
+	GLFWwindow *sim_window = nullptr;
+	VerifierUtil::SetToolsParameters tools;
+	// record the number of tools
+	int num_tool = 0;
+	// tool number of the nc program -> tool index in the simulation tool set
+	std::map<int, int> tool_numbers;
+	SimProgressCallback progress_callback = nullptr;
+	MoveCoalescing coalescing;
+	ArcFitting arc_fitting;
+	SnapshotExporter snapshots;
+	ThumbnailRenderer thumbnails;
+	StlWriter stl_writer;
+	int stl_format = STL_FORMAT_BINARY;
+	EngagementResults engagement;
+	AirCutCulling air_cuts;
+	CuttingResultStream cutting_results;
+	Checkpointer checkpoints;
+	SimStats stats;
+	// feature file of load_file, recorded in the checkpoints
+	std::string feature_path;
+	int result_format = RESULT_FORMAT_TEXT;
+	// time between two feature file rows (s) for the derived features, see set_feature_time_step
+	float feature_time_step = RESULT_DEFAULT_TIME_STEP;
+};
+
+extern "C" MWCAMSIM_API SimContext *create_context();
+extern "C" MWCAMSIM_API void destroy_context(SimContext *ctx);
+extern "C" MWCAMSIM_API void load_file(SimContext *ctx, char *inputfile, int result_format);
+extern "C" MWCAMSIM_API void close_file(SimContext *ctx);
+extern "C" MWCAMSIM_API void set_feature_time_step(SimContext *ctx, float seconds);
+extern "C" MWCAMSIM_API void set_precision(SimContext *ctx, float precision);
+extern "C" MWCAMSIM_API void set_stock(SimContext *ctx, float init_x, float init_y, float init_z, float end_x, float end_y, float end_z);
 // tool setting:
-extern "C" MWCAMSIM_API void set_tool_endmill(int tool_id, float diameter, float flute_length, float shoulder_length);
-extern "C" MWCAMSIM_API void set_tool_facemill(int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float outside_diameter, float taper_angle);
-extern "C" MWCAMSIM_API void set_tool_chamfer(int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float taper_angle, float outside_diameter);
-extern "C" MWCAMSIM_API void set_tool_drillmill(int tool_id, float diameter, float flute_length, float shoulder_length, float tip_angle);
-extern "C" MWCAMSIM_API void set_tool_barrelmill(int tool_id, float upper_diameter, float max_diameter, float flute_length, float shoulder_length, float corner_radius, float profile_radius);
-extern "C" MWCAMSIM_API void set_tool_ballmill(int tool_id, float diameter, float flute_length, float shoulder_length);
-extern "C" MWCAMSIM_API void set_current_tool(int tool_id);
-extern "C" MWCAMSIM_API void set_visualization(bool visual_mode);
-extern "C" MWCAMSIM_API void export_mesh(char *stlfile);
+extern "C" MWCAMSIM_API void set_tool_endmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length);
+extern "C" MWCAMSIM_API void set_tool_facemill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float outside_diameter, float taper_angle);
+extern "C" MWCAMSIM_API void set_tool_chamfer(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float taper_angle, float outside_diameter);
+extern "C" MWCAMSIM_API void set_tool_drillmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float tip_angle);
+extern "C" MWCAMSIM_API void set_tool_barrelmill(SimContext *ctx, int tool_id, float upper_diameter, float max_diameter, float flute_length, float shoulder_length, float corner_radius, float profile_radius);
+extern "C" MWCAMSIM_API void set_tool_ballmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length);
+extern "C" MWCAMSIM_API void set_current_tool(SimContext *ctx, int tool_id);
+extern "C" MWCAMSIM_API void set_tool_number(SimContext *ctx, int tool_id, int nc_tool_number);
+extern "C" MWCAMSIM_API void set_move_coalescing(SimContext *ctx, float chord_tolerance, float max_length, bool redistribute);
+extern "C" MWCAMSIM_API void set_arc_fitting(SimContext *ctx, float tolerance, int min_moves);
+// air cut culling (AirCutCulling.cpp):
+extern "C" MWCAMSIM_API void set_air_cut_culling(SimContext *ctx, bool enabled, float margin, int refresh_moves);
+extern "C" MWCAMSIM_API long long get_air_cut_count(SimContext *ctx);
+// mesh snapshots (SnapshotExporter.cpp):
+extern "C" MWCAMSIM_API void set_snapshot_policy(SimContext *ctx, int every_moves, float every_volume, float every_seconds, int queue_size, int keyframe_interval);
+// headless progress thumbnails (ThumbnailRenderer.cpp):
+extern "C" MWCAMSIM_API void set_thumbnail_policy(SimContext *ctx, int every_moves, float every_seconds, int width, int height);
+extern "C" MWCAMSIM_API bool render_thumbnail(SimContext *ctx, char *pngfile);
+// stl export (StlWriter.cpp):
+extern "C" MWCAMSIM_API void set_stl_format(SimContext *ctx, int format);
+// raw cutting results (CuttingResults.cpp):
+extern "C" MWCAMSIM_API void enable_cutting_results(SimContext *ctx, int capacity);
+extern "C" MWCAMSIM_API int drain_cutting_results(SimContext *ctx, CuttingResultRecord *records, int max_count, long long *dropped);
+extern "C" MWCAMSIM_API void set_visualization(SimContext *ctx, bool visual_mode);
+extern "C" MWCAMSIM_API void export_mesh(SimContext *ctx, char *stlfile);
+// mesh hand-off without files (MeshBuffer.cpp):
+extern "C" MWCAMSIM_API MeshBuffer *get_stock_mesh(SimContext *ctx, MeshView *view);
+extern "C" MWCAMSIM_API void release_mesh(MeshBuffer *mesh);
 extern "C" MWCAMSIM_API void DoCut(
+	SimContext *ctx,
 	float x_start,
 	float y_start,
 	float z_start,
@@ -64,9 +144,55 @@ extern "C" MWCAMSIM_API void DoCut(
 	bool isCut,
 	bool isTrace,
 	char *stlPath);
-extern "C" MWCAMSIM_API void engagement_analysis();
-extern "C" MWCAMSIM_API void visualization(bool isshow_in_this_turn, int show_range);
-extern "C" MWCAMSIM_API void config();
-extern "C" MWCAMSIM_API void window_close();
+extern "C" MWCAMSIM_API int DoCutBatch(
+	SimContext *ctx,
+	float x_start,
+	float y_start,
+	float z_start,
+	const float *x_end,
+	const float *y_end,
+	const float *z_end,
+	const float *s1actrev,
+	const float *actfeed,
+	const long long *timestamp,
+	const int *toolid,
+	const int *tool_idx,
+	const unsigned char *flags,
+	int count,
+	int first_cut_id,
+	char *stlPath,
+	float *areas,
+	float *depths,
+	float *widths,
+	float *removed_volumes);
+// native tool path simulation (ToolpathReader.cpp):
+extern "C" MWCAMSIM_API void set_progress_callback(SimContext *ctx, SimProgressCallback callback);
+extern "C" MWCAMSIM_API int simulate_toolpath(SimContext *ctx, char *toolpath_file, int sample_interval, bool isTrace, char *stlPath);
+// checkpoints (Checkpointer.cpp, resume_from_checkpoint in ToolpathReader.cpp):
+extern "C" MWCAMSIM_API void set_checkpoint_policy(SimContext *ctx, char *checkpoint_dir, int every_moves, float every_seconds);
+extern "C" MWCAMSIM_API int load_checkpoint(SimContext *ctx, char *checkpoint_dir);
+extern "C" MWCAMSIM_API int resume_from_checkpoint(SimContext *ctx, char *checkpoint_dir);
+// shared memory move stream (MoveRing.cpp):
+extern "C" MWCAMSIM_API MoveRing *ring_create(char *name, long long capacity);
+extern "C" MWCAMSIM_API MoveRing *ring_open(char *name);
+extern "C" MWCAMSIM_API void ring_release(MoveRing *ring);
+extern "C" MWCAMSIM_API int ring_write(MoveRing *ring, const MoveRecord *records, int count, int timeout_ms);
+extern "C" MWCAMSIM_API void ring_close(MoveRing *ring);
+extern "C" MWCAMSIM_API int ring_read(MoveRing *ring, MoveRecord *records, int max_count);
+extern "C" MWCAMSIM_API void ring_stats(MoveRing *ring, MoveRingStats *stats);
+extern "C" MWCAMSIM_API int simulate_ring(SimContext *ctx, MoveRing *ring, int idle_timeout_ms, char *stlPath);
+// hot path statistics (SimStats.cpp):
+extern "C" MWCAMSIM_API void set_stats(SimContext *ctx, bool enabled, char *dump_path, float dump_seconds);
+extern "C" MWCAMSIM_API void get_stats(SimContext *ctx, SimStatsRecord *stats);
+extern "C" MWCAMSIM_API void reset_stats(SimContext *ctx);
+extern "C" MWCAMSIM_API bool dump_stats(SimContext *ctx, char *path);
+// parallel multi-part runner (ParallelRunner.cpp):
+extern "C" MWCAMSIM_API int run_parallel(SimContext **contexts, char **toolpath_files, char **snapshot_dirs, char **stl_files, int count, int sample_interval, int num_threads);
+extern "C" MWCAMSIM_API void engagement_analysis(SimContext *ctx);
+extern "C" MWCAMSIM_API void visualization(SimContext *ctx, bool isshow_in_this_turn, int show_range);
+extern "C" MWCAMSIM_API void config(SimContext *ctx);
+extern "C" MWCAMSIM_API void window_close(SimContext *ctx);
 
-void opengl_config();
+void opengl_config(SimContext *ctx);
+bool restore_checkpoint(SimContext *ctx, const char *checkpoint_dir, CheckpointState &state);
+int find_tool_index(SimContext *ctx, int nc_tool_number);
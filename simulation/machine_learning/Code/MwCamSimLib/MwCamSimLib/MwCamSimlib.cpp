@@ -1,67 +1,90 @@
 #include "pch.h"
 #include "MwCamSimLib.h"
 
-static std::unique_ptr<mwMachSimVerifier> verifier;
-static std::ifstream tool_path_file;
-static std::ofstream feature_file;
-static bool isvisual = false;
-static float precision_mw;
-static GLFWwindow *sim_window;
-static VerifierUtil::SetToolsParameters m_tools;
-// record the number of tools
-static int num_tool = 0;
-
-//@brief: init a object of moduleworks machine simulation
+//@brief: create an independent simulation context with its own verifier
 //@param: void
-//@ret: void
-void init()
+//@ret: handle that has to be passed to every other export, release it with destroy_context
+SimContext *create_context()
 {
-	verifier = mwMachSimVerifier::Create();
+	SimContext *ctx = new SimContext();
+	ctx->verifier = mwMachSimVerifier::Create();
 	std::wcout << L"[\033[1;32mOK\033[0m]  MWCam startup" << std::endl;
+	return ctx;
 }
 
-//@brief: load the tool path file
-//@param: inputfile: file path of tool path
+//@brief: release a simulation context and everything it owns
+//@param: ctx: simulation context created by create_context
 //@ret: void
-void load_file(char *inputfile)
+void destroy_context(SimContext *ctx)
 {
+	if (ctx == nullptr)
+		return;
+	if (ctx->sim_window)
+		window_close(ctx);
+	delete ctx;
+}
 
-	feature_file.open(inputfile);
+//@brief: create the feature file that records the engagement results
+//@param: ctx: simulation context
+//@param: inputfile: file path of the feature file
+//@param: result_format: RESULT_FORMAT_TEXT (semicolon separated text) or RESULT_FORMAT_BINARY (columnar binary)
+//@ret: void
+void load_file(SimContext *ctx, char *inputfile, int result_format)
+{
+	ctx->feature_file.reset(create_engagement_writer(inputfile, result_format));
+	ctx->feature_path = inputfile;
+	ctx->result_format = result_format;
 	// check if file exists under the input path
-	if (feature_file.good())
+	if (ctx->feature_file->good())
 	{
+		ctx->feature_file->set_time_step(ctx->feature_time_step);
 		std::cout << "[\033[1;32mOK\033[0m]  Create a feature file" << std::endl;
-		feature_file << "Timestamp;"
-					 << "XCurrPos;"
-					 << "YCurrPos;"
-					 << "ZCurrPos;"
-					 << "S1Actrev;"
-					 << "Actfeed;"
-					 << "ToolID;"
-					 << "Area;"
-					 << "Depth;"
-					 << "Width;"
-					 << "Removal_Volume;"
-					 << "Angles" << std::endl;
 	}
 	else
 	{
 		std::cout << "[\033[1;31mERROR\033[0m]  Invalid feature file, please check the feature file path" << std::endl;
+		ctx->feature_file.reset();
+	}
+}
+
+//@brief: flush and close the feature file
+//@param: ctx: simulation context
+//@ret: void
+void close_file(SimContext *ctx)
+{
+	ctx->feature_file.reset();
+}
+
+//@brief: set the time between two feature file rows used for the derived velocity and acceleration columns
+//@param: ctx: simulation context
+//@param: seconds: row interval (s), the cycle time of the sampled tool path
+//@ret: void
+void set_feature_time_step(SimContext *ctx, float seconds)
+{
+	if (seconds <= 0)
+	{
+		std::cout << "\033[1;33mWARNING: Invalid feature time step " << seconds << ", keep " << ctx->feature_time_step << " s\033[0m" << std::endl;
+		return;
 	}
+	ctx->feature_time_step = seconds;
+	if (ctx->feature_file)
+		ctx->feature_file->set_time_step(seconds);
 }
 
 //@brief: set simulation precision
+//@param: ctx: simulation context
 //@param: precision: desired precision (mm)
 //@ret: void
-void set_precision(float precision)
+void set_precision(SimContext *ctx, float precision)
 {
-	precision_mw = precision;
-	verifier->ForceDataModel(mwMachSimVerifier::MWV_FM_DEXELBLOCK);
-	verifier->SetPrecision(precision);
+	ctx->precision_mw = precision;
+	ctx->verifier->ForceDataModel(mwMachSimVerifier::MWV_FM_DEXELBLOCK);
+	ctx->verifier->SetPrecision(precision);
 	std::cout << "[\033[1;32mOK\033[0m]  Set work piece precision: " << precision << std::endl;
 }
 
 //@brief: creat a raw workpiece model in simulation environment
+//@param: ctx: simulation context
 //@param: init_x: x coordinate of lower corner of workpiece
 //@param: init_y: y coordinate of lower corner of workpiece
 //@param: init_z: z coordinate of lower corner of workpiece
@@ -69,23 +92,38 @@ void set_precision(float precision)
 //@param: end_y: y coordinate of upper corner of workpiece
 //@param: end_z: z coordinate of upper corner of workpiece
 //@ret: void
-void set_stock(float init_x, float init_y, float init_z, float end_x, float end_y, float end_z)
+void set_stock(SimContext *ctx, float init_x, float init_y, float init_z, float end_x, float end_y, float end_z)
 {
 	float3d lowercorner(init_x, init_y, init_z);
 	float3d uppercorner(end_x, end_y, end_z);
 	std::cout << "[  ]  Configuring the work stock cube(it may takes serveral minutes)...\r";
-	verifier->SetStockCube(lowercorner, uppercorner);
+	ctx->verifier->SetStockCube(lowercorner, uppercorner);
+	ctx->air_cuts.reset_stock();
 	std::cout << "[\033[1;32mOK\033[0m]  Configuring the work stock cube(it may takes serveral minutes)    " << std::endl;
 }
 
+//@brief: register the cutting envelope of a tool for the delta snapshots, the air cut culling and the thumbnails
+//@param: ctx: simulation context
+//@param: tool_id: tool id in simulation
+//@param: radius: largest radius of the cutting part and the shoulder (mm)
+//@param: height: length of the cutting part and the shoulder above the tcp (mm)
+//@ret: void
+static void set_tool_envelope(SimContext *ctx, int tool_id, float radius, float height)
+{
+	ctx->snapshots.set_tool_envelope(tool_id, radius, height);
+	ctx->air_cuts.set_tool_envelope(tool_id, radius, height);
+	ctx->thumbnails.set_tool_envelope(tool_id, radius, height);
+}
+
 //@brief: set end milling tool
+//@param: ctx: simulation context
 //@param: fDiameter: cutter diameter (mm)
 //@param: fDiameterTop: shaft diameter (mm)
 //@param: fShoulderHeight: shaft length (mm)
 //@param: fHeight: cutter length (mm)
 //@param: tool_id: tool id in simulation
 //@ret: void
-void set_tool_endmill(int tool_id, float diameter, float flute_length, float shoulder_length)
+void set_tool_endmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length)
 {
 	// set tool holder
 	cadcam::mwHolderDefinition<double> holderDefinition =
@@ -109,20 +147,22 @@ void set_tool_endmill(int tool_id, float diameter, float flute_length, float sho
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, diameter / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define a flat/endmill tool with ID: " << tool_id << " Diameter: \033[1;35m" << diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m" << std::endl;
 }
 
-void set_tool_facemill(int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float outside_diameter, float taper_angle)
+void set_tool_facemill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float outside_diameter, float taper_angle)
 {
 	// set tool holder
 	cadcam::mwHolderDefinition<double> holderDefinition =
@@ -152,20 +192,23 @@ void set_tool_facemill(int tool_id, float diameter, float flute_length, float sh
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, (outside_diameter > diameter ? outside_diameter : diameter) / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define a face mill tool with ID: " << tool_id << " Diameter: \033[1;35m" << diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m" << std::endl;
 }
 
 //@brief: set chamfer milling tool
+//@param: ctx: simulation context
 //@param: cDiameter: cutter diameter (mm)
 //@param: cDiameterOut: cutter outside diameter (mm)
 //@param: cDiameterTop: shaft diameter (mm)
@@ -174,7 +217,7 @@ void set_tool_facemill(int tool_id, float diameter, float flute_length, float sh
 //@param: taperangle: taper angle (degree)
 //@param: tool_id: tool id in simulation
 //@ret: void
-void set_tool_chamfer(int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float taper_angle, float outside_diameter)
+void set_tool_chamfer(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float corner_radius, float taper_angle, float outside_diameter)
 {
 	// set tool holder
 	cadcam::mwHolderDefinition<double> holderDefinition =
@@ -202,20 +245,22 @@ void set_tool_chamfer(int tool_id, float diameter, float flute_length, float sho
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, (outside_diameter > diameter ? outside_diameter : diameter) / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define chamfer mill tool with ID: " << tool_id << "\033[0m Diameter: \033[1;35m" << diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m Taperangle: \033[1;35m" << taper_angle << "\033[0m" << std::endl;
 }
 
-void set_tool_drillmill(int tool_id, float diameter, float flute_length, float shoulder_length, float tip_angle)
+void set_tool_drillmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length, float tip_angle)
 {
 	// set tool holder
 	cadcam::mwHolderDefinition<double> holderDefinition =
@@ -240,20 +285,22 @@ void set_tool_drillmill(int tool_id, float diameter, float flute_length, float s
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, diameter / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define a drill mill tool with ID: " << tool_id << " Diameter: \033[1;35m" << diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m" << std::endl;
 }
 
-void set_tool_barrelmill(int tool_id, float upper_diameter, float max_diameter, float flute_length, float shoulder_length, float corner_radius, float profile_radius)
+void set_tool_barrelmill(SimContext *ctx, int tool_id, float upper_diameter, float max_diameter, float flute_length, float shoulder_length, float corner_radius, float profile_radius)
 {
 
 	// set tool holder
@@ -281,20 +328,22 @@ void set_tool_barrelmill(int tool_id, float upper_diameter, float max_diameter,
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, (max_diameter > upper_diameter ? max_diameter : upper_diameter) / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define a barrel mill tool with ID: " << tool_id << " Diameter: \033[1;35m" << upper_diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m" << std::endl;
 }
 
-void set_tool_ballmill(int tool_id, float diameter, float flute_length, float shoulder_length)
+void set_tool_ballmill(SimContext *ctx, int tool_id, float diameter, float flute_length, float shoulder_length)
 {
 
 	// set tool holder
@@ -319,67 +368,127 @@ void set_tool_ballmill(int tool_id, float diameter, float flute_length, float sh
 	// if current tool is the first tool, create a toolset and insert this tool
 	if (tool_id == 0)
 	{
-		m_tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
-		verifier->SetTools(m_tools);
-		++num_tool;
+		ctx->tools.push_back(VerifierUtil::SetToolParameters(pMill, tool_id));
+		ctx->verifier->SetTools(ctx->tools);
+		++ctx->num_tool;
 	}
 	else
 	{
-		verifier->AddTool(pMill, tool_id);
-		++num_tool;
+		ctx->verifier->AddTool(pMill, tool_id);
+		++ctx->num_tool;
 	}
 
+	set_tool_envelope(ctx, tool_id, diameter / 2, flute_length + shoulder_length);
+
 	std::cout << "[\033[1;32mOK\033[0m]  Define a ball mill tool with ID: " << tool_id << " Diameter: \033[1;35m" << diameter << "\033[0m Height: \033[1;35m" << flute_length << "\033[0m" << std::endl;
 }
 
 //@brief: set using tool in the current simulation step
+//@param: ctx: simulation context
 //@param: tool_id_current: tool id indicates the tool that will be used in current step
 //@ret: void
-void set_current_tool(int tool_id_current)
+void set_current_tool(SimContext *ctx, int tool_id_current)
 {
 	size_t tool_idx = (size_t)tool_id_current;
 
-	if (tool_idx > num_tool - 1)
+	if (tool_idx > ctx->num_tool - 1)
 	{
 		std::cout << "\033[1;31mERROR: Tool index out of the range of current tool set\033[0m" << std::endl;
 		return;
 	}
 
-	verifier->SetCurrentCutTool(tool_idx);
+	ctx->verifier->SetCurrentCutTool(tool_idx);
+}
+
+//@brief: merge consecutive collinear moves of DoCutBatch into longer linear cuts
+//@param: ctx: simulation context
+//@param: chord_tolerance: maximum distance of a merged sample point from the merged move, 0 disables the merging
+//@param: max_length: maximum length of a merged move, 0 for no limit
+//@param: redistribute: spread the results of a merged move over its original moves, otherwise only the last move gets them
+//        and the other traced moves of the merged move write feature rows without engagement
+//@ret: void
+void set_move_coalescing(SimContext *ctx, float chord_tolerance, float max_length, bool redistribute)
+{
+	ctx->coalescing.chord_tolerance = chord_tolerance;
+	ctx->coalescing.max_length = max_length;
+	ctx->coalescing.redistribute = redistribute;
+}
+
+//@brief: replace sampled arcs and helices in the xy plane of DoCutBatch by circular cuts
+//@param: ctx: simulation context
+//@param: tolerance: maximum distance of a sample point from the fitted arc or helix, 0 disables the fitting
+//@param: min_moves: minimum number of sampled moves replaced by one circular cut
+//@ret: void
+void set_arc_fitting(SimContext *ctx, float tolerance, int min_moves)
+{
+	ctx->arc_fitting.tolerance = tolerance;
+	ctx->arc_fitting.min_moves = min_moves;
 }
 
 //@brief: set if show the animation
+//@param: ctx: simulation context
 //@param: visual_mode: flag, if show the animation
 //@ret: void
-void set_visualization(bool visual_mode)
+void set_visualization(SimContext *ctx, bool visual_mode)
 {
-	isvisual = visual_mode;
+	ctx->isvisual = visual_mode;
 }
 
 //@brief: configurate the simualtion
-//@param: void
+//@param: ctx: simulation context
 //@ret: void
-void config()
+void config(SimContext *ctx)
 {
 	// enable engagement analysis
-	verifier->EnableEngagementTracking(true);
+	ctx->verifier->EnableEngagementTracking(true);
 	// enable material removal simulation
-	verifier->EnableVolumeTracking(true);
+	ctx->verifier->EnableVolumeTracking(true);
 	// use precise algorithm
 	VerifierUtil::EngagementOptions engagementOptions;
 	engagementOptions.SetAlgorithm(VerifierUtil::EngagementOptions::ContourBased);
-	verifier->SetEngagementOptions(engagementOptions);
+	ctx->verifier->SetEngagementOptions(engagementOptions);
 
 	// if animation is turned on, configurate the opengl before showing animation
-	if (isvisual)
+	if (ctx->isvisual)
 	{
-		opengl_config();
+		opengl_config(ctx);
 	}
 
 	std::wcout << L"[\033[1;32mOK\033[0m]  Configuring MW CAM simulation   " << std::endl;
 }
 
+//@brief: capture a due mesh snapshot and account it in the statistics
+//@param: ctx: simulation context
+//@param: stlPath: folder for the mesh snapshots
+//@param: cut_id: simulation step of the snapshot
+//@ret: void
+static void capture_snapshot(SimContext *ctx, char *stlPath, int cut_id)
+{
+	PhaseTimer timer(ctx->stats, STATS_PHASE_SNAPSHOT);
+	if (ctx->snapshots.capture(*ctx->verifier, stlPath, cut_id))
+		ctx->stats.add(STATS_COUNTER_SNAPSHOTS, 1);
+}
+
+//@brief: render a due progress thumbnail into the snapshot folder
+//@param: ctx: simulation context
+//@param: stlPath: folder for the thumbnails
+//@param: cut_id: simulation step of the thumbnail
+//@param: tcp: tool center point after the step
+//@ret: void
+static void capture_thumbnail(SimContext *ctx, char *stlPath, int cut_id, const float3d &tcp)
+{
+	// Draw and Render both consume the changed groups of the verifier, with an animation window
+	// both sides have to request all groups again
+	if (ctx->sim_window != nullptr)
+		ctx->thumbnails.force_redraw();
+	if (!ctx->thumbnails.capture(*ctx->verifier, tcp, stlPath, cut_id))
+		std::cout << "[\033[1;31mERROR\033[0m]  Could not write the thumbnail of step " << cut_id << std::endl;
+	if (ctx->sim_window != nullptr)
+		ctx->verifier->ForceRedraw();
+}
+
 //@brief: execute a single-step cutting simulation
+//@param: ctx: simulation context
 //@param: x_start: TCP start x position
 //@param: y_start: TCP start y position
 //@param: z_start: TCP start z position
@@ -394,6 +503,7 @@ void config()
 //@param: isCut: if execute a real cutting process in current step
 //@ret: void
 void DoCut(
+	SimContext *ctx,
 	float x_start,
 	float y_start,
 	float z_start,
@@ -409,98 +519,342 @@ void DoCut(
 	bool isTrace,
 	char *stlPath)
 {
-	verifier->SetMoveID(cut_id);
 	float3d p_start(x_start, y_start, z_start);
 	float3d orientation3x_start(0, 0, 1);
 	float3d p_target(x_end, y_end, z_end);
 	float3d orientation3x_target(0, 0, 1);
-	verifier->SetRapidMode(!isCut);
 	orientation3x_start.Normalize();
 	orientation3x_target.Normalize();
 
-	if (isTrace)
+	if (isTrace && ctx->feature_file)
+	{
+		ctx->feature_file->begin_move(timestamp, p_target.x(), p_target.y(), p_target.z(), s1actrev, actfeed, toolid);
+	}
+
+	// a move through the air is not cut, engagement_analysis reports zero results for it
+	ctx->air_cuts.update(*ctx->verifier);
+	ctx->air_cuts.last_culled = ctx->air_cuts.is_air(ctx->verifier->GetCurrentCutToolIndex(), p_start, p_target);
+	ctx->air_cuts.simulated(1, !ctx->air_cuts.last_culled);
+	if (ctx->air_cuts.last_culled)
 	{
-		feature_file << timestamp << ";" << p_target.x() << ";" << p_target.y() << ";" << p_target.z() << ";" << s1actrev << ";" << actfeed << ";" << toolid << ";";
+		++ctx->air_cuts.num_culled;
+		ctx->stats.add(STATS_COUNTER_MOVES, 1);
+		ctx->stats.add(STATS_COUNTER_AIR_CUTS, 1);
+		if (ctx->snapshots.due(cut_id))
+			capture_snapshot(ctx, stlPath, cut_id);
+		if (ctx->thumbnails.due(cut_id))
+			capture_thumbnail(ctx, stlPath, cut_id, p_target);
+		return;
 	}
 
+	ctx->verifier->SetMoveID(cut_id);
+	ctx->verifier->SetRapidMode(!isCut);
+
 	mwMachSimVerifier::Frame from(
 		p_start,
 		MATH::OrientationToQuaternion<float>(orientation3x_start, 0));
 	mwMachSimVerifier::Frame to(
 		p_target,
 		MATH::OrientationToQuaternion<float>(orientation3x_target, 0));
-	verifier->Cut(from, to);
-
-	if (cut_id % 100 == 0)
 	{
-		misc::mwstring currentId = std::to_string(cut_id);
-		misc::mwstring path = stlPath;
-		misc::mwstring resultName = path + "\\" + currentId + ".stl";
-		verifier->GetMesh(&resultName);
-		std::cout << "*  The generated mesh file is saved in: " << path << std::endl;
+		PhaseTimer timer(ctx->stats, STATS_PHASE_CUT);
+		ctx->verifier->Cut(from, to);
+		if (ctx->cutting_results.enabled())
+			ctx->cutting_results.collect();
 	}
+	ctx->snapshots.sweep(ctx->verifier->GetCurrentCutToolIndex(), p_start, p_target);
+	ctx->stats.add(STATS_COUNTER_MOVES, 1);
+	ctx->stats.add(STATS_COUNTER_CUTS, 1);
+
+	if (ctx->snapshots.due(cut_id))
+		capture_snapshot(ctx, stlPath, cut_id);
+	if (ctx->thumbnails.due(cut_id))
+		capture_thumbnail(ctx, stlPath, cut_id, p_target);
 }
 
-//@brief: calculate engagement analysis and removal volume. record the result
-//@param: void
-//@ret: void
-void engagement_analysis()
+//@brief: simulate a whole slice of sampled tool path points with one call
+//@param: ctx: simulation context
+//@param: x_start: TCP start x position of the first move
+//@param: y_start: TCP start y position of the first move
+//@param: z_start: TCP start z position of the first move
+//@param: x_end: TCP target x positions, one per move
+//@param: y_end: TCP target y positions, one per move
+//@param: z_end: TCP target z positions, one per move
+//@param: s1actrev: target spindle motor velocity, one per move
+//@param: actfeed: target spindle feed rate, one per move
+//@param: timestamp: timestamp, one per move
+//@param: toolid: tool number from the nc program (recorded in the feature file), one per move
+//@param: tool_idx: tool index in the simulation tool set, one per move
+//@param: flags: combination of MOVE_FLAG_CUT and MOVE_FLAG_TRACE, one per move
+//@param: count: number of moves in the slice
+//@param: first_cut_id: simulation step index of the first move
+//@param: stlPath: folder for the periodic mesh snapshots, see set_snapshot_policy
+//@param: areas, depths, widths, removed_volumes: optional (NULL) output arrays with count elements
+//@ret: number of simulated moves
+int DoCutBatch(
+	SimContext *ctx,
+	float x_start,
+	float y_start,
+	float z_start,
+	const float *x_end,
+	const float *y_end,
+	const float *z_end,
+	const float *s1actrev,
+	const float *actfeed,
+	const long long *timestamp,
+	const int *toolid,
+	const int *tool_idx,
+	const unsigned char *flags,
+	int count,
+	int first_cut_id,
+	char *stlPath,
+	float *areas,
+	float *depths,
+	float *widths,
+	float *removed_volumes)
 {
-	std::vector<mwMachSimVerifier::EngagementProfilePtr> toolProfiles;
-	std::vector<mwMachSimVerifier::EngagementAngleListList> angles;
-	std::vector<float> areas, depths, widths, removedVolumesPerCut;
-
-	verifier->GetRemovedVolumes(removedVolumesPerCut);
-	verifier->GetEngagementAngles(toolProfiles, angles);
-	verifier->GetEngagementAreas(areas);
-	verifier->GetEngagementDepths(depths);
-	verifier->GetEngagementWidths(widths);
-	// we call the analysis after every single step. Therefore only record the first value in the return result
-	feature_file << areas[0] << ";" << depths[0] << ";" << widths[0] << ";" << removedVolumesPerCut[0] << ";";
-
-	typedef std::vector<mwMachSimVerifier::EngagementAngleListList>::iterator Iter;
-	typedef mwMachSimVerifier::EngagementAngleListList::iterator Iter1;
-	typedef mwMachSimVerifier::EngagementAngleList::iterator Iter2;
-
-	if (angles.size() > 1)
-		std::cout << "\033[1;33mWARNING: More than one cut are saved in engagement angles\033[0m" << std::endl;
-	// engagement vector is a 3d array. iterate all elements and record every angle in the storage file
-	for (Iter i = angles.begin(); i != angles.end(); i++)
+	if (count <= 0)
+		return 0;
+
+	const float3d orientation(0, 0, 1);
+	const mwMachSimVerifier::Frame::Quaternion quat = MATH::OrientationToQuaternion<float>(orientation, 0);
+	mwMachSimVerifier::Frame from(float3d(x_start, y_start, z_start), quat);
+	size_t current_tool = ctx->verifier->GetCurrentCutToolIndex();
+	const MovePoints points = {x_start, y_start, z_start, x_end, y_end, z_end};
+	// exclusive end move of each buffered cut, a cut covers several moves if they were coalesced
+	std::vector<int> cut_ends;
+	// per entry of cut_ends, 1 if the move was culled as air move instead of cut
+	std::vector<char> cut_is_air;
+
+	int begin = 0;
+	while (begin < count)
 	{
-		feature_file << "[";
-		for (Iter1 j = i->begin(); j != i->end(); j++)
+		// buffer until the batch is full, the tool changes or a mesh snapshot is due.
+		// the verifier applies the tool index to the whole buffer, so tool changes split the batch
+		int end = begin;
+		cut_ends.clear();
+		cut_is_air.clear();
+		ctx->air_cuts.update(*ctx->verifier);
+		while (end < count && end - begin < BATCH_FLUSH_SIZE)
 		{
-			if (!j->empty())
-				feature_file << "[";
-			for (Iter2 k = j->begin(); k != j->end(); k++)
+			PhaseTimer timer(ctx->stats, STATS_PHASE_FRAME);
+			const size_t next_tool = (size_t)tool_idx[end];
+			if (next_tool != current_tool)
+			{
+				if (end > begin)
+					break;
+				if (next_tool > (size_t)ctx->num_tool - 1)
+				{
+					std::cout << "\033[1;31mERROR: Tool index out of the range of current tool set\033[0m" << std::endl;
+					return begin;
+				}
+				ctx->verifier->SetCurrentCutTool(next_tool);
+				current_tool = next_tool;
+			}
+
+			// a cut never runs across a mesh snapshot step, the snapshot has to see exactly that state
+			int limit = begin + BATCH_FLUSH_SIZE < count ? begin + BATCH_FLUSH_SIZE : count;
+			const int snapshot_step = ctx->snapshots.next_step(first_cut_id + end);
+			if (snapshot_step >= 0 && snapshot_step - first_cut_id + 1 < limit)
+				limit = snapshot_step - first_cut_id + 1;
+
+			// a move through the air is not buffered, it reports zero results
+			const float3d target(x_end[end], y_end[end], z_end[end]);
+			if (ctx->air_cuts.is_air(current_tool, from.getOrigin(), target))
 			{
-				const float angle_left = k->first * (float)mathdef::MW_R2D;
-				const float angle_right = k->second * (float)mathdef::MW_R2D;
+				from = mwMachSimVerifier::Frame(target, quat);
+				++end;
+				cut_ends.push_back(end);
+				cut_is_air.push_back(1);
+				++ctx->air_cuts.num_culled;
+				if (first_cut_id + end - 1 == snapshot_step)
+					break;
+				continue;
+			}
 
-				feature_file << angle_right - angle_left;
-				if (k + 1 != j->end())
-					feature_file << ",";
+			// sampled arcs and helices become one circular cut, straight runs one linear cut
+			CircularMove arc;
+			const int arc_end = fit_arc(ctx->arc_fitting, points, tool_idx, flags, end, limit, arc);
+			const int cut_end = arc_end > 0 ? arc_end : coalesce_moves(ctx->coalescing, points, tool_idx, flags, end, limit);
+			const int cut_id = first_cut_id + cut_end - 1;
+			const mwMachSimVerifier::Frame to(float3d(x_end[cut_end - 1], y_end[cut_end - 1], z_end[cut_end - 1]), quat);
+			ctx->verifier->SetMoveID((float)cut_id);
+			ctx->verifier->SetRapidMode((flags[end] & MOVE_FLAG_CUT) == 0);
+			ctx->snapshots.sweep(current_tool, from.getOrigin(), to.getOrigin());
+			if (arc_end > 0)
+			{
+				// the arc may bulge out of the box of its end points, its full circle bounds it
+				const float3d center(arc.center_x, arc.center_y, points.z(end - 1));
+				const float dx = points.x(end - 1) - arc.center_x;
+				const float dy = points.y(end - 1) - arc.center_y;
+				const float radius = std::sqrt(dx * dx + dy * dy);
+				ctx->snapshots.sweep(current_tool, center - float3d(radius, radius, 0), center + float3d(radius, radius, to.getOrigin().z() - center.z()));
+				ctx->verifier->BufferedCircularCut(from, to, center, float3d(0, 0, arc.direction));
+			}
+			else
+				ctx->verifier->BufferedCut(from, to);
+			cut_ends.push_back(cut_end);
+			cut_is_air.push_back(0);
+			from = to;
+			end = cut_end;
+
+			if (cut_id == snapshot_step)
+				break;
+		}
+
+		// a batch of air moves only leaves nothing to simulate
+		const size_t simulated = cut_ends.size() - (size_t)std::count(cut_is_air.begin(), cut_is_air.end(), 1);
+		if (simulated > 0)
+		{
+			{
+				PhaseTimer timer(ctx->stats, STATS_PHASE_CUT);
+				mwMachSimVerifier::VerificationResultVector results;
+				ctx->verifier->SimulateBufferedCuts(results);
+				if (ctx->cutting_results.enabled())
+					ctx->cutting_results.collect();
 			}
-			if (!j->empty())
-				feature_file << "]";
+			PhaseTimer timer(ctx->stats, STATS_PHASE_ENGAGEMENT);
+			ctx->engagement.fetch(*ctx->verifier);
 		}
-		feature_file << "]";
+		const std::vector<mwMachSimVerifier::EngagementAngleListList> &angles = ctx->engagement.angles;
+		const std::vector<float> &batch_areas = ctx->engagement.areas;
+		const std::vector<float> &batch_depths = ctx->engagement.depths;
+		const std::vector<float> &batch_widths = ctx->engagement.widths;
+		const std::vector<float> &batch_volumes = ctx->engagement.removed_volumes;
+
+		if (simulated > 0 && (batch_areas.size() != simulated || batch_volumes.size() != simulated || angles.size() != simulated))
+			std::cout << "\033[1;33mWARNING: Engagement result count does not match the number of buffered cuts\033[0m" << std::endl;
+
+		PhaseTimer serialize_timer(ctx->stats, STATS_PHASE_SERIALIZE);
+		int cut_begin = begin;
+		float batch_volume = 0;
+		// index of the next buffered cut in the engagement results, the air moves have none
+		size_t result = 0;
+		for (size_t i = 0; i < cut_ends.size(); ++i)
+		{
+			const int cut_end = cut_ends[i];
+			const bool has_cut = !cut_is_air[i] && result < simulated;
+			const float area = has_cut && result < batch_areas.size() ? batch_areas[result] : 0.f;
+			const float depth = has_cut && result < batch_depths.size() ? batch_depths[result] : 0.f;
+			const float width = has_cut && result < batch_widths.size() ? batch_widths[result] : 0.f;
+			const float volume = has_cut && result < batch_volumes.size() ? batch_volumes[result] : 0.f;
+			const mwMachSimVerifier::EngagementAngleListList *cut_angles = has_cut && result < angles.size() ? &angles[result] : nullptr;
+			if (!cut_is_air[i])
+				++result;
+			batch_volume += volume;
+
+			// a coalesced cut reports its engagement on every original move with the removed volume split by
+			// move length, or only on its last move
+			float cut_length = 0;
+			if (cut_end - cut_begin > 1 && ctx->coalescing.redistribute)
+				for (int move = cut_begin; move < cut_end; ++move)
+					cut_length += points.length(move);
+
+			for (int move = cut_begin; move < cut_end; ++move)
+			{
+				const bool is_last = move == cut_end - 1;
+				const bool has_result = is_last || ctx->coalescing.redistribute;
+				float move_volume = volume;
+				if (cut_end - cut_begin > 1 && ctx->coalescing.redistribute)
+					move_volume = cut_length > 0 ? volume * points.length(move) / cut_length : volume / (cut_end - cut_begin);
+				else if (!is_last)
+					move_volume = 0.f;
+
+				if (areas)
+					areas[move] = has_result ? area : 0.f;
+				if (depths)
+					depths[move] = has_result ? depth : 0.f;
+				if (widths)
+					widths[move] = has_result ? width : 0.f;
+				if (removed_volumes)
+					removed_volumes[move] = move_volume;
+
+				// every traced move gets its feature row so the rows stay one feature time step apart, the moves
+				// of a merged cut without redistribution report no engagement except the last one
+				if ((flags[move] & MOVE_FLAG_TRACE) && ctx->feature_file)
+				{
+					ctx->feature_file->begin_move(timestamp[move], x_end[move], y_end[move], z_end[move], s1actrev[move], actfeed[move], toolid[move]);
+					if (has_result)
+						ctx->feature_file->end_move(area, depth, width, move_volume, cut_angles);
+					else
+						ctx->feature_file->end_move(0.f, 0.f, 0.f, 0.f, nullptr);
+				}
+			}
+			cut_begin = cut_end;
+		}
+
+		serialize_timer.stop();
+		ctx->stats.add(STATS_COUNTER_MOVES, (unsigned long long)(end - begin));
+		ctx->stats.add(STATS_COUNTER_CUTS, simulated);
+		ctx->stats.add(STATS_COUNTER_AIR_CUTS, cut_ends.size() - simulated);
+		if (ctx->feature_file)
+			ctx->stats.set(STATS_COUNTER_FEATURE_BYTES, ctx->feature_file->bytes_written());
+
+		// the move count steps end a batch, the volume and time triggers are checked at every batch end
+		const int last_cut_id = first_cut_id + end - 1;
+		ctx->snapshots.add_removed_volume(batch_volume);
+		ctx->air_cuts.simulated(end - begin, batch_volume > 0);
+		if (ctx->snapshots.due(last_cut_id))
+			capture_snapshot(ctx, stlPath, last_cut_id);
+		if (ctx->thumbnails.due(last_cut_id))
+			capture_thumbnail(ctx, stlPath, last_cut_id, float3d(x_end[end - 1], y_end[end - 1], z_end[end - 1]));
+		ctx->stats.dump_if_due(false);
+
+		begin = end;
 	}
-	feature_file << std::endl;
+
+	return count;
+}
+
+//@brief: calculate engagement analysis and removal volume. record the result
+//@param: ctx: simulation context
+//@ret: void
+void engagement_analysis(SimContext *ctx)
+{
+	const EngagementResults &results = ctx->engagement;
+	if (ctx->air_cuts.last_culled)
+	{
+		if (ctx->feature_file)
+			ctx->feature_file->end_move(0.f, 0.f, 0.f, 0.f, nullptr);
+		return;
+	}
+	{
+		PhaseTimer timer(ctx->stats, STATS_PHASE_ENGAGEMENT);
+		ctx->engagement.fetch(*ctx->verifier);
+	}
+	if (!results.removed_volumes.empty())
+		ctx->snapshots.add_removed_volume(results.removed_volumes[0]);
+	if (!ctx->feature_file)
+		return;
+
+	if (results.angles.size() > 1)
+		std::cout << "\033[1;33mWARNING: More than one cut are saved in engagement angles\033[0m" << std::endl;
+	// we call the analysis after every single step. Therefore only record the first value in the return result
+	PhaseTimer timer(ctx->stats, STATS_PHASE_SERIALIZE);
+	ctx->feature_file->end_move(
+		results.areas.empty() ? 0.f : results.areas[0],
+		results.depths.empty() ? 0.f : results.depths[0],
+		results.widths.empty() ? 0.f : results.widths[0],
+		results.removed_volumes.empty() ? 0.f : results.removed_volumes[0],
+		results.angles.empty() ? nullptr : &results.angles[0]);
 }
 
 //@brief: show and update the animation
+//@param: ctx: simulation context
 //@param: isshow_in_this_turn: if update the frame in current step
 //@param: show_range: camera view range (mm)
 //@ret: void
-void visualization(bool isshow_in_this_turn, int show_range)
+void visualization(SimContext *ctx, bool isshow_in_this_turn, int show_range)
 {
-	if (!glfwWindowShouldClose(sim_window) && isshow_in_this_turn)
+	// no window if it could not be created (e.g. headless), see set_thumbnail_policy for progress images
+	if (ctx->sim_window == nullptr)
+		return;
+	if (!glfwWindowShouldClose(ctx->sim_window) && isshow_in_this_turn)
 	{
 		// get framebuffer size
 		int win_width, win_height;
 		float ratio;
-		glfwGetFramebufferSize(sim_window, &win_width, &win_height);
+		glfwGetFramebufferSize(ctx->sim_window, &win_width, &win_height);
 		ratio = win_width / (float)win_height;
 
 		// set view point in window
@@ -518,65 +872,76 @@ void visualization(bool isshow_in_this_turn, int show_range)
 		glMatrixMode(GL_MODELVIEW);
 		glLoadIdentity();
 		gluLookAt(-1, -1, 1, 0, 0, 0, 0, 0, 1);
-		verifier->Draw();
-		glfwSwapBuffers(sim_window);
+		ctx->verifier->Draw();
+		glfwSwapBuffers(ctx->sim_window);
 	}
-	else if (glfwWindowShouldClose(sim_window))
+	else if (glfwWindowShouldClose(ctx->sim_window))
 	{
-		glfwDestroyWindow(sim_window);
+		glfwDestroyWindow(ctx->sim_window);
+		ctx->sim_window = nullptr;
 		glfwTerminate();
+		return;
 	}
 	glfwPollEvents();
 }
 
 //@brief: save the generated mesh model
-//@param: void
+//@param: ctx: simulation context
+//@param: stlfile: file path of the mesh, written in the format of set_stl_format
 //@ret: void
-void export_mesh(char *stlfile)
+void export_mesh(SimContext *ctx, char *stlfile)
 {
 	std::wcout << L"[  ]  Cam simulation finish, save result mesh as stl file...\r";
-	misc::mwstring fileName(stlfile);
-	verifier->GetMesh(&fileName);
+	mwMachSimVerifier::MeshPtr mesh = ctx->verifier->GetMesh();
+	if (!ctx->stl_writer.write(*mesh, stlfile, ctx->stl_format))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Could not write the mesh file " << stlfile << std::endl;
+		return;
+	}
 	std::wcout << L"[\033[1;32mOK\033[0m]  Cam simulation finish, save result mesh as stl file   " << std::endl;
 	std::cout << "*  The generated mesh file is saved in: " << stlfile << std::endl;
 }
 
 //@brief: configurate the animation scene
-//@param: void
+//@param: ctx: simulation context
 //@ret: void
-void opengl_config()
+void opengl_config(SimContext *ctx)
 {
 	float3d tool_color_cut(255, 106, 106);
 	float3d tool_color_uncut(255, 193, 37);
 	float3d tool_color_abor(128, 128, 128);
 	float3d tool_color_holder(0, 0, 255);
 	// set visualization mode:
-	verifier->SetDrawMode(mwMachSimVerifier::WDM_TOOL_PATH_SEGMENT_LENGTH);
-	verifier->SetMeshColor(0.5f, 0.5f, 0.5f);
-	verifier->SetToolVisibility(true);
-	verifier->SetToolColor(0, 0, 0, 0.5);
-	verifier->SetToolColor(tool_color_cut, tool_color_uncut, tool_color_abor, tool_color_holder, 0.2);
+	ctx->verifier->SetDrawMode(mwMachSimVerifier::WDM_TOOL_PATH_SEGMENT_LENGTH);
+	ctx->verifier->SetMeshColor(0.5f, 0.5f, 0.5f);
+	ctx->verifier->SetToolVisibility(true);
+	ctx->verifier->SetToolColor(0, 0, 0, 0.5);
+	ctx->verifier->SetToolColor(tool_color_cut, tool_color_uncut, tool_color_abor, tool_color_holder, 0.2);
 
-	//  check if the intialization is successful
+	//  check if the intialization is successful, without a display the simulation continues headless
 	if (!glfwInit())
 	{
 		std::cout << "[\033[1;31mERROR\033[0m]  Intialization failed" << std::endl;
-		exit(EXIT_FAILURE);
+		std::cout << "\033[1;33mWARNING: Animation disabled, use set_thumbnail_policy for headless progress images\033[0m" << std::endl;
+		ctx->isvisual = false;
+		return;
 	}
 
 	// creata a window in OpenGL context
-	sim_window = glfwCreateWindow(WIDTH, WIDTH, "Cutting Simulation", NULL, NULL);
+	ctx->sim_window = glfwCreateWindow(WIDTH, WIDTH, "Cutting Simulation", NULL, NULL);
 
 	// check if window is created successfully
-	if (!sim_window)
+	if (!ctx->sim_window)
 	{
 		std::cout << "[\033[1;31mERROR\033[0m]  Window Initialization failed, please check if OpenGL or GLFW works correctly" << std::endl;
+		std::cout << "\033[1;33mWARNING: Animation disabled, use set_thumbnail_policy for headless progress images\033[0m" << std::endl;
 		glfwTerminate();
-		exit(EXIT_FAILURE);
+		ctx->isvisual = false;
+		return;
 	}
 
 	// create an OpenGL context
-	glfwMakeContextCurrent(sim_window);
+	glfwMakeContextCurrent(ctx->sim_window);
 
 	// to avoid screen tearing, set swap interval to 1
 	glfwSwapInterval(1);
@@ -593,10 +958,13 @@ void opengl_config()
 }
 
 //@brief: close the animation window
-//@param: void
+//@param: ctx: simulation context
 //@ret: void
-void window_close()
+void window_close(SimContext *ctx)
 {
-	glfwDestroyWindow(sim_window);
+	if (ctx->sim_window == nullptr)
+		return;
+	glfwDestroyWindow(ctx->sim_window);
+	ctx->sim_window = nullptr;
 	glfwTerminate();
 }
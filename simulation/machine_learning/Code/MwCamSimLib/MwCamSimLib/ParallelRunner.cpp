@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "ParallelRunner.h"
+
+#include <atomic>
+#include <exception>
+#include <thread>
+
+// serializes the status lines of the parallel workers
+static std::mutex log_mutex;
+
+WorkStealingPool::WorkStealingPool(size_t num_workers)
+{
+	if (num_workers == 0)
+		num_workers = 1;
+	for (size_t i = 0; i < num_workers; ++i)
+		m_queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+}
+
+void WorkStealingPool::push(size_t worker, int job)
+{
+	JobQueue &queue = *m_queues[worker % m_queues.size()];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.jobs.push_back(job);
+}
+
+//@brief: take the most recently queued job of the worker
+//@param: worker: index of the worker
+//@param: job: receives the job
+//@ret: false if the queue of the worker is empty
+bool WorkStealingPool::pop_local(size_t worker, int &job)
+{
+	JobQueue &queue = *m_queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty())
+		return false;
+	job = queue.jobs.back();
+	queue.jobs.pop_back();
+	return true;
+}
+
+//@brief: take the oldest job of another worker, the victims are visited round robin
+//@param: thief: index of the idle worker
+//@param: job: receives the job
+//@ret: false if all other queues are empty
+bool WorkStealingPool::steal(size_t thief, int &job)
+{
+	for (size_t i = 1; i < m_queues.size(); ++i)
+	{
+		JobQueue &queue = *m_queues[(thief + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+		job = queue.jobs.front();
+		queue.jobs.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::work(size_t worker, const std::function<void(int job)> &task)
+{
+	// jobs never spawn new jobs, so a worker that finds every queue empty is done
+	int job;
+	while (pop_local(worker, job) || steal(worker, job))
+		task(job);
+}
+
+void WorkStealingPool::run(const std::function<void(int job)> &task)
+{
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < m_queues.size(); ++i)
+		threads.emplace_back(&WorkStealingPool::work, this, i, std::cref(task));
+	// the calling thread is worker 0
+	work(0, task);
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+//@brief: simulate several independent parts on a work-stealing thread pool
+//@param: contexts: one simulation context per part, stock, tools (with tool numbers), feature file and config have to be set up
+//@param: toolpath_files: tool path file per part
+//@param: snapshot_dirs: folder for the periodic mesh snapshots per part
+//@param: stl_files: final mesh file per part, may be NULL or contain NULL entries to skip the export
+//@param: count: number of parts
+//@param: sample_interval: row sampling interval of the tool path files
+//@param: num_threads: number of parts simulated at the same time, 0 for one per core
+//@ret: number of successfully simulated parts
+int run_parallel(SimContext **contexts, char **toolpath_files, char **snapshot_dirs, char **stl_files, int count, int sample_interval, int num_threads)
+{
+	if (count <= 0)
+		return 0;
+
+	unsigned int num_cores = std::thread::hardware_concurrency();
+	if (num_cores == 0)
+		num_cores = 1;
+	size_t num_workers = num_threads > 0 ? (size_t)num_threads : (size_t)num_cores;
+	if (num_workers > (size_t)count)
+		num_workers = (size_t)count;
+
+	// split the cores among the verifiers that run at the same time, so they do not oversubscribe the machine
+	int threads_per_part = (int)(num_cores / num_workers);
+	if (threads_per_part < 1)
+		threads_per_part = 1;
+	for (int i = 0; i < count; ++i)
+	{
+		contexts[i]->verifier->LimitThreadCount(threads_per_part);
+		contexts[i]->stl_writer.set_num_threads(threads_per_part);
+	}
+
+	// longest tool paths first, so the stealing only has to balance the short tail
+	std::vector<std::pair<long long, int>> jobs;
+	for (int i = 0; i < count; ++i)
+	{
+		std::ifstream toolpath(toolpath_files[i], std::ios::binary | std::ios::ate);
+		jobs.push_back(std::make_pair(toolpath.good() ? (long long)toolpath.tellg() : 0LL, i));
+	}
+	std::sort(jobs.begin(), jobs.end(), std::greater<std::pair<long long, int>>());
+
+	// the workers pop from the back of their queue, so the largest job of a worker is queued last
+	WorkStealingPool pool(num_workers);
+	for (int i = count - 1; i >= 0; --i)
+		pool.push((size_t)i % num_workers, jobs[i].second);
+
+	std::cout << "[\033[1;32mOK\033[0m]  Simulating " << count << " parts on " << num_workers << " workers with "
+			  << threads_per_part << " verifier threads each" << std::endl;
+
+	std::atomic<int> num_succeeded(0);
+	pool.run([&](int part) {
+		SimContext *ctx = contexts[part];
+		int simulated = -1;
+		try
+		{
+			simulated = simulate_toolpath(ctx, toolpath_files[part], sample_interval, ctx->feature_file != nullptr, snapshot_dirs[part]);
+			if (simulated >= 0 && stl_files && stl_files[part])
+				export_mesh(ctx, stl_files[part]);
+		}
+		catch (const std::exception &e)
+		{
+			std::lock_guard<std::mutex> lock(log_mutex);
+			std::cout << "[\033[1;31mERROR\033[0m]  " << toolpath_files[part] << ": " << e.what() << std::endl;
+			simulated = -1;
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(log_mutex);
+			std::cout << "[\033[1;31mERROR\033[0m]  " << toolpath_files[part] << ": simulation failed" << std::endl;
+			simulated = -1;
+		}
+
+		if (simulated >= 0)
+		{
+			++num_succeeded;
+			std::lock_guard<std::mutex> lock(log_mutex);
+			std::cout << "[\033[1;32mOK\033[0m]  Simulated " << simulated << " moves of " << toolpath_files[part] << std::endl;
+		}
+	});
+
+	return num_succeeded;
+}
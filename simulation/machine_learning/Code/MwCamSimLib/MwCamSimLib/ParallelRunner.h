@@ -0,0 +1,34 @@
+#pragma once
+// work-stealing thread pool that simulates several independent parts at once
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//@brief: fixed set of workers, each owning a job queue. a worker takes jobs from the back of its own
+//        queue and, once that is empty, steals from the front of the other queues
+class WorkStealingPool
+{
+public:
+	explicit WorkStealingPool(size_t num_workers);
+
+	size_t num_workers() const { return m_queues.size(); }
+	// queue a job on the given worker, only valid before run
+	void push(size_t worker, int job);
+	// execute all queued jobs and block until every worker is idle
+	void run(const std::function<void(int job)> &task);
+
+private:
+	struct JobQueue
+	{
+		std::mutex mutex;
+		std::deque<int> jobs;
+	};
+
+	bool pop_local(size_t worker, int &job);
+	bool steal(size_t thief, int &job);
+	void work(size_t worker, const std::function<void(int job)> &task);
+
+	std::vector<std::unique_ptr<JobQueue>> m_queues;
+};
@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "SimStats.h"
+
+#include <cstdio>
+
+static const char *STATS_PHASE_NAMES[STATS_PHASE_COUNT] = {"frame", "cut", "engagement", "serialize", "snapshot"};
+static const char *STATS_COUNTER_NAMES[STATS_COUNTER_COUNT] = {"moves", "cuts", "air_cuts", "feature_bytes", "snapshots"};
+
+int LatencyHistogram::bucket(unsigned long long ns)
+{
+	if (ns < 16)
+		return (int)ns;
+	int exponent = 0;
+	for (unsigned long long v = ns; v > 1; v >>= 1)
+		++exponent;
+	const int sub_bucket = (int)((ns >> (exponent - STATS_SUB_BUCKET_BITS)) & 15);
+	return 16 + (exponent - STATS_SUB_BUCKET_BITS) * 16 + sub_bucket;
+}
+
+unsigned long long LatencyHistogram::bucket_limit(int bucket)
+{
+	if (bucket < 16)
+		return (unsigned long long)bucket;
+	const int shift = (bucket - 16) / 16;
+	const unsigned long long sub_bucket = (unsigned long long)((bucket - 16) % 16);
+	// the top bucket ends at the largest value
+	if (shift + STATS_SUB_BUCKET_BITS >= 63 && sub_bucket == 15)
+		return ~0ULL;
+	return ((16 + sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long ns)
+{
+	std::atomic<unsigned long long> &counter = m_buckets[bucket(ns)];
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_total.store(m_total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	if (ns > m_max.load(std::memory_order_relaxed))
+		m_max.store(ns, std::memory_order_relaxed);
+	// the count is published last, a reader never sees more samples than buckets
+	m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LatencyHistogram::reset()
+{
+	for (int i = 0; i < STATS_BUCKETS; ++i)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+	m_total.store(0, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+	m_count.store(0, std::memory_order_release);
+}
+
+PhaseStats LatencyHistogram::summary() const
+{
+	PhaseStats stats;
+	stats.count = m_count.load(std::memory_order_acquire);
+	stats.total_ns = m_total.load(std::memory_order_relaxed);
+	stats.max_ns = m_max.load(std::memory_order_relaxed);
+	stats.p50_ns = stats.p90_ns = stats.p99_ns = stats.p999_ns = 0;
+	if (stats.count == 0)
+		return stats;
+
+	// ranks of the percentiles, the buckets are walked once
+	const double fractions[4] = {0.5, 0.9, 0.99, 0.999};
+	unsigned long long *results[4] = {&stats.p50_ns, &stats.p90_ns, &stats.p99_ns, &stats.p999_ns};
+	int next = 0;
+	unsigned long long seen = 0;
+	for (int i = 0; i < STATS_BUCKETS && next < 4; ++i)
+	{
+		seen += m_buckets[i].load(std::memory_order_relaxed);
+		while (next < 4 && (double)seen >= fractions[next] * (double)stats.count)
+		{
+			const unsigned long long limit = bucket_limit(i);
+			*results[next++] = limit < stats.max_ns ? limit : stats.max_ns;
+		}
+	}
+	return stats;
+}
+
+SimStats::SimStats()
+	: m_enabled(true), m_dump_seconds(0), m_last_dump(std::chrono::steady_clock::now())
+{
+	for (int i = 0; i < STATS_COUNTER_COUNT; ++i)
+		m_counters[i].store(0, std::memory_order_relaxed);
+}
+
+void SimStats::set_dump(const char *path, float every_seconds)
+{
+	m_dump_path = path ? path : "";
+	m_dump_seconds = every_seconds;
+	m_last_dump = std::chrono::steady_clock::now();
+}
+
+void SimStats::read(SimStatsRecord &record) const
+{
+	for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+		record.phases[i] = m_phases[i].summary();
+	for (int i = 0; i < STATS_COUNTER_COUNT; ++i)
+		record.counters[i] = m_counters[i].load(std::memory_order_relaxed);
+}
+
+void SimStats::reset()
+{
+	for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+		m_phases[i].reset();
+	for (int i = 0; i < STATS_COUNTER_COUNT; ++i)
+		m_counters[i].store(0, std::memory_order_relaxed);
+}
+
+void SimStats::dump_if_due(bool force)
+{
+	if (m_dump_path.empty() || (!force && m_dump_seconds <= 0))
+		return;
+	const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - m_last_dump;
+	if (!force && elapsed.count() < m_dump_seconds)
+		return;
+	m_last_dump = std::chrono::steady_clock::now();
+	if (!dump(m_dump_path))
+		std::cout << "[\033[1;31mERROR\033[0m]  Statistics could not be written to " << m_dump_path << std::endl;
+}
+
+//@brief: write the statistics as json, the file is replaced in one step so a reader never sees half of it
+//@param: path: json file
+//@ret: false if the file could not be written
+bool SimStats::dump(const std::string &path) const
+{
+	SimStatsRecord record;
+	read(record);
+	const std::string temp_path = path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::trunc);
+		file << "{\n  \"phases\": {\n";
+		for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+		{
+			const PhaseStats &phase = record.phases[i];
+			file << "    \"" << STATS_PHASE_NAMES[i] << "\": {\"count\": " << phase.count << ", \"total_ns\": " << phase.total_ns
+				 << ", \"max_ns\": " << phase.max_ns << ", \"p50_ns\": " << phase.p50_ns << ", \"p90_ns\": " << phase.p90_ns
+				 << ", \"p99_ns\": " << phase.p99_ns << ", \"p999_ns\": " << phase.p999_ns << "}"
+				 << (i + 1 < STATS_PHASE_COUNT ? ",\n" : "\n");
+		}
+		file << "  },\n  \"counters\": {\n";
+		for (int i = 0; i < STATS_COUNTER_COUNT; ++i)
+			file << "    \"" << STATS_COUNTER_NAMES[i] << "\": " << record.counters[i] << (i + 1 < STATS_COUNTER_COUNT ? ",\n" : "\n");
+		file << "  }\n}\n";
+		if (!file.good())
+			return false;
+	}
+	// rename does not replace an existing file on windows
+	std::remove(path.c_str());
+	return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+//@brief: enable the hot path statistics and their periodic json dump
+//@param: ctx: simulation context
+//@param: enabled: if time the phases, the counters are always kept
+//@param: dump_path: json file rewritten every dump_seconds, NULL disables the dump
+//@param: dump_seconds: wall time between two dumps (s), checked at the end of every batch
+//@ret: void
+void set_stats(SimContext *ctx, bool enabled, char *dump_path, float dump_seconds)
+{
+	ctx->stats.set_enabled(enabled);
+	ctx->stats.set_dump(dump_path, dump_seconds);
+}
+
+//@brief: read the latency summaries and counters, may be called from another thread while the context simulates
+//@param: ctx: simulation context
+//@param: stats: receives the statistics
+//@ret: void
+void get_stats(SimContext *ctx, SimStatsRecord *stats)
+{
+	ctx->stats.read(*stats);
+}
+
+//@brief: clear the histograms and counters
+//@param: ctx: simulation context
+//@ret: void
+void reset_stats(SimContext *ctx)
+{
+	ctx->stats.reset();
+}
+
+//@brief: write the statistics as json
+//@param: ctx: simulation context
+//@param: path: json file
+//@ret: false if the file could not be written
+bool dump_stats(SimContext *ctx, char *path)
+{
+	return ctx->stats.dump(path);
+}
@@ -0,0 +1,130 @@
+#pragma once
+// latency histograms and counters of the cutting hot path, read with get_stats
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// phases timed by SimStats, every sample is one pass of the phase
+#define STATS_PHASE_FRAME 0		  // planning, frame construction and buffering of one cut
+#define STATS_PHASE_CUT 1		  // Cut of DoCut or SimulateBufferedCuts of a batch
+#define STATS_PHASE_ENGAGEMENT 2  // engagement results of a cut or batch
+#define STATS_PHASE_SERIALIZE 3	  // feature file rows of a batch
+#define STATS_PHASE_SNAPSHOT 4	  // capture of a mesh snapshot
+#define STATS_PHASE_COUNT 5
+
+// counters of SimStats
+#define STATS_COUNTER_MOVES 0		  // simulated moves
+#define STATS_COUNTER_CUTS 1		  // cuts passed to the verifier, fewer than moves if coalesced or culled
+#define STATS_COUNTER_AIR_CUTS 2	  // moves skipped by the air cut culling
+#define STATS_COUNTER_FEATURE_BYTES 3 // size of the feature file
+#define STATS_COUNTER_SNAPSHOTS 4	  // captured mesh snapshots
+#define STATS_COUNTER_COUNT 5
+
+// log-linear buckets: 16 exact buckets below 16 ns, then 16 sub-buckets per power of two (<= 6.25% error)
+#define STATS_SUB_BUCKET_BITS 4
+#define STATS_BUCKETS (16 + (64 - STATS_SUB_BUCKET_BITS) * 16)
+
+#pragma pack(push, 8)
+// summary of one phase (ns), percentiles are the upper bound of their bucket
+struct PhaseStats
+{
+	unsigned long long count;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long long p50_ns;
+	unsigned long long p90_ns;
+	unsigned long long p99_ns;
+	unsigned long long p999_ns;
+};
+
+// buffer of get_stats
+struct SimStatsRecord
+{
+	PhaseStats phases[STATS_PHASE_COUNT];
+	unsigned long long counters[STATS_COUNTER_COUNT];
+};
+#pragma pack(pop)
+
+//@brief: hdr style latency histogram with a single writer
+//
+// the owning thread updates the buckets with plain relaxed loads and stores, other threads may read a
+// consistent enough summary at any time without locks
+class LatencyHistogram
+{
+public:
+	LatencyHistogram() { reset(); }
+
+	void record(unsigned long long ns);
+	void reset();
+	PhaseStats summary() const;
+	// bucket of a value and the largest value of a bucket
+	static int bucket(unsigned long long ns);
+	static unsigned long long bucket_limit(int bucket);
+
+private:
+	std::atomic<unsigned long long> m_buckets[STATS_BUCKETS];
+	std::atomic<unsigned long long> m_count;
+	std::atomic<unsigned long long> m_total;
+	std::atomic<unsigned long long> m_max;
+};
+
+//@brief: hot path statistics of one simulation context, written by the thread driving it
+class SimStats
+{
+public:
+	SimStats();
+
+	bool enabled() const { return m_enabled; }
+	void set_enabled(bool enabled) { m_enabled = enabled; }
+	// write the statistics as json to path every every_seconds (checked at batch ends), an empty path disables it
+	void set_dump(const char *path, float every_seconds);
+
+	void record(int phase, unsigned long long ns) { m_phases[phase].record(ns); }
+	void add(int counter, unsigned long long value)
+	{
+		m_counters[counter].store(m_counters[counter].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+	void set(int counter, unsigned long long value) { m_counters[counter].store(value, std::memory_order_relaxed); }
+
+	void read(SimStatsRecord &record) const;
+	void reset();
+	// write the json dump if it is due, or whenever a dump path is set if forced
+	void dump_if_due(bool force);
+	bool dump(const std::string &path) const;
+
+private:
+	bool m_enabled;
+	LatencyHistogram m_phases[STATS_PHASE_COUNT];
+	std::atomic<unsigned long long> m_counters[STATS_COUNTER_COUNT];
+	std::string m_dump_path;
+	float m_dump_seconds;
+	std::chrono::steady_clock::time_point m_last_dump;
+};
+
+//@brief: times one pass of a phase from construction to destruction
+class PhaseTimer
+{
+public:
+	PhaseTimer(SimStats &stats, int phase)
+		: m_stats(stats), m_phase(phase), m_active(stats.enabled())
+	{
+		if (m_active)
+			m_start = std::chrono::steady_clock::now();
+	}
+	~PhaseTimer() { stop(); }
+
+	// end the pass before the scope ends
+	void stop()
+	{
+		if (m_active)
+			m_stats.record(m_phase, (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+										std::chrono::steady_clock::now() - m_start).count());
+		m_active = false;
+	}
+
+private:
+	SimStats &m_stats;
+	int m_phase;
+	bool m_active;
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "SnapshotExporter.h"
+
+SnapshotExporter::SnapshotExporter()
+	: m_removed_volume(0), m_last_snapshot(std::chrono::steady_clock::now()), m_num_dropped(0), m_has_swept(false),
+	  m_since_keyframe(0), m_need_keyframe(false), m_stl_format(STL_FORMAT_BINARY), m_busy(false), m_stop(false)
+{
+	// the writer runs next to the cutting, it must not take the cores of the verifier
+	m_writer.set_num_threads(1);
+}
+
+SnapshotExporter::~SnapshotExporter()
+{
+	// the queued snapshots are still written before the thread ends
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_job_ready.notify_one();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void SnapshotExporter::set_policy(const SnapshotPolicy &policy)
+{
+	m_policy = policy;
+	reset_triggers();
+	// the next snapshot starts a new keyframe chain and index
+	m_has_swept = false;
+	m_since_keyframe = 0;
+	m_index_folder.clear();
+}
+
+void SnapshotExporter::set_stl_format(int format)
+{
+	flush();
+	m_stl_format = format;
+}
+
+int SnapshotExporter::next_step(int cut_id) const
+{
+	if (m_policy.every_moves <= 0)
+		return -1;
+	const int remainder = cut_id % m_policy.every_moves;
+	return remainder == 0 ? cut_id : cut_id + m_policy.every_moves - remainder;
+}
+
+void SnapshotExporter::add_removed_volume(float volume)
+{
+	m_removed_volume += volume;
+}
+
+void SnapshotExporter::set_tool_envelope(int tool_id, float radius, float height)
+{
+	if (tool_id < 0)
+		return;
+	if ((size_t)tool_id >= m_tool_envelopes.size())
+		m_tool_envelopes.resize((size_t)tool_id + 1, ToolEnvelope{0, 0});
+	m_tool_envelopes[tool_id].radius = radius;
+	m_tool_envelopes[tool_id].height = height;
+}
+
+void SnapshotExporter::sweep(size_t tool_id, const float3d &p1, const float3d &p2)
+{
+	if (m_policy.keyframe_interval <= 0)
+		return;
+	// the tool points up from the tcp, so the envelope reaches radius around it and height above it
+	const ToolEnvelope envelope = tool_id < m_tool_envelopes.size() ? m_tool_envelopes[tool_id] : ToolEnvelope{0, 0};
+	const float3d low(
+		(p1.x() < p2.x() ? p1.x() : p2.x()) - envelope.radius,
+		(p1.y() < p2.y() ? p1.y() : p2.y()) - envelope.radius,
+		p1.z() < p2.z() ? p1.z() : p2.z());
+	const float3d high(
+		(p1.x() > p2.x() ? p1.x() : p2.x()) + envelope.radius,
+		(p1.y() > p2.y() ? p1.y() : p2.y()) + envelope.radius,
+		(p1.z() > p2.z() ? p1.z() : p2.z()) + envelope.height);
+	if (!m_has_swept)
+	{
+		m_swept_min = low;
+		m_swept_max = high;
+		m_has_swept = true;
+		return;
+	}
+	m_swept_min = float3d(
+		low.x() < m_swept_min.x() ? low.x() : m_swept_min.x(),
+		low.y() < m_swept_min.y() ? low.y() : m_swept_min.y(),
+		low.z() < m_swept_min.z() ? low.z() : m_swept_min.z());
+	m_swept_max = float3d(
+		high.x() > m_swept_max.x() ? high.x() : m_swept_max.x(),
+		high.y() > m_swept_max.y() ? high.y() : m_swept_max.y(),
+		high.z() > m_swept_max.z() ? high.z() : m_swept_max.z());
+}
+
+bool SnapshotExporter::due(int cut_id) const
+{
+	if (m_policy.every_moves > 0 && cut_id % m_policy.every_moves == 0)
+		return true;
+	if (m_policy.every_volume > 0 && m_removed_volume >= m_policy.every_volume)
+		return true;
+	if (m_policy.every_seconds > 0)
+	{
+		const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - m_last_snapshot;
+		return elapsed.count() >= m_policy.every_seconds;
+	}
+	return false;
+}
+
+void SnapshotExporter::reset_triggers()
+{
+	m_removed_volume = 0;
+	m_last_snapshot = std::chrono::steady_clock::now();
+}
+
+bool SnapshotExporter::capture(mwMachSimVerifier &verifier, const char *folder, int cut_id)
+{
+	// a dropped snapshot also restarts the triggers, otherwise every following step would retry it.
+	// the swept region keeps growing, so the next delta still covers the dropped one
+	reset_triggers();
+	const bool is_async = m_policy.queue_size > 0;
+	if (is_async)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ((int)m_jobs.size() >= m_policy.queue_size)
+		{
+			++m_num_dropped;
+			return false;
+		}
+	}
+
+	Job job;
+	job.folder = folder;
+	job.cut_id = cut_id;
+	const bool need_keyframe = m_need_keyframe.exchange(false);
+	job.is_delta = !need_keyframe && m_policy.keyframe_interval > 0 && m_since_keyframe > 0 && m_since_keyframe < m_policy.keyframe_interval;
+	if (job.is_delta)
+	{
+		// nothing was cut since the previous snapshot
+		if (!m_has_swept)
+			return true;
+		const float margin = 2 * verifier.GetPrecision();
+		job.box_min = m_swept_min - float3d(margin, margin, margin);
+		job.box_max = m_swept_max + float3d(margin, margin, margin);
+	}
+	m_since_keyframe = job.is_delta ? m_since_keyframe + 1 : 1;
+	m_has_swept = false;
+
+	if (!is_async)
+	{
+		write_snapshot(verifier, job);
+		return true;
+	}
+
+	// only the stock serialization runs on the cutting thread, the buffer is empty at every snapshot step
+	job.stock.reset(new misc::mwMemoryIOStream());
+	verifier.SaveStock(*job.stock);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+		if (!m_thread.joinable())
+			m_thread = std::thread(&SnapshotExporter::work, this);
+	}
+	m_job_ready.notify_one();
+	return true;
+}
+
+//@brief: mesh the stock of the mesher verifier into the snapshot file and list it in the index
+//@param: mesher: verifier holding the stock of the snapshot
+//@param: job: snapshot to write
+//@ret: void
+void SnapshotExporter::write_snapshot(mwMachSimVerifier &mesher, const Job &job)
+{
+	// the clipped sides of a delta stay open, the reader replaces exactly this box of the previous state
+	const std::string resultName = job.folder + "\\" + std::to_string(job.cut_id) + (job.is_delta ? "_delta.stl" : ".stl");
+	mwMachSimVerifier::MeshPtr mesh = job.is_delta ? mesher.GetMeshInBoundingBox(job.box_min, job.box_max) : mesher.GetMesh();
+	if (!m_writer.write(*mesh, resultName, m_stl_format))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Could not write the mesh file " << resultName << std::endl;
+		m_need_keyframe = true;
+		return;
+	}
+	std::cout << "*  The generated mesh file is saved in: " << job.folder << std::endl;
+
+	if (m_policy.keyframe_interval <= 0)
+		return;
+	// a new folder starts a new index, an index left over from an earlier run is overwritten
+	const bool is_new_index = job.folder != m_index_folder;
+	m_index_folder = job.folder;
+	std::ofstream index(job.folder + "\\snapshots.idx", is_new_index ? std::ios::trunc : std::ios::app);
+	const float3d box_min = job.is_delta ? job.box_min : float3d(0, 0, 0);
+	const float3d box_max = job.is_delta ? job.box_max : float3d(0, 0, 0);
+	index << job.cut_id << (job.is_delta ? " D " : " K ") << box_min.x() << ' ' << box_min.y() << ' ' << box_min.z() << ' '
+		  << box_max.x() << ' ' << box_max.y() << ' ' << box_max.z() << '\n';
+}
+
+void SnapshotExporter::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_jobs.empty() && !m_busy; });
+	if (m_num_dropped > 0)
+	{
+		std::cout << "\033[1;33mWARNING: " << m_num_dropped << " mesh snapshots were dropped, the snapshot writer could not keep up\033[0m" << std::endl;
+		m_num_dropped = 0;
+	}
+}
+
+//@brief: writer thread, meshes the queued stocks with a private verifier
+void SnapshotExporter::work()
+{
+	std::unique_ptr<mwMachSimVerifier> mesher = mwMachSimVerifier::Create();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_job_ready.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+		if (m_jobs.empty())
+			break;
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		m_busy = true;
+		lock.unlock();
+
+		try
+		{
+			job.stock->Rewind();
+			mesher->LoadStock(*job.stock);
+			write_snapshot(*mesher, job);
+		}
+		catch (...)
+		{
+			m_need_keyframe = true;
+			std::cout << "[\033[1;31mERROR\033[0m]  Mesh snapshot " << job.cut_id << " in " << job.folder << " could not be written" << std::endl;
+		}
+
+		lock.lock();
+		m_busy = false;
+		m_idle.notify_all();
+	}
+}
+
+//@brief: set when the simulation writes the periodic mesh snapshots into the snapshot folder
+//@param: ctx: simulation context
+//@param: every_moves: snapshot on every step index that is a multiple of every_moves, 0 disables
+//@param: every_volume: snapshot after this removed volume (mm^3), 0 disables
+//@param: every_seconds: snapshot after this wall time (s), 0 disables
+//@param: queue_size: snapshots waiting for the writer thread before new ones are dropped, 0 writes them synchronously
+//@param: keyframe_interval: every n-th snapshot is a full mesh, the others are deltas of the swept region. 0 for full meshes only
+//@ret: void
+void set_snapshot_policy(SimContext *ctx, int every_moves, float every_volume, float every_seconds, int queue_size, int keyframe_interval)
+{
+	ctx->snapshots.flush();
+	SnapshotPolicy policy;
+	policy.every_moves = every_moves;
+	policy.every_volume = every_volume;
+	policy.every_seconds = every_seconds;
+	policy.queue_size = queue_size;
+	policy.keyframe_interval = keyframe_interval;
+	ctx->snapshots.set_policy(policy);
+}
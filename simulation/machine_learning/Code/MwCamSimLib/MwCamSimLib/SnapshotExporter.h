@@ -0,0 +1,116 @@
+#pragma once
+// periodic stock mesh snapshots, meshed and written off the cutting thread
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+#include "mwMemoryIOStream.hpp"
+#include "StlWriter.h"
+
+//@brief: when the simulation takes a mesh snapshot, every trigger set to 0 is disabled
+struct SnapshotPolicy
+{
+	// snapshot on every step index that is a multiple of every_moves
+	int every_moves = 100;
+	// snapshot when this much material (mm^3) was removed since the last snapshot
+	float every_volume = 0;
+	// snapshot when this much wall time (s) passed since the last snapshot
+	float every_seconds = 0;
+	// 0 writes every snapshot on the cutting thread. a positive size hands them to the writer thread and drops
+	// further snapshots while that many are pending
+	int queue_size = 0;
+	// every n-th snapshot is a full keyframe, the others only mesh the region swept since the previous
+	// snapshot. 0 writes full snapshots only
+	int keyframe_interval = 0;
+};
+
+// cutting envelope of a tool around the tcp, used to bound the swept region of the delta snapshots
+struct ToolEnvelope
+{
+	float radius;
+	float height;
+};
+
+//@brief: takes the stock snapshots of one simulation context
+//
+// the cutting thread only serializes the stock into memory (SaveStock). a background thread loads it
+// into a private verifier, meshes it and writes the stl file, so the cutting never waits for the mesh
+// generation or the disk. if the writer falls behind, new snapshots are dropped instead of blocking, so the
+// background writer is only used with a positive queue size.
+//
+// with a keyframe interval, snapshots between two keyframes are deltas <cut_id>_delta.stl that only hold
+// the stock clipped to the box swept since the previous written snapshot. every written snapshot is listed
+// in <folder>\snapshots.idx as "cut_id K|D min_x min_y min_z max_x max_y max_z". a step is rebuilt from
+// the last keyframe before it by replacing the box of every following delta with the delta mesh.
+class SnapshotExporter
+{
+public:
+	SnapshotExporter();
+	~SnapshotExporter();
+
+	void set_policy(const SnapshotPolicy &policy);
+	const SnapshotPolicy &policy() const { return m_policy; }
+	// STL_FORMAT_BINARY or STL_FORMAT_ASCII
+	void set_stl_format(int format);
+
+	// first step index >= cut_id that is a move count snapshot step, -1 if the move trigger is disabled
+	int next_step(int cut_id) const;
+	void add_removed_volume(float volume);
+	void set_tool_envelope(int tool_id, float radius, float height);
+	// extend the swept region by the tool at the tcp positions p1 and p2 (box of both)
+	void sweep(size_t tool_id, const mwMachSimVerifier::float3d &p1, const mwMachSimVerifier::float3d &p2);
+	// check the triggers after the step cut_id was simulated
+	bool due(int cut_id) const;
+	// snapshot the current stock of the verifier as <folder>\<cut_id>.stl, false if it was dropped
+	bool capture(mwMachSimVerifier &verifier, const char *folder, int cut_id);
+	// wait until all queued snapshots are written
+	void flush();
+
+private:
+	struct Job
+	{
+		std::unique_ptr<misc::mwMemoryIOStream> stock;
+		std::string folder;
+		int cut_id;
+		bool is_delta;
+		mwMachSimVerifier::float3d box_min;
+		mwMachSimVerifier::float3d box_max;
+	};
+
+	void reset_triggers();
+	void work();
+	void write_snapshot(mwMachSimVerifier &mesher, const Job &job);
+
+	SnapshotPolicy m_policy;
+	float m_removed_volume;
+	std::chrono::steady_clock::time_point m_last_snapshot;
+	int m_num_dropped;
+
+	std::vector<ToolEnvelope> m_tool_envelopes;
+	bool m_has_swept;
+	mwMachSimVerifier::float3d m_swept_min;
+	mwMachSimVerifier::float3d m_swept_max;
+	int m_since_keyframe;
+	// set by the writer when a snapshot failed, the deltas after it would have no base
+	std::atomic<bool> m_need_keyframe;
+	// folder of the index the writer appends to, it is truncated when the writer starts a new folder
+	std::string m_index_folder;
+	// only used by the thread that writes the snapshots
+	StlWriter m_writer;
+	int m_stl_format;
+
+	std::mutex m_mutex;
+	std::condition_variable m_job_ready;
+	std::condition_variable m_idle;
+	std::deque<Job> m_jobs;
+	bool m_busy;
+	bool m_stop;
+	std::thread m_thread;
+};
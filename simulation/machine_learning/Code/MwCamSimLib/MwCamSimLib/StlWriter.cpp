@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "StlWriter.h"
+#include "mwSTLTranslator.hpp"
+
+#include <cstring>
+#include <thread>
+
+// smallest number of triangles worth a serialization thread of its own
+#define STL_TRIANGLES_PER_THREAD 65536
+
+StlWriter::StlWriter()
+	: m_num_threads(0)
+{
+}
+
+//@brief: serialize the triangles begin..end into binary stl records
+//@param: mesh: source mesh
+//@param: begin: first triangle
+//@param: end: exclusive last triangle
+//@param: out: record of the first triangle
+//@ret: void
+static void serialize_triangles(const mwMachSimVerifier::Mesh &mesh, size_t begin, size_t end, char *out)
+{
+	for (size_t i = begin; i < end; ++i, out += STL_TRIANGLE_SIZE)
+	{
+		const float3d normal = mesh.GetTriangleNormalVector(i);
+		const float3d first = mesh.GetTriangleFirstVertexPosition(i);
+		const float3d second = mesh.GetTriangleSecondVertexPosition(i);
+		const float3d third = mesh.GetTriangleThirdVertexPosition(i);
+		const float values[12] = {
+			normal.x(), normal.y(), normal.z(),
+			first.x(), first.y(), first.z(),
+			second.x(), second.y(), second.z(),
+			third.x(), third.y(), third.z()};
+		std::memcpy(out, values, sizeof(values));
+		// attribute byte count
+		out[48] = 0;
+		out[49] = 0;
+	}
+}
+
+bool StlWriter::write_binary(const mwMachSimVerifier::Mesh &mesh, const std::string &filename)
+{
+	const size_t num_triangles = mesh.GetNumberOfTriangles();
+	// same header text as mwTSTLTranslator::WriteSTLBinary
+	m_buffer.resize(STL_HEADER_SIZE + num_triangles * STL_TRIANGLE_SIZE);
+	char *data = &m_buffer[0];
+	const char header[] = "STL File";
+	std::memset(data, ' ', 80);
+	std::memcpy(data, header, sizeof(header) - 1);
+	const unsigned int count = (unsigned int)num_triangles;
+	std::memcpy(data + 80, &count, sizeof(count));
+
+	size_t num_threads = m_num_threads > 0 ? (size_t)m_num_threads : (size_t)std::thread::hardware_concurrency();
+	if (num_threads > num_triangles / STL_TRIANGLES_PER_THREAD)
+		num_threads = num_triangles / STL_TRIANGLES_PER_THREAD;
+	if (num_threads < 1)
+		num_threads = 1;
+
+	// every thread fills its own slice of the buffer, the calling thread takes the last one
+	char *records = data + STL_HEADER_SIZE;
+	const size_t slice = (num_triangles + num_threads - 1) / num_threads;
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t + 1 < num_threads; ++t)
+		threads.emplace_back(serialize_triangles, std::cref(mesh), t * slice, (t + 1) * slice, records + t * slice * STL_TRIANGLE_SIZE);
+	const size_t last_begin = (num_threads - 1) * slice;
+	serialize_triangles(mesh, last_begin, num_triangles, records + last_begin * STL_TRIANGLE_SIZE);
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+		return false;
+	file.write(data, (std::streamsize)m_buffer.size());
+	return file.good();
+}
+
+//@brief: write a mesh as stl file
+//@param: mesh: mesh to write
+//@param: filename: stl file path
+//@param: format: STL_FORMAT_BINARY or STL_FORMAT_ASCII
+//@ret: false if the file could not be written
+bool StlWriter::write(const mwMachSimVerifier::Mesh &mesh, const std::string &filename, int format)
+{
+	if (format == STL_FORMAT_ASCII)
+	{
+		// the translator throws if the file can not be opened, nothing may escape to the python caller
+		try
+		{
+			cadcam::mwTSTLTranslator<float>::WriteSTL(misc::mwFileName(misc::mwstring(filename)), mesh, false);
+		}
+		catch (...)
+		{
+			return false;
+		}
+		return true;
+	}
+	return write_binary(mesh, filename);
+}
+
+//@brief: select the encoding of the final mesh and of the mesh snapshots
+//@param: ctx: simulation context
+//@param: format: STL_FORMAT_BINARY (default) or STL_FORMAT_ASCII
+//@ret: void
+void set_stl_format(SimContext *ctx, int format)
+{
+	ctx->stl_format = format;
+	ctx->snapshots.set_stl_format(format);
+}
@@ -0,0 +1,35 @@
+#pragma once
+// stl export of verifier meshes
+#include <string>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+
+// stl encodings selectable in set_stl_format
+#define STL_FORMAT_BINARY 0
+#define STL_FORMAT_ASCII 1
+
+// size of the binary stl header (80 byte text + triangle count) and of one triangle record
+#define STL_HEADER_SIZE 84
+#define STL_TRIANGLE_SIZE 50
+
+//@brief: writes meshes as stl files
+//
+// the binary encoding is serialized into a buffer that is kept between the calls, split over several
+// threads for large meshes, and handed to the file with a single write. the ascii encoding goes through
+// the mwTSTLTranslator of the sdk.
+class StlWriter
+{
+public:
+	StlWriter();
+
+	// threads used to serialize a large binary mesh, 0 for one per core
+	void set_num_threads(int num_threads) { m_num_threads = num_threads; }
+	bool write(const mwMachSimVerifier::Mesh &mesh, const std::string &filename, int format);
+
+private:
+	bool write_binary(const mwMachSimVerifier::Mesh &mesh, const std::string &filename);
+
+	int m_num_threads;
+	std::vector<char> m_buffer;
+};
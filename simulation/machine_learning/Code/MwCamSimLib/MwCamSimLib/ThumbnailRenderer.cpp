@@ -0,0 +1,527 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "ThumbnailRenderer.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// smallest number of triangles worth a projection thread of its own
+static const size_t THUMBNAIL_TRIANGLES_PER_THREAD = 16384;
+// smallest number of rows worth a rasterization thread of its own
+static const int THUMBNAIL_ROWS_PER_THREAD = 16;
+// sides of the cylinder drawn for the tool
+static const int THUMBNAIL_TOOL_SIDES = 16;
+// background and default colors (rgba bytes in memory order)
+static const unsigned int THUMBNAIL_BACKGROUND = 0xffffffff;
+static const VerifierUtil::mwvAbstractRendererPrimitives::ColorRGBA THUMBNAIL_STOCK_COLOR(0.5f, 0.5f, 0.5f, 1.f);
+static const VerifierUtil::mwvAbstractRendererPrimitives::ColorRGBA THUMBNAIL_TOOL_COLOR(1.f, 0.757f, 0.145f, 1.f);
+// largest stored deflate block
+static const size_t PNG_STORED_BLOCK = 65535;
+
+//@brief: crc32 of the png chunks (polynomial 0xedb88320)
+//@param: crc: crc of the preceding bytes, 0 to start
+//@param: data: bytes
+//@param: size: number of bytes
+//@ret: updated crc
+static unsigned int png_crc(unsigned int crc, const unsigned char *data, size_t size)
+{
+	// built once, the static initialization is thread safe for contexts rendering in parallel
+	struct CrcTable
+	{
+		unsigned int values[256];
+		CrcTable()
+		{
+			for (unsigned int n = 0; n < 256; ++n)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				values[n] = c;
+			}
+		}
+	};
+	static const CrcTable table;
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void put_u32(std::vector<char> &out, unsigned int value)
+{
+	out.push_back((char)(value >> 24));
+	out.push_back((char)(value >> 16));
+	out.push_back((char)(value >> 8));
+	out.push_back((char)value);
+}
+
+//@brief: append a png chunk with its length and crc
+//@param: out: png buffer
+//@param: type: four character chunk type
+//@param: data: chunk data
+//@ret: void
+static void put_chunk(std::vector<char> &out, const char *type, const std::vector<char> &data)
+{
+	put_u32(out, (unsigned int)data.size());
+	const size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put_u32(out, png_crc(0, (const unsigned char *)out.data() + start, out.size() - start));
+}
+
+//@brief: encode an rgba image as png. the thumbnails are small, so the zlib stream uses stored blocks
+//        and needs no compression library
+//@param: width, height: image size
+//@param: rgba: pixels, 4 bytes each, row by row from the top
+//@param: out: receives the png file
+//@ret: void
+static void encode_png(int width, int height, const std::vector<unsigned int> &rgba, std::vector<char> &out)
+{
+	out.clear();
+	static const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+	out.insert(out.end(), signature, signature + 8);
+
+	std::vector<char> header;
+	put_u32(header, (unsigned int)width);
+	put_u32(header, (unsigned int)height);
+	// 8 bit rgba, deflate, adaptive filtering, no interlace
+	const char format[5] = {8, 6, 0, 0, 0};
+	header.insert(header.end(), format, format + 5);
+	put_chunk(out, "IHDR", header);
+
+	// every row starts with filter type 0 (none)
+	const size_t row_size = (size_t)width * 4 + 1;
+	std::vector<unsigned char> raw(row_size * (size_t)height);
+	for (int y = 0; y < height; ++y)
+	{
+		raw[row_size * y] = 0;
+		std::memcpy(&raw[row_size * y + 1], &rgba[(size_t)width * y], (size_t)width * 4);
+	}
+
+	std::vector<char> stream;
+	stream.reserve(raw.size() + raw.size() / PNG_STORED_BLOCK * 5 + 16);
+	stream.push_back(0x78);
+	stream.push_back(0x01);
+	unsigned int adler_a = 1, adler_b = 0;
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += PNG_STORED_BLOCK)
+	{
+		const size_t size = raw.size() - offset < PNG_STORED_BLOCK ? raw.size() - offset : PNG_STORED_BLOCK;
+		const bool last = offset + size >= raw.size();
+		stream.push_back(last ? 1 : 0);
+		stream.push_back((char)(size & 0xff));
+		stream.push_back((char)(size >> 8));
+		stream.push_back((char)(~size & 0xff));
+		stream.push_back((char)((~size >> 8) & 0xff));
+		stream.insert(stream.end(), raw.begin() + offset, raw.begin() + offset + size);
+		for (size_t i = offset; i < offset + size; ++i)
+		{
+			adler_a = (adler_a + raw[i]) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+		if (last)
+			break;
+	}
+	put_u32(stream, (adler_b << 16) | adler_a);
+	put_chunk(out, "IDAT", stream);
+	put_chunk(out, "IEND", std::vector<char>());
+}
+
+//@brief: pack a color shaded by intensity into rgba bytes
+static unsigned int pack_color(const VerifierUtil::mwvAbstractRendererPrimitives::ColorRGBA &color, float intensity)
+{
+	const float r = color.Red * intensity * 255.f + 0.5f;
+	const float g = color.Green * intensity * 255.f + 0.5f;
+	const float b = color.Blue * intensity * 255.f + 0.5f;
+	const unsigned int red = r > 255.f ? 255u : (unsigned int)r;
+	const unsigned int green = g > 255.f ? 255u : (unsigned int)g;
+	const unsigned int blue = b > 255.f ? 255u : (unsigned int)b;
+	return red | (green << 8) | (blue << 16) | 0xff000000u;
+}
+
+ThumbnailRenderer::ThumbnailRenderer()
+	: m_last_cut_id(0), m_last_thumbnail(std::chrono::steady_clock::now()), m_force_redraw(false),
+	  m_offset_x(0), m_offset_y(0), m_scale(1)
+{
+	// same view direction as the animation window: from (-1, -1, 1) towards the origin, z up
+	m_forward = float3d(1, 1, -1).Normalized();
+	m_right = float3d(1, -1, 0).Normalized();
+	m_up = m_right % m_forward;
+}
+
+void ThumbnailRenderer::set_policy(const ThumbnailPolicy &policy)
+{
+	m_policy = policy;
+	if (m_policy.width < 1)
+		m_policy.width = 1;
+	if (m_policy.height < 1)
+		m_policy.height = 1;
+	m_last_cut_id = 0;
+	m_last_thumbnail = std::chrono::steady_clock::now();
+}
+
+void ThumbnailRenderer::set_tool_envelope(int tool_id, float radius, float height)
+{
+	if (tool_id < 0)
+		return;
+	if ((size_t)tool_id >= m_tool_envelopes.size())
+		m_tool_envelopes.resize((size_t)tool_id + 1, ToolEnvelope{0, 0});
+	m_tool_envelopes[tool_id].radius = radius;
+	m_tool_envelopes[tool_id].height = height;
+}
+
+bool ThumbnailRenderer::due(int cut_id) const
+{
+	if (m_policy.every_moves > 0 && cut_id - m_last_cut_id >= m_policy.every_moves)
+		return true;
+	if (m_policy.every_seconds > 0)
+	{
+		const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - m_last_thumbnail;
+		if (elapsed.count() >= m_policy.every_seconds)
+			return true;
+	}
+	return false;
+}
+
+void ThumbnailRenderer::DrawTriangles(const RenderGroupID groupId, const mwRenderedTriangle *triangles, const size_t numOfTriangles,
+									  const VertexAttributes &vertexAttributes)
+{
+	// an update replaces the former content of the group, its visibility is kept
+	Group &group = m_groups[groupId];
+	group.triangles.assign(triangles, triangles + numOfTriangles);
+}
+
+void ThumbnailRenderer::DrawLines(const RenderGroupID groupId, const mwRenderedLine *lines, const size_t numOfLines)
+{
+	// lines (tool path, edges) are not part of the thumbnails
+}
+
+void ThumbnailRenderer::SetGroupVisibility(const RenderGroupID groupId, const bool visible)
+{
+	std::map<RenderGroupID, Group>::iterator it = m_groups.find(groupId);
+	if (it != m_groups.end())
+		it->second.visible = visible;
+}
+
+void ThumbnailRenderer::DeleteGroup(const RenderGroupID groupId)
+{
+	m_groups.erase(groupId);
+}
+
+//@brief: build the triangles of a cylinder around the tool envelope at the tcp
+//@param: tool_id: tool index in the simulation tool set
+//@param: tcp: tool center point
+//@ret: void
+void ThumbnailRenderer::add_tool(size_t tool_id, const float3d &tcp)
+{
+	m_tool.clear();
+	if (tool_id >= m_tool_envelopes.size() || m_tool_envelopes[tool_id].radius <= 0)
+		return;
+	const ToolEnvelope &envelope = m_tool_envelopes[tool_id];
+	const float3d top = tcp + float3d(0, 0, envelope.height);
+	for (int i = 0; i < THUMBNAIL_TOOL_SIDES; ++i)
+	{
+		const float a0 = (float)(2 * mathdef::MW_PI * i / THUMBNAIL_TOOL_SIDES);
+		const float a1 = (float)(2 * mathdef::MW_PI * (i + 1) / THUMBNAIL_TOOL_SIDES);
+		const float3d d0(envelope.radius * std::cos(a0), envelope.radius * std::sin(a0), 0);
+		const float3d d1(envelope.radius * std::cos(a1), envelope.radius * std::sin(a1), 0);
+		// two triangles of the side, one of the bottom and one of the top
+		const float3d corners[4][3] = {
+			{tcp + d0, tcp + d1, top + d1},
+			{tcp + d0, top + d1, top + d0},
+			{tcp, tcp + d1, tcp + d0},
+			{top, top + d0, top + d1}};
+		for (int t = 0; t < 4; ++t)
+		{
+			mwRenderedTriangle triangle;
+			for (int v = 0; v < 3; ++v)
+			{
+				triangle.Vertices[v] = corners[t][v];
+				triangle.Colors[v] = THUMBNAIL_TOOL_COLOR;
+				triangle.LocalID[v] = VerifierUtil::mwvAbstractRendererPrimitives::INVALID_VERTEX_ID;
+			}
+			m_tool.push_back(triangle);
+		}
+	}
+}
+
+//@brief: project a slice of the visible triangles into pixel coordinates and shade them
+//@param: begin, end: slice of m_visible
+//@ret: void
+void ThumbnailRenderer::project(size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; ++i)
+	{
+		const mwRenderedTriangle &triangle = *m_visible[i];
+		ScreenTriangle &screen = m_screen[i];
+		float depth[3];
+		for (int v = 0; v < 3; ++v)
+		{
+			const float3d &p = triangle.Vertices[v];
+			screen.x[v] = (p * m_right - m_offset_x) * m_scale;
+			screen.y[v] = (m_offset_y - p * m_up) * m_scale;
+			depth[v] = p * m_forward;
+		}
+
+		// plane of the depth over the pixel coordinates, degenerate triangles are skipped
+		const float e1x = screen.x[1] - screen.x[0], e1y = screen.y[1] - screen.y[0], e1z = depth[1] - depth[0];
+		const float e2x = screen.x[2] - screen.x[0], e2y = screen.y[2] - screen.y[0], e2z = depth[2] - depth[0];
+		const float area = e1x * e2y - e2x * e1y;
+		if (std::fabs(area) < 1e-6f)
+		{
+			screen.color = 0;
+			continue;
+		}
+		screen.depth_dx = (e1z * e2y - e2z * e1y) / area;
+		screen.depth_dy = (e2z * e1x - e1z * e2x) / area;
+		screen.depth_0 = depth[0] - screen.depth_dx * screen.x[0] - screen.depth_dy * screen.y[0];
+
+		// flat two-sided lambert shading with the light at the camera
+		const float3d normal = ((triangle.Vertices[1] - triangle.Vertices[0]) % (triangle.Vertices[2] - triangle.Vertices[0])).NormalizedOrZero();
+		const float facing = std::fabs(normal * m_forward);
+		VerifierUtil::mwvAbstractRendererPrimitives::ColorRGBA color(
+			(triangle.Colors[0].Red + triangle.Colors[1].Red + triangle.Colors[2].Red) / 3.f,
+			(triangle.Colors[0].Green + triangle.Colors[1].Green + triangle.Colors[2].Green) / 3.f,
+			(triangle.Colors[0].Blue + triangle.Colors[1].Blue + triangle.Colors[2].Blue) / 3.f, 1.f);
+		// groups without vertex colors get the stock color of the animation window
+		if (triangle.Colors[0].Alpha == 0 && triangle.Colors[1].Alpha == 0 && triangle.Colors[2].Alpha == 0)
+			color = THUMBNAIL_STOCK_COLOR;
+		screen.color = pack_color(color, 0.3f + 0.7f * facing);
+	}
+}
+
+//@brief: rasterize all projected triangles into a band of rows of the frame
+//@param: row_begin, row_end: rows of the band, only this thread writes them
+//@ret: void
+void ThumbnailRenderer::rasterize(int row_begin, int row_end)
+{
+	const int width = m_policy.width;
+	for (size_t i = 0; i < m_screen.size(); ++i)
+	{
+		const ScreenTriangle &triangle = m_screen[i];
+		if (triangle.color == 0)
+			continue;
+		float y_min = triangle.y[0], y_max = triangle.y[0];
+		for (int v = 1; v < 3; ++v)
+		{
+			y_min = triangle.y[v] < y_min ? triangle.y[v] : y_min;
+			y_max = triangle.y[v] > y_max ? triangle.y[v] : y_max;
+		}
+		// rows whose pixel center lies inside the triangle
+		int first = (int)std::ceil(y_min - 0.5f);
+		int last = (int)std::floor(y_max - 0.5f);
+		first = first < row_begin ? row_begin : first;
+		last = last > row_end - 1 ? row_end - 1 : last;
+
+		for (int row = first; row <= last; ++row)
+		{
+			// span of the row between the crossed edges
+			const float y = (float)row + 0.5f;
+			float x_left = FLT_MAX, x_right = -FLT_MAX;
+			for (int e = 0; e < 3; ++e)
+			{
+				const int f = e == 2 ? 0 : e + 1;
+				const float y0 = triangle.y[e], y1 = triangle.y[f];
+				if (y0 == y1 || y < (y0 < y1 ? y0 : y1) || y > (y0 > y1 ? y0 : y1))
+					continue;
+				const float x = triangle.x[e] + (y - y0) * (triangle.x[f] - triangle.x[e]) / (y1 - y0);
+				x_left = x < x_left ? x : x_left;
+				x_right = x > x_right ? x : x_right;
+			}
+			int x_begin = (int)std::ceil(x_left - 0.5f);
+			int x_end = (int)std::floor(x_right - 0.5f) + 1;
+			x_begin = x_begin < 0 ? 0 : x_begin;
+			x_end = x_end > width ? width : x_end;
+			if (x_begin >= x_end)
+				continue;
+
+			// branch-free depth test, the compiler turns the span into vector compares and blends
+			float *depth_row = &m_depth[(size_t)row * width];
+			unsigned int *color_row = &m_color[(size_t)row * width];
+			const float depth_begin = triangle.depth_0 + triangle.depth_dy * y + triangle.depth_dx * ((float)x_begin + 0.5f);
+			const float depth_dx = triangle.depth_dx;
+			const unsigned int color = triangle.color;
+			for (int x = x_begin; x < x_end; ++x)
+			{
+				const float depth = depth_begin + depth_dx * (float)(x - x_begin);
+				const bool closer = depth < depth_row[x];
+				depth_row[x] = closer ? depth : depth_row[x];
+				color_row[x] = closer ? color : color_row[x];
+			}
+		}
+	}
+}
+
+//@brief: render the current stock and the tool into the rgba buffer
+//@param: verifier: verifier of the simulation context
+//@param: tcp: tool center point, NULL draws the stock only
+//@ret: void
+void ThumbnailRenderer::render_frame(mwMachSimVerifier &verifier, const float3d *tcp)
+{
+	if (m_force_redraw)
+	{
+		m_groups.clear();
+		verifier.ForceRedraw();
+		m_force_redraw = false;
+	}
+	// only the changed groups are handed over
+	verifier.Render(this);
+
+	m_visible.clear();
+	for (std::map<RenderGroupID, Group>::const_iterator it = m_groups.begin(); it != m_groups.end(); ++it)
+	{
+		if (!it->second.visible)
+			continue;
+		for (size_t i = 0; i < it->second.triangles.size(); ++i)
+			m_visible.push_back(&it->second.triangles[i]);
+	}
+	if (tcp)
+		add_tool(verifier.GetCurrentCutToolIndex(), *tcp);
+	else
+		m_tool.clear();
+	for (size_t i = 0; i < m_tool.size(); ++i)
+		m_visible.push_back(&m_tool[i]);
+
+	// fit the view to the projected extent of the scene
+	const int width = m_policy.width, height = m_policy.height;
+	float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX;
+	for (size_t i = 0; i < m_visible.size(); ++i)
+	{
+		for (int v = 0; v < 3; ++v)
+		{
+			const float x = m_visible[i]->Vertices[v] * m_right;
+			const float y = m_visible[i]->Vertices[v] * m_up;
+			min_x = x < min_x ? x : min_x;
+			max_x = x > max_x ? x : max_x;
+			min_y = y < min_y ? y : min_y;
+			max_y = y > max_y ? y : max_y;
+		}
+	}
+	if (!m_visible.empty())
+	{
+		const float extent_x = max_x - min_x > 1e-3f ? max_x - min_x : 1e-3f;
+		const float extent_y = max_y - min_y > 1e-3f ? max_y - min_y : 1e-3f;
+		const float scale_x = width / extent_x, scale_y = height / extent_y;
+		// keep a small border around the scene
+		m_scale = 0.95f * (scale_x < scale_y ? scale_x : scale_y);
+		m_offset_x = 0.5f * (min_x + max_x) - 0.5f * width / m_scale;
+		m_offset_y = 0.5f * (min_y + max_y) + 0.5f * height / m_scale;
+	}
+
+	m_color.assign((size_t)width * height, THUMBNAIL_BACKGROUND);
+	m_depth.assign((size_t)width * height, FLT_MAX);
+	m_screen.resize(m_visible.size());
+
+	size_t num_threads = m_policy.num_threads > 0 ? (size_t)m_policy.num_threads : (size_t)std::thread::hardware_concurrency();
+	num_threads = num_threads < 1 ? 1 : num_threads;
+
+	// project the triangles in slices, the calling thread takes the last one
+	{
+		size_t project_threads = m_visible.size() / THUMBNAIL_TRIANGLES_PER_THREAD;
+		project_threads = project_threads > num_threads ? num_threads : project_threads;
+		project_threads = project_threads < 1 ? 1 : project_threads;
+		const size_t slice = (m_visible.size() + project_threads - 1) / project_threads;
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t + 1 < project_threads; ++t)
+			threads.emplace_back(&ThumbnailRenderer::project, this, t * slice, (t + 1) * slice);
+		project((project_threads - 1) * slice, m_visible.size());
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+	}
+
+	// rasterize the rows in bands, no two threads write the same pixel
+	{
+		size_t raster_threads = (size_t)(height / THUMBNAIL_ROWS_PER_THREAD);
+		raster_threads = raster_threads > num_threads ? num_threads : raster_threads;
+		raster_threads = raster_threads < 1 ? 1 : raster_threads;
+		const int band = (int)((height + raster_threads - 1) / raster_threads);
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t + 1 < raster_threads; ++t)
+			threads.emplace_back(&ThumbnailRenderer::rasterize, this, (int)t * band, (int)(t + 1) * band);
+		rasterize((int)(raster_threads - 1) * band, height);
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+	}
+}
+
+//@brief: render the current stock and the tool into a png file
+//@param: verifier: verifier of the simulation context
+//@param: tcp: tool center point, NULL draws the stock only
+//@param: pngfile: image file, replaced in one step so a viewer never sees half of it
+//@ret: false if the file could not be written
+bool ThumbnailRenderer::render(mwMachSimVerifier &verifier, const float3d *tcp, const std::string &pngfile)
+{
+	render_frame(verifier, tcp);
+	encode_png(m_policy.width, m_policy.height, m_color, m_png);
+	return write_png(pngfile, m_png);
+}
+
+//@brief: render a due thumbnail into the snapshot folder
+//@param: verifier: verifier of the simulation context
+//@param: tcp: tool center point of the simulated step
+//@param: folder: snapshot folder, receives <cut_id>.png and progress.png (always the latest one)
+//@param: cut_id: simulation step of the thumbnail
+//@ret: false if an image could not be written
+bool ThumbnailRenderer::capture(mwMachSimVerifier &verifier, const float3d &tcp, const char *folder, int cut_id)
+{
+	m_last_cut_id = cut_id;
+	m_last_thumbnail = std::chrono::steady_clock::now();
+	const std::string base(folder);
+	if (!render(verifier, &tcp, base + "\\" + std::to_string(cut_id) + ".png"))
+		return false;
+	return write_png(base + "\\progress.png", m_png);
+}
+
+//@brief: write an encoded png through a temporary file
+//@param: pngfile: image file
+//@param: png: encoded image
+//@ret: false if the file could not be written
+bool ThumbnailRenderer::write_png(const std::string &pngfile, const std::vector<char> &png) const
+{
+	const std::string temp_path = pngfile + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write(png.data(), (std::streamsize)png.size());
+		if (!file.good())
+			return false;
+	}
+	// rename does not replace an existing file on windows
+	std::remove(pngfile.c_str());
+	return std::rename(temp_path.c_str(), pngfile.c_str()) == 0;
+}
+
+//@brief: set when the simulation renders the headless progress thumbnails into the snapshot folder
+//@param: ctx: simulation context
+//@param: every_moves: thumbnail after this many simulated moves, 0 disables
+//@param: every_seconds: thumbnail after this wall time (s), 0 disables
+//@param: width: image width in pixels
+//@param: height: image height in pixels
+//@ret: void
+void set_thumbnail_policy(SimContext *ctx, int every_moves, float every_seconds, int width, int height)
+{
+	ThumbnailPolicy policy;
+	policy.every_moves = every_moves;
+	policy.every_seconds = every_seconds;
+	policy.width = width;
+	policy.height = height;
+	ctx->thumbnails.set_policy(policy);
+}
+
+//@brief: render the current stock into a png file without an opengl context
+//@param: ctx: simulation context
+//@param: pngfile: image file
+//@ret: false if the file could not be written
+bool render_thumbnail(SimContext *ctx, char *pngfile)
+{
+	// the animation window draws with the same verifier, its draw calls consume the changed groups
+	if (ctx->sim_window != nullptr)
+		ctx->thumbnails.force_redraw();
+	const bool written = ctx->thumbnails.render(*ctx->verifier, nullptr, pngfile);
+	if (ctx->sim_window != nullptr)
+		ctx->verifier->ForceRedraw();
+	if (!written)
+		std::cout << "[\033[1;31mERROR\033[0m]  Could not write the thumbnail " << pngfile << std::endl;
+	return written;
+}
@@ -0,0 +1,97 @@
+#pragma once
+// headless progress thumbnails, the stock is rasterized on the cpu without an opengl context
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mwMachSimVerifier.hpp"
+#include "mwvAbstractRenderer.hpp"
+#include "SnapshotExporter.h"
+
+//@brief: when the simulation renders a thumbnail, every trigger set to 0 is disabled
+struct ThumbnailPolicy
+{
+	// thumbnail once this many moves were simulated since the last one (checked at the end of every batch)
+	int every_moves = 0;
+	// thumbnail when this much wall time (s) passed since the last one
+	float every_seconds = 0;
+	// image size in pixels
+	int width = 256;
+	int height = 256;
+	// rasterization threads, 0 for one per core
+	int num_threads = 0;
+};
+
+//@brief: cpu implementation of the verifier renderer interface
+//
+// verifier->Render() only hands over the triangle groups that changed since the last call, they are kept
+// here between the frames. a frame projects the visible triangles and the current tool orthographically
+// (same view direction as the animation window, fitted to the stock) and rasterizes them into a rgba and
+// depth buffer. the image is split into row bands, every band is filled by its own thread with scanline
+// spans whose depth test is written branch-free so the compiler vectorizes it. the frame is written as png.
+class ThumbnailRenderer : public VerifierUtil::mwvAbstractRenderer
+{
+public:
+	ThumbnailRenderer();
+
+	void set_policy(const ThumbnailPolicy &policy);
+	const ThumbnailPolicy &policy() const { return m_policy; }
+	bool enabled() const { return m_policy.every_moves > 0 || m_policy.every_seconds > 0; }
+	void set_tool_envelope(int tool_id, float radius, float height);
+	// check the triggers after the step cut_id was simulated
+	bool due(int cut_id) const;
+	// render the stock of the verifier and the tool at the tcp (NULL for none) into a png file, false if it could not be written
+	bool render(mwMachSimVerifier &verifier, const mwMachSimVerifier::float3d *tcp, const std::string &pngfile);
+	// render a due thumbnail as <folder>\<cut_id>.png and copy it to <folder>\progress.png
+	bool capture(mwMachSimVerifier &verifier, const mwMachSimVerifier::float3d &tcp, const char *folder, int cut_id);
+	// the groups of the verifier are requested again by the next frame, e.g. after an animation window drew
+	void force_redraw() { m_force_redraw = true; }
+
+	// mwvAbstractRenderer
+	void DrawTriangles(const RenderGroupID groupId, const mwRenderedTriangle *triangles, const size_t numOfTriangles,
+					   const VertexAttributes &vertexAttributes) override;
+	void DrawLines(const RenderGroupID groupId, const mwRenderedLine *lines, const size_t numOfLines) override;
+	void SetGroupVisibility(const RenderGroupID groupId, const bool visible) override;
+	void DeleteGroup(const RenderGroupID groupId) override;
+
+private:
+	struct Group
+	{
+		std::vector<mwRenderedTriangle> triangles;
+		bool visible = true;
+	};
+
+	// triangle in pixel coordinates with a flat color and the plane of its depth
+	struct ScreenTriangle
+	{
+		float x[3];
+		float y[3];
+		float depth_dx, depth_dy, depth_0;
+		unsigned int color;
+	};
+
+	void render_frame(mwMachSimVerifier &verifier, const mwMachSimVerifier::float3d *tcp);
+	void add_tool(size_t tool_id, const mwMachSimVerifier::float3d &tcp);
+	void project(size_t begin, size_t end);
+	void rasterize(int row_begin, int row_end);
+	bool write_png(const std::string &pngfile, const std::vector<char> &png) const;
+
+	ThumbnailPolicy m_policy;
+	int m_last_cut_id;
+	std::chrono::steady_clock::time_point m_last_thumbnail;
+	bool m_force_redraw;
+	std::vector<ToolEnvelope> m_tool_envelopes;
+	std::map<RenderGroupID, Group> m_groups;
+
+	// buffers of the current frame, kept between the frames
+	std::vector<const mwRenderedTriangle *> m_visible;
+	std::vector<mwRenderedTriangle> m_tool;
+	std::vector<ScreenTriangle> m_screen;
+	std::vector<unsigned int> m_color;
+	std::vector<float> m_depth;
+	std::vector<char> m_png;
+	// orthographic view: pixel = (p * right - offset_x) * scale, (offset_y - p * up) * scale
+	mwMachSimVerifier::float3d m_right, m_up, m_forward;
+	float m_offset_x, m_offset_y, m_scale;
+};
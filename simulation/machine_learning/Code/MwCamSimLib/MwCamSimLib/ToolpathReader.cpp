@@ -0,0 +1,461 @@
+#include "pch.h"
+#include "MwCamSimLib.h"
+#include "ToolpathReader.h"
+
+#include <cctype>
+#include <cstring>
+
+// maximum number of columns of a tool path row
+static const int TOOLPATH_MAX_COLUMNS = 8;
+// minimum number of columns of a data row, shorter rows (e.g. the name row) are skipped
+static const int TOOLPATH_MIN_COLUMNS = 7;
+
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+							   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+//@brief: parse a decimal number without locale handling or copying, stops at the line end
+//@param: cursor: position in the row, moved behind the number
+//@param: end: end of the row
+//@param: value: receives the number
+//@ret: false if there is no number at the cursor
+static inline bool parse_number(const char *&cursor, const char *end, double &value)
+{
+	const char *p = cursor;
+	while (p < end && (*p == ' ' || *p == '\t'))
+		++p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	// up to 19 significant digits fit into the integer mantissa, further digits only shift the exponent
+	unsigned long long mantissa = 0;
+	int num_digits = 0;
+	int exponent = 0;
+	const char *digits_begin = p;
+	for (; p < end && (unsigned)(*p - '0') < 10; ++p)
+	{
+		if (num_digits < 19)
+		{
+			mantissa = mantissa * 10 + (unsigned)(*p - '0');
+			if (mantissa)
+				++num_digits;
+		}
+		else
+			++exponent;
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && (unsigned)(*p - '0') < 10; ++p)
+		{
+			if (num_digits < 19)
+			{
+				mantissa = mantissa * 10 + (unsigned)(*p - '0');
+				if (mantissa)
+					++num_digits;
+				--exponent;
+			}
+		}
+	}
+	if (p == digits_begin || (p == digits_begin + 1 && *digits_begin == '.'))
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *e = p + 1;
+		bool negative_exponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negative_exponent = *e++ == '-';
+		if (e < end && (unsigned)(*e - '0') < 10)
+		{
+			int e_value = 0;
+			for (; e < end && (unsigned)(*e - '0') < 10; ++e)
+				if (e_value < 10000)
+					e_value = e_value * 10 + (*e - '0');
+			exponent += negative_exponent ? -e_value : e_value;
+			p = e;
+		}
+	}
+
+	double result = (double)mantissa;
+	int scale = exponent < 0 ? -exponent : exponent;
+	while (scale > 22)
+	{
+		result = exponent < 0 ? result / POW10[22] : result * POW10[22];
+		scale -= 22;
+	}
+	result = exponent < 0 ? result / POW10[scale] : result * POW10[scale];
+
+	value = negative ? -result : result;
+	cursor = p;
+	return true;
+}
+
+ToolpathReader::ToolpathReader()
+	: m_cursor(nullptr), m_end(nullptr), m_sample_interval(1),
+	  m_line_idx(0), m_malformed_rows(0), m_has_block_column(false), m_has_pending(false)
+{
+	std::memset(&m_pending, 0, sizeof(m_pending));
+}
+
+ToolpathReader::~ToolpathReader()
+{
+	close();
+}
+
+//@brief: map the tool path file and skip the name row
+//@param: path: tool path file
+//@param: sample_interval: every sample_interval-th row after the start row is kept
+//@ret: true if the file is mapped
+bool ToolpathReader::open(const char *path, int sample_interval)
+{
+	close();
+	m_sample_interval = sample_interval < 1 ? 1 : sample_interval;
+	if (!m_file.Open(misc::mwFileName(misc::mwstring(path)), true))
+		return false;
+	m_cursor = m_file.GetData();
+	m_end = m_cursor + m_file.GetSize();
+	// skip name row
+	skip_line();
+	return true;
+}
+
+//@brief: release the mapping and the file
+//@param: void
+//@ret: void
+void ToolpathReader::close()
+{
+	m_file.Close();
+	m_cursor = nullptr;
+	m_end = nullptr;
+	m_line_idx = 0;
+	m_malformed_rows = 0;
+	m_has_block_column = false;
+	m_has_pending = false;
+}
+
+void ToolpathReader::skip_line()
+{
+	const char *newline = m_cursor < m_end ? (const char *)std::memchr(m_cursor, '\n', m_end - m_cursor) : nullptr;
+	m_cursor = newline ? newline + 1 : m_end;
+}
+
+//@brief: parse the next data row, malformed rows are skipped and counted
+//@param: row: receives the parsed row
+//@ret: false at the end of the file
+bool ToolpathReader::next_row(ToolpathRow &row)
+{
+	while (m_cursor < m_end)
+	{
+		const char *newline = (const char *)std::memchr(m_cursor, '\n', m_end - m_cursor);
+		const char *line_end = newline ? newline : m_end;
+		const char *cursor = m_cursor;
+		m_cursor = newline ? newline + 1 : m_end;
+
+		double values[TOOLPATH_MAX_COLUMNS];
+		int num_values = 0;
+		while (num_values < TOOLPATH_MAX_COLUMNS && parse_number(cursor, line_end, values[num_values]))
+			++num_values;
+		if (num_values < TOOLPATH_MIN_COLUMNS)
+		{
+			// empty lines, e.g. at the end of the file, are no malformed rows
+			while (cursor < line_end && std::isspace((unsigned char)*cursor))
+				++cursor;
+			if (num_values > 0 || cursor < line_end)
+				++m_malformed_rows;
+			continue;
+		}
+
+		row.timestamp = (long long)values[0];
+		row.x = (float)values[1];
+		row.y = (float)values[2];
+		row.z = (float)values[3];
+		row.s1actrev = (float)values[4];
+		row.actfeed = (float)values[5];
+		row.tool_number = (int)values[6];
+		row.block_nr = num_values > 7 ? (int)values[7] : 0;
+		m_has_block_column |= num_values > 7;
+		return true;
+	}
+	return false;
+}
+
+//@brief: read the start position of the simulation
+//@param: row: receives the first data row
+//@ret: false if the file has no data row
+bool ToolpathReader::read_start(ToolpathRow &row)
+{
+	if (!next_row(row))
+		return false;
+	m_line_idx = 1;
+	return true;
+}
+
+//@brief: read the next row kept by the decimation
+//@param: row: receives the row
+//@ret: false at the end of the file
+bool ToolpathReader::next_sample(ToolpathRow &row)
+{
+	// a row that is not on the sampling grid is held back until it is known whether it is the last one
+	while (next_row(row))
+	{
+		++m_line_idx;
+		if (m_line_idx % m_sample_interval == 0)
+		{
+			m_has_pending = false;
+			return true;
+		}
+		m_pending = row;
+		m_has_pending = true;
+	}
+	if (m_has_pending)
+	{
+		row = m_pending;
+		m_has_pending = false;
+		return true;
+	}
+	return false;
+}
+
+ToolpathReader::Position ToolpathReader::position() const
+{
+	// next_sample never returns with a held back row, so the cursor and the line count are the whole state
+	Position position;
+	position.offset = (long long)(m_cursor - m_file.GetData());
+	position.line_idx = m_line_idx;
+	return position;
+}
+
+bool ToolpathReader::seek(const Position &position)
+{
+	if (position.offset < 0 || (size_t)position.offset > m_file.GetSize())
+		return false;
+	m_cursor = m_file.GetData() + position.offset;
+	m_line_idx = position.line_idx;
+	m_has_pending = false;
+	return true;
+}
+
+//@brief: map a tool number of the nc program to the tool index in the simulation tool set
+//@param: ctx: simulation context
+//@param: nc_tool_number: tool number from the nc program
+//@ret: tool index, -1 if the tool was not registered with set_tool_number
+int find_tool_index(SimContext *ctx, int nc_tool_number)
+{
+	std::map<int, int>::const_iterator tool = ctx->tool_numbers.find(nc_tool_number);
+	if (tool == ctx->tool_numbers.end())
+	{
+		std::cout << "\033[1;31mERROR: Tool " << nc_tool_number << " of the tool path is not in the current tool set\033[0m" << std::endl;
+		return -1;
+	}
+	return tool->second;
+}
+
+//@brief: register the tool number the nc program uses for a tool of the simulation tool set
+//@param: ctx: simulation context
+//@param: tool_id: tool index in the simulation tool set
+//@param: nc_tool_number: tool number from the nc program
+//@ret: void
+void set_tool_number(SimContext *ctx, int tool_id, int nc_tool_number)
+{
+	ctx->tool_numbers[nc_tool_number] = tool_id;
+}
+
+//@brief: set the function that is called after every simulated batch of a tool path
+//@param: ctx: simulation context
+//@param: callback: progress callback, NULL to disable
+//@ret: void
+void set_progress_callback(SimContext *ctx, SimProgressCallback callback)
+{
+	ctx->progress_callback = callback;
+}
+
+//@brief: simulate the remaining samples of a tool path and take the checkpoints on the way
+//@param: ctx: simulation context
+//@param: reader: tool path positioned in front of the next sample
+//@param: state: state of the run after its last simulated step, updated with every checkpoint
+//@param: stlPath: folder for the periodic mesh snapshots
+//@ret: last simulated step index, -1 on error
+static int continue_toolpath(SimContext *ctx, ToolpathReader &reader, CheckpointState &state, char *stlPath)
+{
+	CheckpointHeader &run = state.header;
+	float x_start = run.x;
+	float y_start = run.y;
+	float z_start = run.z;
+	int tool_number_current = run.tool_number;
+	int tool_idx_current = run.tool_idx;
+
+	const unsigned char flags = run.is_trace ? (MOVE_FLAG_CUT | MOVE_FLAG_TRACE) : MOVE_FLAG_CUT;
+	// the progress callback refreshes the animation, so a visual run simulates small batches
+	const size_t batch_size = ctx->isvisual ? VISUAL_BATCH_SIZE : BATCH_FLUSH_SIZE;
+	std::vector<float> x, y, z, s1actrev, actfeed;
+	std::vector<long long> timestamp;
+	std::vector<int> toolid, tool_idx;
+	std::vector<unsigned char> move_flags;
+	x.reserve(BATCH_FLUSH_SIZE);
+	y.reserve(BATCH_FLUSH_SIZE);
+	z.reserve(BATCH_FLUSH_SIZE);
+	s1actrev.reserve(BATCH_FLUSH_SIZE);
+	actfeed.reserve(BATCH_FLUSH_SIZE);
+	timestamp.reserve(BATCH_FLUSH_SIZE);
+	toolid.reserve(BATCH_FLUSH_SIZE);
+	tool_idx.reserve(BATCH_FLUSH_SIZE);
+	move_flags.reserve(BATCH_FLUSH_SIZE);
+	int cut_id = run.cut_id + 1;
+	int block_nr_current = run.block_nr;
+
+	ToolpathRow row;
+	ToolpathReader::Position next_sample = reader.position();
+	bool has_row = reader.next_sample(row);
+	while (has_row)
+	{
+		// check if tool is changed
+		if (row.tool_number != tool_number_current)
+		{
+			tool_idx_current = find_tool_index(ctx, row.tool_number);
+			if (tool_idx_current < 0)
+				return -1;
+			tool_number_current = row.tool_number;
+		}
+		timestamp.push_back(row.timestamp);
+		x.push_back(row.x);
+		y.push_back(row.y);
+		z.push_back(row.z);
+		s1actrev.push_back(row.s1actrev);
+		actfeed.push_back(row.actfeed);
+		toolid.push_back(row.tool_number);
+		tool_idx.push_back(tool_idx_current);
+		move_flags.push_back(flags);
+		block_nr_current = row.block_nr;
+
+		next_sample = reader.position();
+		has_row = reader.next_sample(row);
+		if (x.size() < batch_size && has_row)
+			continue;
+
+		const int count = (int)x.size();
+		const int simulated = DoCutBatch(ctx, x_start, y_start, z_start, &x[0], &y[0], &z[0], &s1actrev[0], &actfeed[0],
+										 &timestamp[0], &toolid[0], &tool_idx[0], &move_flags[0], count, cut_id, stlPath,
+										 NULL, NULL, NULL, NULL);
+		if (simulated != count)
+			return -1;
+		x_start = x.back();
+		y_start = y.back();
+		z_start = z.back();
+		cut_id += count;
+
+		if (ctx->progress_callback)
+			ctx->progress_callback(reader.bytes_read(), reader.bytes_total(), cut_id - 1, x_start, y_start, z_start,
+								   tool_number_current, block_nr_current);
+
+		// the batch ends on a sample boundary, the buffered cuts are simulated and the feature rows written
+		if (has_row && ctx->checkpoints.enabled() && ctx->checkpoints.due(cut_id - 1))
+		{
+			run.cut_id = cut_id - 1;
+			run.tool_idx = tool_idx_current;
+			run.tool_number = tool_number_current;
+			run.block_nr = block_nr_current;
+			run.x = x_start;
+			run.y = y_start;
+			run.z = z_start;
+			run.toolpath_offset = next_sample.offset;
+			run.toolpath_line = next_sample.line_idx;
+			run.result_format = ctx->feature_file ? ctx->result_format : -1;
+			if (ctx->feature_file)
+				run.feature_position = ctx->feature_file->position();
+			state.feature_file = ctx->feature_file ? ctx->feature_path : std::string();
+			ctx->checkpoints.save(*ctx->verifier, state);
+		}
+
+		x.clear();
+		y.clear();
+		z.clear();
+		s1actrev.clear();
+		actfeed.clear();
+		timestamp.clear();
+		toolid.clear();
+		tool_idx.clear();
+		move_flags.clear();
+	}
+
+	if (reader.malformed_rows() > 0)
+		std::cout << "\033[1;33mWARNING: Skipped " << reader.malformed_rows() << " malformed rows of the tool path file\033[0m" << std::endl;
+
+	if (ctx->feature_file)
+		ctx->feature_file->flush();
+	// the snapshot and checkpoint files are complete when the simulation returns
+	ctx->snapshots.flush();
+	ctx->checkpoints.flush();
+	ctx->stats.dump_if_due(true);
+	return cut_id - 1;
+}
+
+//@brief: simulate a whole tool path file. the file is parsed natively and fed to DoCutBatch,
+//        only the progress callback crosses back into the caller
+//@param: ctx: simulation context, stock, tools (with tool numbers) and config have to be set up
+//@param: toolpath_file: space separated tool path file with a name row
+//@param: sample_interval: row sampling interval (cycleTime_mw in the python config)
+//@param: isTrace: if record the engagement results in the feature file
+//@param: stlPath: folder for the periodic mesh snapshots
+//@ret: number of simulated moves, -1 on error
+int simulate_toolpath(SimContext *ctx, char *toolpath_file, int sample_interval, bool isTrace, char *stlPath)
+{
+	ToolpathReader reader;
+	if (!reader.open(toolpath_file, sample_interval))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Invalid tool path file " << toolpath_file << std::endl;
+		return -1;
+	}
+
+	ToolpathRow row;
+	if (!reader.read_start(row))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Tool path file " << toolpath_file << " has no data" << std::endl;
+		return -1;
+	}
+
+	CheckpointState state;
+	std::memset(&state.header, 0, sizeof(state.header));
+	state.header.x = row.x;
+	state.header.y = row.y;
+	state.header.z = row.z;
+	state.header.tool_number = row.tool_number;
+	state.header.tool_idx = find_tool_index(ctx, row.tool_number);
+	state.header.block_nr = row.block_nr;
+	state.header.sample_interval = sample_interval;
+	state.header.is_trace = isTrace ? 1 : 0;
+	state.toolpath_file = toolpath_file;
+	state.snapshot_dir = stlPath ? stlPath : "";
+	if (state.header.tool_idx < 0)
+		return -1;
+	set_current_tool(ctx, state.header.tool_idx);
+
+	return continue_toolpath(ctx, reader, state, stlPath);
+}
+
+//@brief: continue a tool path simulation from the checkpoint in a folder. the tool path file, the
+//        feature file and the snapshot folder of the checkpointed run are continued
+//@param: ctx: simulation context, tools (with tool numbers) and config have to be set up like for the
+//             checkpointed run, the stock and the feature file are restored from the checkpoint
+//@param: checkpoint_dir: checkpoint folder
+//@ret: last simulated step index (the step count of the whole run), -1 on error
+int resume_from_checkpoint(SimContext *ctx, char *checkpoint_dir)
+{
+	CheckpointState state;
+	if (!restore_checkpoint(ctx, checkpoint_dir, state))
+		return -1;
+
+	ToolpathReader reader;
+	ToolpathReader::Position position;
+	position.offset = state.header.toolpath_offset;
+	position.line_idx = state.header.toolpath_line;
+	if (!reader.open(state.toolpath_file.c_str(), state.header.sample_interval) || !reader.seek(position))
+	{
+		std::cout << "[\033[1;31mERROR\033[0m]  Tool path file " << state.toolpath_file << " of the checkpoint is missing or changed" << std::endl;
+		return -1;
+	}
+
+	std::vector<char> snapshot_dir(state.snapshot_dir.begin(), state.snapshot_dir.end());
+	snapshot_dir.push_back('\0');
+	return continue_toolpath(ctx, reader, state, &snapshot_dir[0]);
+}
@@ -0,0 +1,70 @@
+#pragma once
+// memory-mapped reader of the space separated tool path files (SimPathData / PathData)
+#include <cstddef>
+
+#include "mwMappedFile.hpp"
+
+// sampled row of a tool path file: timestamp x y z s1actrev actfeed toolid [block]
+struct ToolpathRow
+{
+	long long timestamp;
+	float x;
+	float y;
+	float z;
+	float s1actrev;
+	float actfeed;
+	// tool number from the nc program (column 6)
+	int tool_number;
+	// nc block number, only written by the vnck simulation (column 7), 0 otherwise
+	int block_nr;
+};
+
+//@brief: streams a tool path file through a read-only mapping and applies the cycle time decimation
+//
+// the first data row is the start position. of the following rows every sample_interval-th is kept
+// and the last row of the file is always kept, the same sampling as the former python loop in mwCamSim.sim
+class ToolpathReader
+{
+public:
+	// read position between two samples, restored with seek
+	struct Position
+	{
+		long long offset;
+		long long line_idx;
+	};
+
+	ToolpathReader();
+	~ToolpathReader();
+
+	bool open(const char *path, int sample_interval);
+	void close();
+
+	// first data row of the file, has to be read before the samples
+	bool read_start(ToolpathRow &row);
+	// next row kept by the decimation, false at the end of the file
+	bool next_sample(ToolpathRow &row);
+	// position of the next sample, only valid between next_sample calls
+	Position position() const;
+	// continue reading at a position returned by position() for the same file and sample interval
+	bool seek(const Position &position);
+
+	long long bytes_read() const { return (long long)(m_cursor - m_file.GetData()); }
+	long long bytes_total() const { return (long long)m_file.GetSize(); }
+	bool has_block_column() const { return m_has_block_column; }
+	// rows that are neither empty nor a full data row, they are skipped
+	long long malformed_rows() const { return m_malformed_rows; }
+
+private:
+	bool next_row(ToolpathRow &row);
+	void skip_line();
+
+	misc::mwMappedFile m_file;
+	const char *m_cursor;
+	const char *m_end;
+	int m_sample_interval;
+	long long m_line_idx;
+	long long m_malformed_rows;
+	bool m_has_block_column;
+	bool m_has_pending;
+	ToolpathRow m_pending;
+};
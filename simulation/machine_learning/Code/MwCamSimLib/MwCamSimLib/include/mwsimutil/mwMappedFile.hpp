@@ -0,0 +1,338 @@
+#ifndef MW_MWMAPPEDFILE_HPP_
+#define MW_MWMAPPEDFILE_HPP_
+#include "mwFileName.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace misc
+{
+/// This class maps a whole file into memory, read only or as growable append-only file.
+///
+/// In read only mode (Open) the pages are loaded by the system on first access, so several threads
+/// can read different parts of the file at the same time without any stream or buffer in between.
+/// In read/write mode (Create, OpenWritable) data is appended behind the used part of the file,
+/// the mapping grows by doubling and Close cuts the file back to the used size.
+class mwMappedFile
+{
+public:
+	/// Constructor of a closed file
+	mwMappedFile(): mData(0), mSize(0), mCapacity(0), mWritable(false) { InitHandles(); }
+
+	/// Destructor, unmaps the file
+	~mwMappedFile() { Close(); }
+
+	/// Open method
+	///
+	/// Maps a file read only, a file that is already mapped is closed first
+	///	@param fileName the name of the file
+	///	@param sequential the file is read front to back, the system reads ahead more aggressively
+	///	@return false if the file can not be opened or mapped
+	bool Open(const mwFileName& fileName, bool sequential = false)
+	{
+		Close();
+#ifdef _WIN32
+		mFile = CreateFile(
+			fileName.GetFilePath().c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			NULL,
+			OPEN_EXISTING,
+			sequential ? FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL,
+			NULL);
+		LARGE_INTEGER fileSize;
+		if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &fileSize) ||
+			(unsigned long long)fileSize.QuadPart > (size_t)-1)
+		{
+			Close();
+			return false;
+		}
+		mSize = (size_t)fileSize.QuadPart;
+		if (mSize == 0)
+			return true;  // an empty file can not be mapped
+		mMapping = CreateFileMapping(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mMapping != NULL)
+			mData = static_cast<char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		mFile = open(fileName.GetFilePath().ToUTF8().c_str(), O_RDONLY);
+		struct stat fileStat;
+		if (mFile < 0 || fstat(mFile, &fileStat) != 0)
+		{
+			Close();
+			return false;
+		}
+		mSize = (size_t)fileStat.st_size;
+		if (mSize == 0)
+			return true;  // an empty file can not be mapped
+		void* data = mmap(0, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+		if (data != MAP_FAILED)
+		{
+			if (sequential)
+				madvise(data, mSize, MADV_SEQUENTIAL);
+			mData = static_cast<char*>(data);
+		}
+#endif
+		if (mData == 0)
+		{
+			Close();
+			return false;
+		}
+		mCapacity = mSize;
+		return true;
+	}
+
+	/// Create method
+	///
+	/// Creates or truncates a file and maps it read/write, a file that is already mapped is closed first
+	///	@param fileName the name of the file
+	///	@param reservedSize number of zeroed bytes in front of the appended data, e.g. for a header
+	///	@return false if the file can not be created or mapped
+	bool Create(const mwFileName& fileName, size_t reservedSize)
+	{
+		Close();
+#ifdef _WIN32
+		mFile = CreateFile(
+			fileName.GetFilePath().c_str(),
+			GENERIC_READ | GENERIC_WRITE,
+			FILE_SHARE_READ,
+			NULL,
+			CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL,
+			NULL);
+		if (mFile == INVALID_HANDLE_VALUE)
+			return false;
+#else
+		mFile = open(fileName.GetFilePath().ToUTF8().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (mFile < 0)
+			return false;
+#endif
+		mWritable = true;
+		if (!Remap(GrownCapacity(0, reservedSize)))
+		{
+			Close();
+			return false;
+		}
+		std::memset(mData, 0, reservedSize);
+		mSize = reservedSize;
+		return true;
+	}
+
+	/// OpenWritable method
+	///
+	/// Maps an existing file read/write to continue appending, a file that is already mapped is closed first
+	///	@param fileName the name of the file
+	///	@param usedSize number of bytes to keep, the data behind them is dropped
+	///	@return false if the file does not exist, is shorter than usedSize or can not be mapped
+	bool OpenWritable(const mwFileName& fileName, size_t usedSize)
+	{
+		Close();
+		unsigned long long fileSize = 0;
+#ifdef _WIN32
+		mFile = CreateFile(
+			fileName.GetFilePath().c_str(),
+			GENERIC_READ | GENERIC_WRITE,
+			FILE_SHARE_READ,
+			NULL,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			NULL);
+		if (mFile == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER length;
+		if (GetFileSizeEx(mFile, &length))
+			fileSize = (unsigned long long)length.QuadPart;
+#else
+		mFile = open(fileName.GetFilePath().ToUTF8().c_str(), O_RDWR);
+		if (mFile < 0)
+			return false;
+		struct stat fileStat;
+		if (fstat(mFile, &fileStat) == 0)
+			fileSize = (unsigned long long)fileStat.st_size;
+#endif
+		mWritable = true;
+		if (fileSize < usedSize || !Remap(GrownCapacity(0, usedSize)))
+		{
+			// the file is left as it was
+			mSize = (size_t)fileSize;
+			Close();
+			return false;
+		}
+		mSize = usedSize;
+		return true;
+	}
+
+	/// Close method
+	///
+	/// Unmaps the file, the data returned by GetData is no longer valid. A file mapped read/write
+	/// is cut to its used size
+	///	@return false if a read/write file could not be cut to its used size
+	bool Close()
+	{
+		bool truncated = true;
+		Unmap();
+#ifdef _WIN32
+		if (mMapping != NULL)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+		{
+			if (mWritable)
+			{
+				LARGE_INTEGER end;
+				end.QuadPart = (LONGLONG)mSize;
+				truncated = SetFilePointerEx(mFile, end, NULL, FILE_BEGIN) && SetEndOfFile(mFile);
+			}
+			CloseHandle(mFile);
+		}
+#else
+		if (mFile >= 0)
+		{
+			if (mWritable)
+				truncated = ftruncate(mFile, (off_t)mSize) == 0;
+			close(mFile);
+		}
+#endif
+		mSize = 0;
+		mCapacity = 0;
+		mWritable = false;
+		InitHandles();
+		return truncated;
+	}
+
+	/// Append method
+	///
+	/// Appends bytes behind the used part of a read/write file, the mapping is grown if needed
+	///	@param data the bytes to append
+	///	@param size number of bytes
+	///	@return false if the file is not mapped read/write or the mapping could not be grown
+	bool Append(const void* data, size_t size)
+	{
+		if (!mWritable || mData == 0)
+			return false;
+		if (mSize + size > mCapacity && !Remap(GrownCapacity(mCapacity, mSize + size)))
+			return false;
+		std::memcpy(mData + mSize, data, size);
+		mSize += size;
+		return true;
+	}
+
+	/// Flush method
+	///
+	/// Starts writing the changed pages of a read/write file back to disk
+	void Flush()
+	{
+		if (!mWritable || mData == 0)
+			return;
+#ifdef _WIN32
+		FlushViewOfFile(mData, mSize);
+#else
+		msync(mData, mSize, MS_ASYNC);
+#endif
+	}
+
+	/// IsOpen method
+	///
+	///	@return true if the file is mapped, an empty read only file is open but not mapped
+	bool IsOpen() const { return mData != 0; }
+
+	/// GetData method
+	///
+	///	@return the first byte of the file, 0 if the file is closed or empty
+	const char* GetData() const { return mData; }
+
+	/// GetWritableData method
+	///
+	///	@return the first byte of a read/write file, 0 if the file is closed or read only
+	char* GetWritableData() { return mWritable ? mData : 0; }
+
+	/// GetSize method
+	///
+	///	@return the size of a read only file or the used size of a read/write file in bytes
+	size_t GetSize() const { return mSize; }
+
+private:
+	mwMappedFile(const mwMappedFile&);
+	mwMappedFile& operator=(const mwMappedFile&);
+
+	void InitHandles()
+	{
+#ifdef _WIN32
+		mFile = INVALID_HANDLE_VALUE;
+		mMapping = NULL;
+#else
+		mFile = -1;
+#endif
+	}
+
+	/// smallest mapping of a read/write file, it is doubled until size fits
+	static size_t GrownCapacity(size_t capacity, size_t size)
+	{
+		if (capacity == 0)
+			capacity = 1 << 20;
+		while (capacity < size)
+			capacity *= 2;
+		return capacity;
+	}
+
+	/// maps a read/write file with the given capacity, the file is grown accordingly
+	bool Remap(size_t capacity)
+	{
+		Unmap();
+#ifdef _WIN32
+		if (mMapping != NULL)
+			CloseHandle(mMapping);
+		const unsigned long long length = capacity;
+		mMapping = CreateFileMapping(mFile, NULL, PAGE_READWRITE, (DWORD)(length >> 32), (DWORD)(length & 0xffffffff), NULL);
+		if (mMapping == NULL)
+			return false;
+		mData = static_cast<char*>(MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity));
+		if (mData == 0)
+			return false;
+#else
+		if (ftruncate(mFile, (off_t)capacity) != 0)
+			return false;
+		void* data = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+		if (data == MAP_FAILED)
+			return false;
+		mData = static_cast<char*>(data);
+#endif
+		mCapacity = capacity;
+		return true;
+	}
+
+	/// releases the view, the file stays open
+	void Unmap()
+	{
+		if (mData == 0)
+			return;
+#ifdef _WIN32
+		if (mWritable)
+			FlushViewOfFile(mData, 0);
+		UnmapViewOfFile(mData);
+#else
+		munmap(mData, mCapacity);
+#endif
+		mData = 0;
+	}
+
+	char* mData;
+	size_t mSize;
+	size_t mCapacity;
+	bool mWritable;
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int mFile;
+#endif
+};
+}  // namespace misc
+#endif  //	MW_MWMAPPEDFILE_HPP_
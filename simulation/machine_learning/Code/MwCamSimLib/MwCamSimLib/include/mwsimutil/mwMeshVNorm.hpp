@@ -5,6 +5,7 @@
 #define MW_MWMESHVNORM_HPP_
 #include "mwDllImpExpDef.hpp"
 #include "mwMesh.hpp"
+#include "mwTriangleBvh.hpp"
 #include "mwTrig.hpp"
 
 #include <mwVector.hpp>
@@ -211,6 +212,10 @@ public:
 
 private:
 	static const unsigned NO_NEIGHBOR;
+	/// runs of equal points with more sides are searched in their sides sorted by the other end
+	static const size_t MAX_SCANNED_RUN_SIDES = 64;
+	/// rays IsOrientationSetToOutside casts against all triangles before it builds mTriangleBvh
+	static const size_t RAYS_BEFORE_BVH;
 
 
 	void InitializeDefaults()
@@ -218,6 +223,7 @@ private:
 		m_flipTriangles = 0;
 		m_dAngleLimit = 15.0;
 		mlastKnownUnvisited = 0;
+		mRaysWithoutBvh = 0;
 	}
 
 public:
@@ -444,6 +450,8 @@ public:
 
 		pointTIndArray emptyList;
 		mPointsTInd.swap(emptyList);
+		std::vector<unsigned> emptyGroups;
+		mPointGroup.swap(emptyGroups);
 
 #pragma warning(pop)
 	}
@@ -510,11 +518,22 @@ private:
 
 	EdgeList m_EdgeList;
 
+	/// side at an entry of mPointsTInd for MakeNeighborhood: entry of its other end and triangle
+	typedef std::pair<unsigned, unsigned> SideEntry;
+
 	pointTIndArray mPointsTInd;
+	/// run of every entry of mPointsTInd: equal consecutive points share the index of their first entry
+	std::vector<unsigned> mPointGroup;
 	double m_dAngleLimit;
 	std::vector<unsigned> vNeighbors;
 	bool m_flipTriangles;
 	size_t mlastKnownUnvisited;
+	/// hierarchy over the triangles for the rays of IsOrientationSetToOutside, built once enough
+	/// rays were cast against all triangles to pay for it
+	mwTriangleBvh<ValueType> mTriangleBvh;
+	size_t mRaysWithoutBvh;
+	/// triangles whose bounding box contains the current ray
+	std::vector<unsigned> mRayCandidates;
 
 	/// ConstructMeshCopy method
 	///
@@ -601,6 +620,22 @@ private:
 		}
 	}
 
+	/// GroupEqualPoints method
+	///
+	/// Groups the entries of mPointsTInd into the runs of equal consecutive points that FindNeighbor
+	/// scans, the entries do not have to be sorted
+	void GroupEqualPoints()
+	{
+		const size_t szPtSize = mPointsTInd.size();
+		mPointGroup.resize(szPtSize);
+		for (size_t i = 0; i < szPtSize; ++i)
+		{
+			mPointGroup[i] = (i > 0 && mPointsTInd[i].GetPoint() == mPointsTInd[i - 1].GetPoint())
+				? mPointGroup[i - 1]
+				: (unsigned)i;
+		}
+	}
+
 	/// BuildMesh method
 	///
 	/// Mesh building
@@ -618,6 +653,8 @@ private:
 
 		pointTIndArray emptyList;
 		mPointsTInd.swap(emptyList);
+		std::vector<unsigned> emptyGroups;
+		mPointGroup.swap(emptyGroups);
 
 #pragma warning(pop)
 	}
@@ -625,68 +662,299 @@ private:
 
 	/// MakeNeighborhood method
 	///
-	/// Creates the neighborhood info
+	/// Creates the neighborhood info from an edge adjacency built in one pass: every entry of
+	/// mPointsTInd lists the two sides of its triangle it ends, so the sides at a run of equal points
+	/// are consecutive and the neighbor over a side is searched among them, in the order and with the
+	/// point comparison of FindNeighbor, without scanning the points for the run first. The sides of
+	/// long runs are also sorted by the point of their other end, so a high valence point is not
+	/// scanned once per side.
 	/// @param aTriNeighbors - array of neighbors info
 	void MakeNeighborhood(TriNeighborsArray& aTriNeighbors)
 	{
+		GroupEqualPoints();
+
 		size_t i = 0;
 		size_t szTriSize = this->mTriangles->size();
 		aTriNeighbors.clear();
 		aTriNeighbors.reserve(szTriSize + 2);
+		aTriNeighbors.resize(szTriSize);
 
-		for (i = 0; i < szTriSize; ++i)
+		// sides whose ends are close enough have no neighbor
+		std::vector<unsigned char> sideDegenerated(szTriSize * 3);
+		ForEachTriangleRange(szTriSize, [&](size_t szBegin, size_t szEnd) {
+			MarkDegeneratedSides(szBegin, szEnd, sideDegenerated);
+		});
+
+		// (other end, triangle) of the two sides at every entry, 2 * entry is the first of them
+		const size_t szPtSize = mPointsTInd.size();
+		std::vector<SideEntry> entrySides(2 * szPtSize);
+		ForEachTriangleRange(szPtSize, [&](size_t szBegin, size_t szEnd) {
+			ListEntrySides(szBegin, szEnd, entrySides);
+		});
+		std::vector<unsigned> runEnd(szPtSize, 0);
+		for (i = 0; i < szPtSize; ++i)
+			runEnd[mPointGroup[i]] = (unsigned)(i + 1);
+		std::vector<unsigned> sortedSides(2 * szPtSize);
+		ForEachTriangleRange(szPtSize, [&](size_t szBegin, size_t szEnd) {
+			SortLongRunSides(szBegin, szEnd, runEnd, entrySides, sortedSides);
+		});
+
+		ForEachTriangleRange(szTriSize, [&](size_t szBegin, size_t szEnd) {
+			ResolveNeighbors(
+				szBegin, szEnd, sideDegenerated, runEnd, entrySides, sortedSides, aTriNeighbors);
+		});
+	}
+
+	/// ListEntrySides method
+	///
+	/// Lists the two sides of its triangle that a range of entries of mPointsTInd ends
+	/// @param szBegin - first entry
+	/// @param szEnd - entry after the range
+	/// @param entrySides - (other end, triangle) of the sides, 2 per entry
+	void ListEntrySides(size_t szBegin, size_t szEnd, std::vector<SideEntry>& entrySides)
+	{
+		for (size_t i = szBegin; i < szEnd; ++i)
 		{
-			const Triangle& triangle = (*this->mTriangles)[i];
-			size_t szPt1Ind = triangle.GetFirstPointIndex();
-			size_t szPt2Ind = triangle.GetSecondPointIndex();
-			size_t szPt3Ind = triangle.GetThirdPointIndex();
+			const point3dTInd& entry = mPointsTInd[i];
+			const unsigned triIndex = (unsigned)entry.GetTriangleIndex();
+			const Triangle& triangle = (*this->mTriangles)[triIndex];
+			entrySides[2 * i] = SideEntry(
+				(unsigned)GetTrianglePointIndex(triangle, entry.GetPointIndex() + 1), triIndex);
+			entrySides[2 * i + 1] = SideEntry(
+				(unsigned)GetTrianglePointIndex(triangle, entry.GetPointIndex() + 2), triIndex);
+		}
+	}
 
-			const point3d& ptP1 = mPointsTInd[szPt1Ind].GetPoint();
-			const point3d& ptP2 = mPointsTInd[szPt2Ind].GetPoint();
-			const point3d& ptP3 = mPointsTInd[szPt3Ind].GetPoint();
+	/// GetTrianglePointIndex method
+	///
+	/// @param triangle - the triangle
+	/// @param iPt - index of the point in the triangle, modulo 3, side iSide ends at iSide and iSide + 1
+	/// @return index of the point in mPointsTInd
+	MW_FORCEINLINE static size_t GetTrianglePointIndex(const Triangle& triangle, int iPt)
+	{
+		switch (iPt % 3)
+		{
+		case 0:
+			return triangle.GetFirstPointIndex();
+		case 1:
+			return triangle.GetSecondPointIndex();
+		default:
+			return triangle.GetThirdPointIndex();
+		}
+	}
 
-			TriNeighbors triNeighbors;
-			if (!PointsCloseEnough(ptP1, ptP2))
-			{
-				size_t neighbor = FindNeighbor(i, szPt1Ind, szPt2Ind);
-				if (neighbor == NO_NEIGHBOR)
+	/// SortLongRunSides method
+	///
+	/// Sorts the sides of the long runs starting in a range of entries by the point of their other
+	/// end, sides with equal points keep their order
+	/// @param szBegin - first entry
+	/// @param szEnd - entry after the range
+	/// @param runEnd - entry after the last one of every run
+	/// @param entrySides - (other end, triangle) of the two sides at every entry
+	/// @param sortedSides - positions in entrySides, sorted per long run
+	void SortLongRunSides(
+		size_t szBegin,
+		size_t szEnd,
+		const std::vector<unsigned>& runEnd,
+		const std::vector<SideEntry>& entrySides,
+		std::vector<unsigned>& sortedSides)
+	{
+		for (size_t i = szBegin; i < szEnd; ++i)
+		{
+			if (mPointGroup[i] != i || 2 * (runEnd[i] - i) <= MAX_SCANNED_RUN_SIDES)
+				continue;
+			const std::vector<unsigned>::iterator first = sortedSides.begin() + 2 * i;
+			const std::vector<unsigned>::iterator last = sortedSides.begin() + 2 * (size_t)runEnd[i];
+			for (std::vector<unsigned>::iterator it = first; it != last; ++it)
+				*it = (unsigned)(it - sortedSides.begin());
+			std::sort(first, last, [&](unsigned szSide1, unsigned szSide2) {
+				const point3d& pt1 = mPointsTInd[entrySides[szSide1].first].GetPoint();
+				const point3d& pt2 = mPointsTInd[entrySides[szSide2].first].GetPoint();
+				for (size_t axis = 0; axis < 3; ++axis)
 				{
-					// switch the points and try again
-					neighbor = FindNeighbor(i, szPt2Ind, szPt1Ind);
+					if (pt1[axis] != pt2[axis])
+						return pt1[axis] < pt2[axis];
 				}
-				triNeighbors.SetFirstNeighborIndex(neighbor);
+				return szSide1 < szSide2;
+			});
+		}
+	}
+
+	/// MarkDegeneratedSides method
+	///
+	/// Marks the sides of a range of triangles whose ends are close enough
+	/// @param szBegin - first triangle index
+	/// @param szEnd - triangle index after the range
+	/// @param sideDegenerated - flag of every side (3 per triangle)
+	void MarkDegeneratedSides(size_t szBegin, size_t szEnd, std::vector<unsigned char>& sideDegenerated)
+	{
+		for (size_t i = szBegin; i < szEnd; ++i)
+		{
+			const Triangle& triangle = (*this->mTriangles)[i];
+			for (int iSide = 0; iSide < 3; ++iSide)
+			{
+				sideDegenerated[3 * i + iSide] = PointsCloseEnough(
+					mPointsTInd[GetTrianglePointIndex(triangle, iSide)].GetPoint(),
+					mPointsTInd[GetTrianglePointIndex(triangle, iSide + 1)].GetPoint());
 			}
-			else
-				triNeighbors.SetFirstNeighborIndex(NO_NEIGHBOR);
+		}
+	}
 
-			if (!PointsCloseEnough(ptP2, ptP3))
+	/// ResolveNeighbors method
+	///
+	/// Finds the neighbors of a range of triangles in the side lists of MakeNeighborhood
+	/// @param szBegin - first triangle index
+	/// @param szEnd - triangle index after the range
+	/// @param sideDegenerated - flag of every side, degenerated sides have no neighbor
+	/// @param runEnd - entry after the last one of every run
+	/// @param entrySides - (other end, triangle) of the two sides at every entry
+	/// @param sortedSides - positions in entrySides, sorted per long run
+	/// @param aTriNeighbors - array of neighbors info, the entries of the range are set
+	void ResolveNeighbors(
+		size_t szBegin,
+		size_t szEnd,
+		const std::vector<unsigned char>& sideDegenerated,
+		const std::vector<unsigned>& runEnd,
+		const std::vector<SideEntry>& entrySides,
+		const std::vector<unsigned>& sortedSides,
+		TriNeighborsArray& aTriNeighbors)
+	{
+		for (size_t i = szBegin; i < szEnd; ++i)
+		{
+			const Triangle& triangle = (*this->mTriangles)[i];
+			TriNeighbors& triNeighbors = aTriNeighbors[i];
+			for (int iSide = 0; iSide < 3; ++iSide)
 			{
-				size_t neighbor = FindNeighbor(i, szPt2Ind, szPt3Ind);
-				if (neighbor == NO_NEIGHBOR)
+				unsigned neighbor = NO_NEIGHBOR;
+				if (!sideDegenerated[3 * i + iSide])
 				{
-					// switch the points and try again
-					neighbor = FindNeighbor(i, szPt3Ind, szPt2Ind);
+					const size_t szPtA = GetTrianglePointIndex(triangle, iSide);
+					const size_t szPtB = GetTrianglePointIndex(triangle, iSide + 1);
+					neighbor = FindSideNeighbor(i, szPtA, szPtB, runEnd, entrySides, sortedSides);
+					if (neighbor == NO_NEIGHBOR)
+					{
+						// switch the points and try again
+						neighbor = FindSideNeighbor(i, szPtB, szPtA, runEnd, entrySides, sortedSides);
+					}
 				}
-				triNeighbors.SetSecondNeighborIndex(neighbor);
+				triNeighbors.m_szTriangleNeighbor[iSide] = neighbor;
 			}
-			else
-				triNeighbors.SetSecondNeighborIndex(NO_NEIGHBOR);
+		}
+	}
+
+	/// FindSideNeighbor method
+	///
+	/// Finds the first triangle at the run of one point which contains the other point, as
+	/// FindNeighbor does
+	/// @param szTriInd - triangle index
+	/// @param ptAInd - first point index, its run is searched
+	/// @param ptBInd - second point index
+	/// @param runEnd - entry after the last one of every run
+	/// @param entrySides - (other end, triangle) of the two sides at every entry
+	/// @param sortedSides - positions in entrySides, sorted per long run
+	/// @return triangle index, NO_NEIGHBOR if there is none
+	unsigned FindSideNeighbor(
+		size_t szTriInd,
+		size_t ptAInd,
+		size_t ptBInd,
+		const std::vector<unsigned>& runEnd,
+		const std::vector<SideEntry>& entrySides,
+		const std::vector<unsigned>& sortedSides)
+	{
+		const unsigned run = mPointGroup[ptAInd];
+		const point3d& ptB = mPointsTInd[ptBInd].GetPoint();
+		const size_t szFirst = 2 * (size_t)run;
+		const size_t szLast = 2 * (size_t)runEnd[run];
+		if (szLast - szFirst > MAX_SCANNED_RUN_SIDES)
+		{
+			const unsigned szSide = FindSortedSide(
+				szTriInd,
+				ptB,
+				sortedSides.begin() + szFirst,
+				sortedSides.begin() + szLast,
+				0,
+				entrySides);
+			return szSide == NO_NEIGHBOR ? NO_NEIGHBOR : entrySides[szSide].second;
+		}
+		for (size_t szSide = szFirst; szSide < szLast; ++szSide)
+		{
+			const SideEntry& side = entrySides[szSide];
+			if (side.second != szTriInd && PointsCloseEnough(mPointsTInd[side.first].GetPoint(), ptB))
+				return side.second;
+		}
+		return NO_NEIGHBOR;
+	}
 
-			if (!PointsCloseEnough(ptP3, ptP1))
+	/// FindSortedSide method
+	///
+	/// Finds the first side in the order of FindNeighbor among sides sorted by the point of their
+	/// other end, whose other end is close enough to a point. The sides have equal coordinates before
+	/// axis, so they are sorted by the coordinate axis and every window of it is a subrange.
+	/// @param szTriInd - triangle index, its own sides are skipped
+	/// @param ptB - the point
+	/// @param first - first sorted side
+	/// @param last - sorted side after the range
+	/// @param axis - first coordinate not yet compared
+	/// @param entrySides - (other end, triangle) of the two sides at every entry
+	/// @return position of the side in entrySides, NO_NEIGHBOR if there is none
+	unsigned FindSortedSide(
+		size_t szTriInd,
+		const point3d& ptB,
+		std::vector<unsigned>::const_iterator first,
+		std::vector<unsigned>::const_iterator last,
+		size_t axis,
+		const std::vector<SideEntry>& entrySides)
+	{
+		if (axis == 3)
+		{
+			// equal points, sorted by their position
+			for (; first != last; ++first)
 			{
-				size_t neighbor = FindNeighbor(i, szPt3Ind, szPt1Ind);
-				if (neighbor == NO_NEIGHBOR)
-				{
-					// switch the points and try again
-					neighbor = FindNeighbor(i, szPt1Ind, szPt3Ind);
-				}
-				triNeighbors.SetThirdNeighborIndex(neighbor);
+				const SideEntry& side = entrySides[*first];
+				if (side.second != szTriInd
+					&& PointsCloseEnough(mPointsTInd[side.first].GetPoint(), ptB))
+					return *first;
 			}
-			else
-				triNeighbors.SetThirdNeighborIndex(NO_NEIGHBOR);
+			return NO_NEIGHBOR;
+		}
 
-			aTriNeighbors.push_back(triNeighbors);
+		// the coordinates of points close enough differ by less than 1e-12
+		const T window = (T)2e-12;
+		const T lower = ptB[axis] - window;
+		const T upper = ptB[axis] + window;
+		first = std::lower_bound(first, last, lower, [&](unsigned szSide, T value) {
+			return mPointsTInd[entrySides[szSide].first].GetPoint()[axis] < value;
+		});
+		unsigned found = NO_NEIGHBOR;
+		while (first != last && mPointsTInd[entrySides[*first].first].GetPoint()[axis] <= upper)
+		{
+			// the sides with one value of this coordinate are sorted by the next one
+			const T value = mPointsTInd[entrySides[*first].first].GetPoint()[axis];
+			const std::vector<unsigned>::const_iterator valueEnd =
+				std::upper_bound(first, last, value, [&](T coord, unsigned szSide) {
+					return coord < mPointsTInd[entrySides[szSide].first].GetPoint()[axis];
+				});
+			const unsigned szSide = FindSortedSide(szTriInd, ptB, first, valueEnd, axis + 1, entrySides);
+			if (szSide < found)
+				found = szSide;
+			first = valueEnd;
 		}
+		return found;
+	}
+
+	/// ForEachTriangleRange method
+	///
+	/// Runs a function on consecutive ranges of [0, szCount), on threads if available
+	/// @param szCount - number of elements
+	/// @param func - called as func(begin, end)
+	template <class Func>
+	static void ForEachTriangleRange(size_t szCount, const Func& func)
+	{
+#ifndef MW_USE_VS2008_COMPATIBILITY
+		mwContainerMesh<T>::ForEachRange(szCount, 0, func);
+#else
+		func((size_t)0, szCount);
+#endif
 	}
 
 	/// RemoveDuplicateTriangles method
@@ -1014,6 +1282,7 @@ private:
 	{
 		// size_t i = 0;
 		this->mlastKnownUnvisited = 0;
+		mRaysWithoutBvh = 0;
 		std::vector<int> visited;  // 0:	Not visited
 		size_t szTriSize = this->mTriangles->size();
 		// 1:	Orientation and Normal Adjusted
@@ -1056,12 +1325,15 @@ private:
 			//
 			szUnvisitedTriangle = ExistUnvisitedTriangle(visited);
 		}
+		mTriangleBvh.Clear();
 
 #pragma warning(push)
 #pragma warning(disable : 4239)
 
 		std::vector<unsigned> emptyList;
 		vNeighbors.swap(emptyList);
+		std::vector<unsigned> emptyCandidates;
+		mRayCandidates.swap(emptyCandidates);
 
 #pragma warning(pop)
 	}
@@ -1345,6 +1617,44 @@ private:
 		return fDiff * fDiff <= mathdef::MW_MATH_TOL_SQR;
 	}
 
+	/// BuildTriangleBvh method
+	///
+	/// Builds the hierarchy over the bounding boxes of all triangles
+	void BuildTriangleBvh()
+	{
+		const size_t szTriSize = this->mTriangles->size();
+		std::vector<ValueType> boxMin(3 * szTriSize);
+		std::vector<ValueType> boxMax(3 * szTriSize);
+		for (size_t i = 0; i < szTriSize; ++i)
+		{
+			const Triangle& tri = (*this->mTriangles)[i];
+			const point3d& v1 = mPointsTInd[tri.GetFirstPointIndex()].GetPoint();
+			const point3d& v2 = mPointsTInd[tri.GetSecondPointIndex()].GetPoint();
+			const point3d& v3 = mPointsTInd[tri.GetThirdPointIndex()].GetPoint();
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				boxMin[3 * i + axis] = mathdef::mw_min(v1[axis], v2[axis], v3[axis]);
+				boxMax[3 * i + axis] = mathdef::mw_max(v1[axis], v2[axis], v3[axis]);
+			}
+		}
+		mTriangleBvh.Build(boxMin, boxMax);
+	}
+
+	/// NextUnitRandom method
+	///
+	/// Splitmix step of a deterministic random generator
+	/// @param state - state of the generator, advanced by the call
+	/// @return random value between [0,1]
+	static ValueType NextUnitRandom(unsigned long long& state)
+	{
+		state += 0x9E3779B97F4A7C15ULL;
+		unsigned long long z = state;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z ^= z >> 31;
+		return static_cast<ValueType>(z >> 40) / static_cast<ValueType>(0xFFFFFF);
+	}
+
 	/// SetOrientationToOutside method
 	///
 	/// Sets the orientation of the triangle normal so that it is oriented towards the outside of
@@ -1367,7 +1677,8 @@ private:
 		int ray_dir, intersections_count = 0;
 		bool bad_intersections;
 		bool upside_OZ = false;
-		srand((unsigned)time(MW_NULL) + rand());
+		// the retry points are random but reproducible for the same mesh
+		unsigned long long randomState = 0x9E3779B97F4A7C15ULL * (szTriInd + 1);
 		ValueType x, y, z;  // random values between [0,1] with r1+r2+r3=1
 		ValueType c1, c2, c3, coef,
 			coef2;  // coeficients corresponding to the ray position the triangle, need to be
@@ -1436,14 +1747,27 @@ private:
 			else
 			{
 				// get a random inside point
-				ValueType r1 = static_cast<ValueType>(rand()) / static_cast<ValueType>(RAND_MAX);
-				ValueType r2 = (static_cast<ValueType>(1.0) - r1) * static_cast<ValueType>(rand()) /
-					static_cast<ValueType>(RAND_MAX);
+				ValueType r1 = NextUnitRandom(randomState);
+				ValueType r2 = (static_cast<ValueType>(1.0) - r1) * NextUnitRandom(randomState);
 				ValueType r3 = static_cast<ValueType>(1.0) - r1 - r2;
 				cpoint = (r1 * pt1 + r2 * pt2 + r3 * pt3);
 			}
-			for (size_t id_secondtri = 0; id_secondtri < szTriSize; ++id_secondtri)
+			// only the triangles whose bounding box contains the ray line can be intersected. the
+			// first rays are checked against all triangles, a mesh with many conex components then
+			// builds the hierarchy: only the point indices change while orienting, not the geometry
+			const bool bUseBvh = mTriangleBvh.GetNumberOfTriangles() == szTriSize ||
+				++mRaysWithoutBvh > RAYS_BEFORE_BVH;
+			if (bUseBvh)
+			{
+				if (mTriangleBvh.GetNumberOfTriangles() != szTriSize)
+					BuildTriangleBvh();
+				mTriangleBvh.CollectAxisLine(
+					ray_dir, cpoint.x(), cpoint.y(), cpoint.z(), mRayCandidates);
+			}
+			const size_t szCandidates = bUseBvh ? mRayCandidates.size() : szTriSize;
+			for (size_t szCandidate = 0; szCandidate < szCandidates; ++szCandidate)
 			{
+				const size_t id_secondtri = bUseBvh ? mRayCandidates[szCandidate] : szCandidate;
 				if (bad_intersections)
 					break;
 				if (id_secondtri == szTriInd)
@@ -2091,33 +2415,38 @@ private:
 
 		this->mNormals->assign(szPtSize, point3d(0, 0, 0));
 
+		// triangles around every point (CSR) in ascending order, so every vertex normal is summed by
+		// one thread in the same order as triangle by triangle
+		std::vector<unsigned> pointBegin(szPtSize + 1, 0);
 		for (i = 0; i < szTriSize; ++i)
 		{
 			const Triangle& triangle = (*this->mTriangles)[i];
-			const point3d& ptNorm = triangle.GetNormalVector();
-			size_t szPtIndex1 = triangle.GetFirstPointIndex();
-			size_t szPtIndex2 = triangle.GetSecondPointIndex();
-			size_t szPtIndex3 = triangle.GetThirdPointIndex();
-
-			if (szPtIndex1 < 0 || szPtIndex1 >= szPtSize || szPtIndex2 < 0 ||
-				szPtIndex2 >= szPtSize || szPtIndex3 < 0 || szPtIndex3 >= szPtSize ||
-				szPtIndex1 == szPtIndex2 || szPtIndex2 == szPtIndex3 || szPtIndex3 == szPtIndex1)
+			if (!IsValidNormalTriangle(triangle, szPtSize))
 				continue;
-
-			(*(this->mNormals))[szPtIndex1] += ptNorm;
-			(*(this->mNormals))[szPtIndex2] += ptNorm;
-			(*(this->mNormals))[szPtIndex3] += ptNorm;
+			++pointBegin[triangle.GetFirstPointIndex() + 1];
+			++pointBegin[triangle.GetSecondPointIndex() + 1];
+			++pointBegin[triangle.GetThirdPointIndex() + 1];
 		}
-
-		point3d ptOrigin(0, 0, 0);
 		for (i = 0; i < szPtSize; ++i)
+			pointBegin[i + 1] += pointBegin[i];
+		std::vector<unsigned> pointTriangles(pointBegin[szPtSize]);
 		{
-			if (this->mNormals->at(i) != ptOrigin)
+			std::vector<unsigned> pointFill(pointBegin.begin(), pointBegin.end() - 1);
+			for (i = 0; i < szTriSize; ++i)
 			{
-				this->mNormals->at(i).Normalize();
+				const Triangle& triangle = (*this->mTriangles)[i];
+				if (!IsValidNormalTriangle(triangle, szPtSize))
+					continue;
+				pointTriangles[pointFill[triangle.GetFirstPointIndex()]++] = (unsigned)i;
+				pointTriangles[pointFill[triangle.GetSecondPointIndex()]++] = (unsigned)i;
+				pointTriangles[pointFill[triangle.GetThirdPointIndex()]++] = (unsigned)i;
 			}
 		}
 
+		ForEachTriangleRange(szPtSize, [&](size_t szBegin, size_t szEnd) {
+			SumVertexNormals(szBegin, szEnd, pointBegin, pointTriangles);
+		});
+
 		for (i = 0; i < szTriSize; ++i)
 		{
 			Triangle& triangle = (*this->mTriangles)[i];
@@ -2154,6 +2483,47 @@ private:
 		}
 	}
 
+	/// IsValidNormalTriangle method
+	///
+	/// Determines if a triangle contributes to the vertex normals
+	/// @param triangle - the triangle
+	/// @param szPtSize - number of points
+	/// @return true if the points of the triangle are valid and different
+	MW_FORCEINLINE static bool IsValidNormalTriangle(const Triangle& triangle, size_t szPtSize)
+	{
+		size_t szPtIndex1 = triangle.GetFirstPointIndex();
+		size_t szPtIndex2 = triangle.GetSecondPointIndex();
+		size_t szPtIndex3 = triangle.GetThirdPointIndex();
+
+		return !(
+			szPtIndex1 >= szPtSize || szPtIndex2 >= szPtSize || szPtIndex3 >= szPtSize ||
+			szPtIndex1 == szPtIndex2 || szPtIndex2 == szPtIndex3 || szPtIndex3 == szPtIndex1);
+	}
+
+	/// SumVertexNormals method
+	///
+	/// Sums and normalizes the vertex normals of a range of points from the triangles around them
+	/// @param szBegin - first point index
+	/// @param szEnd - point index after the range
+	/// @param pointBegin - start of the triangle list of every point in pointTriangles
+	/// @param pointTriangles - triangles listed by their points
+	void SumVertexNormals(
+		size_t szBegin,
+		size_t szEnd,
+		const std::vector<unsigned>& pointBegin,
+		const std::vector<unsigned>& pointTriangles)
+	{
+		const point3d ptOrigin(0, 0, 0);
+		for (size_t i = szBegin; i < szEnd; ++i)
+		{
+			point3d& ptNormal = (*this->mNormals)[i];
+			for (unsigned k = pointBegin[i]; k < pointBegin[i + 1]; ++k)
+				ptNormal += (*this->mTriangles)[pointTriangles[k]].GetNormalVector();
+			if (ptNormal != ptOrigin)
+				ptNormal.Normalize();
+		}
+	}
+
 	/// GetTriangleVertexNormal method
 	///
 	/// Get the vertex normal of a triangle
@@ -2213,5 +2583,7 @@ public:
 };
 template <typename T>
 const unsigned mwTMeshVNorm<T>::NO_NEIGHBOR = static_cast<unsigned>(-1);
+template <typename T>
+const size_t mwTMeshVNorm<T>::RAYS_BEFORE_BVH = 32;
 }  // namespace cadcam
 #endif  //	MW_MWMESHVNORM_HPP_
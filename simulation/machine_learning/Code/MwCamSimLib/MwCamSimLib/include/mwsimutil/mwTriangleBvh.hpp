@@ -0,0 +1,360 @@
+#ifndef MW_MWTRIANGLEBVH_HPP_
+#define MW_MWTRIANGLEBVH_HPP_
+#include <algorithm>
+#include <vector>
+
+namespace cadcam
+{
+/// This class represents a bounding volume hierarchy over the triangles of a mesh.
+///
+/// The hierarchy is built top down with the surface area heuristic over binned triangle
+/// centroids. The bounding boxes of the triangles are stored per leaf in separate coordinate
+/// arrays, so a leaf is tested in a branch-free loop the compiler can vectorize. Queries return
+/// the triangles whose bounding box may be hit, the exact test is left to the caller.
+/// @tparam T type used for coordinates
+template <typename T>
+class mwTriangleBvh
+{
+public:
+	/// Constructor of an empty hierarchy
+	mwTriangleBvh() {}
+
+	/// Build method
+	///
+	/// Builds the hierarchy over the given triangle bounding boxes
+	/// @param boxMin - minimum corner of every triangle, 3 coordinates per triangle
+	/// @param boxMax - maximum corner of every triangle, 3 coordinates per triangle
+	void Build(const std::vector<T>& boxMin, const std::vector<T>& boxMax)
+	{
+		Clear();
+		const size_t szTriSize = boxMin.size() / 3;
+		if (szTriSize == 0)
+			return;
+
+		// the items are partitioned in place, so every node works on contiguous memory
+		std::vector<BuildItem> items(szTriSize);
+		for (size_t i = 0; i < szTriSize; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				items[i].min[axis] = boxMin[3 * i + axis];
+				items[i].max[axis] = boxMax[3 * i + axis];
+				items[i].centroid[axis] =
+					(boxMin[3 * i + axis] + boxMax[3 * i + axis]) * static_cast<T>(0.5);
+			}
+			items[i].index = (unsigned)i;
+		}
+
+		mNodes.reserve(2 * szTriSize / MAX_LEAF_SIZE + 1);
+		mNodes.push_back(Node());
+		BuildNode(0, items, 0, (unsigned)szTriSize, 0);
+
+		// triangles and their boxes in leaf order
+		mOrder.resize(szTriSize);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			mLeafMin[axis].resize(szTriSize);
+			mLeafMax[axis].resize(szTriSize);
+		}
+		for (size_t i = 0; i < szTriSize; ++i)
+		{
+			mOrder[i] = items[i].index;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				mLeafMin[axis][i] = items[i].min[axis];
+				mLeafMax[axis][i] = items[i].max[axis];
+			}
+		}
+	}
+
+	/// Clear method
+	///
+	/// Releases the hierarchy
+	void Clear()
+	{
+		std::vector<Node>().swap(mNodes);
+		std::vector<unsigned>().swap(mOrder);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			std::vector<T>().swap(mLeafMin[axis]);
+			std::vector<T>().swap(mLeafMax[axis]);
+		}
+	}
+
+	/// GetNumberOfTriangles method
+	///
+	/// @return the number of triangles the hierarchy was built over
+	size_t GetNumberOfTriangles() const { return mOrder.size(); }
+
+	/// CollectAxisLine method
+	///
+	/// Collects the triangles whose bounding box contains the axis parallel line through a point
+	/// @param axis - direction of the line, 0, 1 or 2 for OX, OY or OZ
+	/// @param ptX, ptY, ptZ - point on the line
+	/// @param candidates - receives the triangle indices, in no particular order
+	void CollectAxisLine(int axis, T ptX, T ptY, T ptZ, std::vector<unsigned>& candidates) const
+	{
+		candidates.clear();
+		if (mNodes.empty())
+			return;
+
+		// the two coordinates across the line
+		const int axisA = axis == 0 ? 1 : 0;
+		const int axisB = axis == 2 ? 1 : 2;
+		const T pt[3] = {ptX, ptY, ptZ};
+		const T a = pt[axisA];
+		const T b = pt[axisB];
+
+		unsigned stack[MAX_DEPTH + 2];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const Node& node = mNodes[stack[--stackSize]];
+			if (a < node.min[axisA] || a > node.max[axisA] || b < node.min[axisB] ||
+				b > node.max[axisB])
+				continue;
+
+			if (node.count == 0)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+				continue;
+			}
+
+			const T* minA = &mLeafMin[axisA][node.first];
+			const T* maxA = &mLeafMax[axisA][node.first];
+			const T* minB = &mLeafMin[axisB][node.first];
+			const T* maxB = &mLeafMax[axisB][node.first];
+			unsigned hits[MAX_LEAF_SIZE];
+			for (unsigned k = 0; k < node.count; ++k)
+			{
+				hits[k] = (unsigned)(a >= minA[k]) & (unsigned)(a <= maxA[k]) &
+					(unsigned)(b >= minB[k]) & (unsigned)(b <= maxB[k]);
+			}
+			for (unsigned k = 0; k < node.count; ++k)
+			{
+				if (hits[k])
+					candidates.push_back(mOrder[node.first + k]);
+			}
+		}
+	}
+
+private:
+	enum
+	{
+		/// maximum number of triangles in a leaf
+		MAX_LEAF_SIZE = 8,
+		/// number of centroid bins per axis of the surface area heuristic
+		SAH_BINS = 16,
+		/// depth from which nodes are split at the median, so the query stack is bounded
+		MEDIAN_DEPTH = 48,
+		/// maximum depth of the hierarchy: median splits below MEDIAN_DEPTH halve the node
+		MAX_DEPTH = MEDIAN_DEPTH + 32
+	};
+
+	/// node of the hierarchy: an inner node (count 0) has its children at first and first + 1, a
+	/// leaf holds the triangles mOrder[first, first + count)
+	struct Node
+	{
+		T min[3];
+		T max[3];
+		unsigned first;
+		unsigned count;
+	};
+
+	/// bin of the surface area heuristic
+	struct Bin
+	{
+		T min[3];
+		T max[3];
+		unsigned count;
+	};
+
+	static void ResetBox(T* boxMin, T* boxMax)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boxMin[axis] = static_cast<T>(1e30);
+			boxMax[axis] = static_cast<T>(-1e30);
+		}
+	}
+
+	static void GrowBox(T* boxMin, T* boxMax, const T* addMin, const T* addMax)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boxMin[axis] = addMin[axis] < boxMin[axis] ? addMin[axis] : boxMin[axis];
+			boxMax[axis] = addMax[axis] > boxMax[axis] ? addMax[axis] : boxMax[axis];
+		}
+	}
+
+	static T HalfArea(const T* boxMin, const T* boxMax)
+	{
+		const T dx = boxMax[0] - boxMin[0];
+		const T dy = boxMax[1] - boxMin[1];
+		const T dz = boxMax[2] - boxMin[2];
+		return dx < 0 ? 0 : dx * dy + dy * dz + dz * dx;
+	}
+
+	/// triangle while building: bounding box, centroid and index
+	struct BuildItem
+	{
+		T min[3];
+		T max[3];
+		T centroid[3];
+		unsigned index;
+	};
+
+	/// compares items by one centroid coordinate
+	struct CentroidLess
+	{
+		explicit CentroidLess(int axis): mAxis(axis) {}
+		bool operator()(const BuildItem& first, const BuildItem& second) const
+		{
+			return first.centroid[mAxis] < second.centroid[mAxis];
+		}
+		int mAxis;
+	};
+
+	void BuildNode(size_t szNode, std::vector<BuildItem>& items, unsigned first, unsigned last, int depth)
+	{
+		// bounds of the triangles and of their centroids
+		T nodeMin[3], nodeMax[3], centroidMin[3], centroidMax[3];
+		ResetBox(nodeMin, nodeMax);
+		ResetBox(centroidMin, centroidMax);
+		for (unsigned i = first; i < last; ++i)
+		{
+			GrowBox(nodeMin, nodeMax, items[i].min, items[i].max);
+			GrowBox(centroidMin, centroidMax, items[i].centroid, items[i].centroid);
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			mNodes[szNode].min[axis] = nodeMin[axis];
+			mNodes[szNode].max[axis] = nodeMax[axis];
+		}
+
+		const unsigned count = last - first;
+		mNodes[szNode].first = first;
+		mNodes[szNode].count = count;
+		if (count <= MAX_LEAF_SIZE)
+			return;
+
+		// bin the centroids along all axes in one pass
+		T scale[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const T extent = centroidMax[axis] - centroidMin[axis];
+			scale[axis] = extent > 0 ? static_cast<T>(SAH_BINS) / extent : 0;
+		}
+		Bin bins[3][SAH_BINS];
+		if (depth < MEDIAN_DEPTH)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (int bin = 0; bin < SAH_BINS; ++bin)
+				{
+					ResetBox(bins[axis][bin].min, bins[axis][bin].max);
+					bins[axis][bin].count = 0;
+				}
+			}
+			for (unsigned i = first; i < last; ++i)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const int bin = BinOf(items[i], axis, centroidMin, scale);
+					GrowBox(bins[axis][bin].min, bins[axis][bin].max, items[i].min, items[i].max);
+					++bins[axis][bin].count;
+				}
+			}
+		}
+
+		// best split over all axes, cost in half areas times triangles
+		int bestAxis = -1;
+		int bestBin = 0;
+		T bestCost = HalfArea(nodeMin, nodeMax) * static_cast<T>(count);
+		for (int axis = 0; axis < 3 && depth < MEDIAN_DEPTH; ++axis)
+		{
+			if (!(scale[axis] > 0))
+				continue;
+
+			// areas and counts left of every split, then sweep from the right
+			T leftArea[SAH_BINS - 1];
+			unsigned leftCount[SAH_BINS - 1];
+			T sweepMin[3], sweepMax[3];
+			ResetBox(sweepMin, sweepMax);
+			unsigned sweepCount = 0;
+			for (int bin = 0; bin < SAH_BINS - 1; ++bin)
+			{
+				GrowBox(sweepMin, sweepMax, bins[axis][bin].min, bins[axis][bin].max);
+				sweepCount += bins[axis][bin].count;
+				leftArea[bin] = HalfArea(sweepMin, sweepMax);
+				leftCount[bin] = sweepCount;
+			}
+			ResetBox(sweepMin, sweepMax);
+			sweepCount = 0;
+			for (int bin = SAH_BINS - 1; bin > 0; --bin)
+			{
+				GrowBox(sweepMin, sweepMax, bins[axis][bin].min, bins[axis][bin].max);
+				sweepCount += bins[axis][bin].count;
+				if (leftCount[bin - 1] == 0 || sweepCount == 0)
+					continue;
+				const T cost = leftArea[bin - 1] * static_cast<T>(leftCount[bin - 1]) +
+					HalfArea(sweepMin, sweepMax) * static_cast<T>(sweepCount);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		unsigned middle = first;
+		if (bestAxis >= 0)
+		{
+			for (unsigned i = first; i < last; ++i)
+			{
+				if (BinOf(items[i], bestAxis, centroidMin, scale) < bestBin)
+					std::swap(items[i], items[middle++]);
+			}
+		}
+		if (middle == first || middle == last)
+		{
+			// too deep, no split pays off or all centroids in one bin: split at the median of the
+			// widest axis, a leaf never holds more than MAX_LEAF_SIZE triangles
+			int axis = 0;
+			for (int other = 1; other < 3; ++other)
+			{
+				if (centroidMax[other] - centroidMin[other] > centroidMax[axis] - centroidMin[axis])
+					axis = other;
+			}
+			middle = first + count / 2;
+			std::nth_element(
+				items.begin() + first, items.begin() + middle, items.begin() + last, CentroidLess(axis));
+		}
+
+		const unsigned children = (unsigned)mNodes.size();
+		mNodes.push_back(Node());
+		mNodes.push_back(Node());
+		mNodes[szNode].first = children;
+		mNodes[szNode].count = 0;
+		BuildNode(children, items, first, middle, depth + 1);
+		BuildNode(children + 1, items, middle, last, depth + 1);
+	}
+
+	static int BinOf(const BuildItem& item, int axis, const T* centroidMin, const T* scale)
+	{
+		const int bin = (int)((item.centroid[axis] - centroidMin[axis]) * scale[axis]);
+		return bin < SAH_BINS - 1 ? bin : SAH_BINS - 1;
+	}
+
+	std::vector<Node> mNodes;
+	/// triangle indices in leaf order
+	std::vector<unsigned> mOrder;
+	/// triangle bounding boxes in leaf order, one array per axis
+	std::vector<T> mLeafMin[3];
+	std::vector<T> mLeafMax[3];
+};
+}  // namespace cadcam
+#endif  //	MW_MWTRIANGLEBVH_HPP_
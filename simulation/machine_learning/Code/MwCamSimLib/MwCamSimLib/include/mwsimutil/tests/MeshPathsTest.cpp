@@ -0,0 +1,449 @@
+// Regression test of the fast mesh paths against the code they replace:
+//   mwContainerMesh::RemoveDuplicates       - RemoveDuplicatesSlow
+//   mwContainerMesh::SetTrianglesRadixSort  - SetTriangles
+//   mwTMeshVNorm::MakeNeighborhood          - FindNeighbor, for mesh copies and SetTriangles
+//   mwTriangleBvh::CollectAxisLine          - a scan of all triangle boxes
+//   mwTSTLTranslator::ReadSTLBinaryMapped   - the buffered ReadSTL
+// Build it with the include folders and libraries of the DLL, e.g.
+//   cl /EHsc /std:c++17 /I.. /I..\.. MeshPathsTest.cpp ..\..\..\lib\mwsimutil.lib
+// It prints one line per check and returns the number of failed checks.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the neighborhood is built by private helpers, the reference build calls them one by one
+#define private public
+#define protected public
+#include "mwMeshVNorm.hpp"
+#include "mwSTLTranslator.hpp"
+#include "mwTriangleBvh.hpp"
+#undef private
+#undef protected
+
+typedef cadcam::mwContainerMesh<float> ContainerMesh;
+typedef cadcam::mwTMesh<float> Mesh;
+typedef cadcam::mwTMeshVNorm<float> VNormMesh;
+typedef cadcam::mwTPoint3d<float> Point;
+
+static int num_failed = 0;
+
+//@brief: print the result of a check and count it
+//@param: name: what was compared
+//@param: passed: result of the comparison
+//@ret: void
+static void report(const std::string& name, bool passed)
+{
+	if (passed)
+		std::cout << "[\033[1;32mOK\033[0m]  " << name << std::endl;
+	else
+		std::cout << "[\033[1;31mFAIL\033[0m]  " << name << std::endl;
+	num_failed += passed ? 0 : 1;
+}
+
+//@brief: compare the points and triangles of two meshes
+//@param: a, b: the meshes
+//@ret: true if the points and the point indices of every triangle are equal
+static bool same_mesh(const ContainerMesh& a, const ContainerMesh& b)
+{
+	if (a.GetPoints().size() != b.GetPoints().size() || a.GetTriangles().size() != b.GetTriangles().size())
+		return false;
+	for (size_t i = 0; i < a.GetPoints().size(); ++i)
+	{
+		if (a.GetPoints()[i] != b.GetPoints()[i])
+			return false;
+	}
+	for (size_t i = 0; i < a.GetTriangles().size(); ++i)
+	{
+		size_t a1, a2, a3, b1, b2, b3;
+		a.GetTriangles()[i].GetIndices(a1, a2, a3);
+		b.GetTriangles()[i].GetIndices(b1, b2, b3);
+		if (a1 != b1 || a2 != b2 || a3 != b3)
+			return false;
+	}
+	return true;
+}
+
+//@brief: point on a torus with a ring of sharper edges, u and v wrap around
+//@param: u, v: grid position
+//@param: nu, nv: grid size
+//@ret: the point
+static Point torus_point(int u, int v, int nu, int nv)
+{
+	const double a = 2 * mathdef::MW_PI * (u % nu) / nu;
+	const double b = 2 * mathdef::MW_PI * (v % nv) / nv;
+	const double r = 10 + (v % 6 == 0 ? 4 : 3) * std::cos(b);
+	return Point((float)(r * std::cos(a)), (float)(r * std::sin(a)), (float)(3 * std::sin(b)));
+}
+
+//@brief: triangle soup of a torus
+//@param: open: only half of the tube, the mesh has a border
+//@param: flipped: some triangles are oriented inwards
+//@param: two_bodies: a second torus next to the first one
+//@ret: the triangles, three points each
+static Mesh::TriangleVector torus(bool open, bool flipped, bool two_bodies)
+{
+	const int nu = 40, nv = 24;
+	const Point offset(40, 0, 5);
+	Mesh::TriangleVector triangles;
+	for (int u = 0; u < nu; ++u)
+	{
+		for (int v = 0; v < (open ? nv / 2 : nv); ++v)
+		{
+			const Point a = torus_point(u, v, nu, nv), b = torus_point(u + 1, v, nu, nv);
+			const Point c = torus_point(u + 1, v + 1, nu, nv), d = torus_point(u, v + 1, nu, nv);
+			const Point n1 = (b - a) % (c - a), n2 = (c - a) % (d - a);
+			if (flipped && (u * 7 + v * 3) % 5 == 0)
+				triangles.AddTriangle(a, c, b, -n1);
+			else
+				triangles.AddTriangle(a, b, c, n1);
+			triangles.AddTriangle(a, c, d, n2);
+			if (two_bodies)
+			{
+				triangles.AddTriangle(a + offset, b + offset, c + offset, n1);
+				triangles.AddTriangle(a + offset, c + offset, d + offset, n2);
+			}
+		}
+	}
+	return triangles;
+}
+
+//@brief: welded cone, its apex and base center are shared by many triangles. every other base
+//        triangle uses copies of the ring points shifted by less than the point tolerance, so
+//        some sides only match with PointsCloseEnough
+//@param: n: number of triangles around the apex
+//@param: points: receives the points
+//@param: triangles: receives the triangles
+//@ret: void
+static void cone(int n, Mesh::pointArray& points, Mesh::TriangleArray& triangles)
+{
+	points.clear();
+	triangles.clear();
+	points.push_back(Point(0, 0, 10));
+	points.push_back(Point(0, 0, 0));
+	for (int k = 0; k < n; ++k)
+	{
+		const double angle = 2 * mathdef::MW_PI * k / n;
+		const Point ring((float)(5 * std::cos(angle)), (float)(5 * std::sin(angle)), 0);
+		points.push_back(ring);
+		points.push_back(ring + Point(0, 0, (float)(1e-13 * (1 + k % 3))));
+	}
+	for (int k = 0; k < n; ++k)
+	{
+		const size_t ring1 = 2 + 2 * k, ring2 = 2 + 2 * ((k + 1) % n);
+		const Point apex_normal = (points[ring1] - points[0]) % (points[ring2] - points[0]);
+		const Point base_normal = (points[ring2 + 1] - points[1]) % (points[ring1 + 1] - points[1]);
+		triangles.push_back(Mesh::Triangle(0, ring1, ring2, apex_normal));
+		const size_t shift = k % 2;
+		triangles.push_back(Mesh::Triangle(1, ring2 + shift, ring1 + shift, base_normal));
+	}
+}
+
+//@brief: the same triangles in another order
+//@param: triangles: the triangle soup
+//@ret: the triangles, every 7919th one after the other
+static Mesh::TriangleVector shuffled(const Mesh::TriangleVector& triangles)
+{
+	Mesh::TriangleVector result;
+	const size_t num_triangles = triangles.mTriangles->size();
+	for (size_t k = 0; k < num_triangles; ++k)
+	{
+		const size_t i = (k * 7919) % num_triangles;
+		result.AddTriangle((*triangles.mVertex)[3 * i], (*triangles.mVertex)[3 * i + 1],
+			(*triangles.mVertex)[3 * i + 2], (*triangles.mTriangles)[i].GetNormalVector());
+	}
+	return result;
+}
+
+//@brief: neighbors of the triangles the way MakeNeighborhood found them before the edge adjacency
+//@param: mesh: mesh with the filled mPointsTInd
+//@param: neighbors: receives the neighbors of every triangle
+//@ret: void
+static void find_neighborhood(VNormMesh& mesh, VNormMesh::TriNeighborsArray& neighbors)
+{
+	neighbors.clear();
+	for (size_t i = 0; i < mesh.mTriangles->size(); ++i)
+	{
+		const VNormMesh::Triangle& triangle = (*mesh.mTriangles)[i];
+		const size_t points[3] = {
+			triangle.GetFirstPointIndex(), triangle.GetSecondPointIndex(), triangle.GetThirdPointIndex()};
+		VNormMesh::TriNeighbors triNeighbors;
+		for (int side = 0; side < 3; ++side)
+		{
+			const size_t a = points[side], b = points[(side + 1) % 3];
+			size_t neighbor = VNormMesh::NO_NEIGHBOR;
+			if (!mesh.PointsCloseEnough(mesh.mPointsTInd[a].GetPoint(), mesh.mPointsTInd[b].GetPoint()))
+			{
+				neighbor = mesh.FindNeighbor(i, a, b);
+				if (neighbor == VNormMesh::NO_NEIGHBOR)
+					neighbor = mesh.FindNeighbor(i, b, a);
+			}
+			triNeighbors.SetNeighborIndex(side, neighbor);
+		}
+		neighbors.push_back(triNeighbors);
+	}
+}
+
+//@brief: the steps of BuildMesh and BuildMeshOrient with the neighbors of find_neighborhood
+//@param: mesh: mesh with the filled mPointsTInd
+//@param: adjust_more_orientations: orient every conex component, like BuildMeshOrient
+//@ret: void
+static void build_reference(VNormMesh& mesh, bool adjust_more_orientations)
+{
+	find_neighborhood(mesh, mesh.mTriNeighbor);
+	if (adjust_more_orientations)
+	{
+		VNormMesh::TriNeighborsArray neighbors = mesh.mTriNeighbor;
+		mesh.AdjustMoreOrientations(neighbors);
+	}
+	else
+	{
+		mesh.AdjustOrientations(mesh.mTriNeighbor);
+	}
+	mesh.AdjustPoints();
+	mesh.CalculateNormals();
+	mesh.mPointsTInd.clear();
+}
+
+//@brief: compare the neighbors, triangles, points and vertex normals of two meshes
+//@param: a, b: the meshes
+//@ret: true if all of them are equal
+static bool same_vnorm_mesh(const VNormMesh& a, const VNormMesh& b)
+{
+	if (!same_mesh(a, b) || a.mTriNeighbor.size() != b.mTriNeighbor.size())
+		return false;
+	for (size_t i = 0; i < a.mTriNeighbor.size(); ++i)
+	{
+		for (int side = 0; side < 3; ++side)
+		{
+			if (a.mTriNeighbor[i].GetNeighborIndex(side) != b.mTriNeighbor[i].GetNeighborIndex(side))
+				return false;
+		}
+	}
+	for (size_t i = 0; i < a.GetNormals().size(); ++i)
+	{
+		if (a.GetNormals()[i] != b.GetNormals()[i])
+			return false;
+	}
+	return true;
+}
+
+//@brief: compare the neighborhood of a mesh copy with the FindNeighbor one
+//@param: name: name of the check
+//@param: source: the copied mesh
+//@param: adjust_more_orientations: orient every conex component
+//@ret: void
+static void check_mesh_copy(const std::string& name, const Mesh& source, bool adjust_more_orientations)
+{
+	const VNormMesh mesh(source, 15.0, adjust_more_orientations);
+
+	// the steps of ConstructMeshCopy
+	VNormMesh reference(measures::mwUnitsFactory::METRIC);
+	reference.m_dAngleLimit = 15.0;
+	reference.mTriangles->assign(source.GetTriangles().begin(), source.GetTriangles().end());
+	reference.ConstructPointTInd(source);
+	reference.RemoveDuplicateTriangles(source);
+	reference.ConstructPointTInd(source);
+	build_reference(reference, adjust_more_orientations);
+	report("mwTMeshVNorm copy of " + name, same_vnorm_mesh(mesh, reference));
+}
+
+//@brief: compare the neighborhood of a mesh set from a triangle soup with the FindNeighbor one
+//@param: name: name of the check
+//@param: triangles: the triangle soup, one point per corner
+//@ret: void
+static void check_set_triangles(const std::string& name, const Mesh::TriangleVector& triangles)
+{
+	VNormMesh mesh(measures::mwUnitsFactory::METRIC);
+	mesh.SetTriangles(triangles);
+
+	// the steps of SetTriangles
+	VNormMesh reference(measures::mwUnitsFactory::METRIC);
+	for (size_t i = 0; i < triangles.mVertex->size(); ++i)
+		reference.mPointsTInd.push_back(VNormMesh::point3dTInd((*triangles.mVertex)[i], i / 3, (int)(i % 3)));
+	reference.mTriangles->assign(triangles.mTriangles->begin(), triangles.mTriangles->end());
+	build_reference(reference, false);
+	report("mwTMeshVNorm SetTriangles of " + name, same_vnorm_mesh(mesh, reference));
+}
+
+//@brief: triangle soup over random grid points, many of them shared
+//@param: num_triangles: number of triangles
+//@param: seed: start of the pseudo random sequence
+//@ret: the triangles, three points each
+static Mesh::TriangleVector random_soup(size_t num_triangles, unsigned seed)
+{
+	std::vector<Point> base;
+	for (size_t i = 0; i < num_triangles / 2 + 1; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		base.push_back(Point((float)(seed % 5000) * 0.01f - 25, (float)((seed >> 8) % 400) * 0.1f, -(float)((seed >> 16) % 300) * 0.1f));
+	}
+	Mesh::TriangleVector triangles;
+	for (size_t i = 0; i < num_triangles; ++i)
+	{
+		size_t corners[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			seed = seed * 1103515245 + 12345;
+			corners[k] = (seed >> 4) % base.size();
+		}
+		triangles.AddTriangle(base[corners[0]], base[corners[1]], base[corners[2]], Point(0, 0, 1));
+	}
+	return triangles;
+}
+
+//@brief: RemoveDuplicates against RemoveDuplicatesSlow on an unwelded soup
+//@ret: void
+static void check_remove_duplicates()
+{
+	const Mesh::TriangleVector triangles = random_soup(3000, 1);
+	ContainerMesh::pointArray points(triangles.mVertex->begin(), triangles.mVertex->end());
+	ContainerMesh::TriangleArray corners;
+	for (size_t i = 0; i < triangles.mTriangles->size(); ++i)
+		corners.push_back(ContainerMesh::Triangle(3 * i, 3 * i + 1, 3 * i + 2, Point(0, 0, 1)));
+
+	ContainerMesh slow(points, corners, measures::mwUnitsFactory::METRIC);
+	ContainerMesh fast(points, corners, measures::mwUnitsFactory::METRIC);
+	ContainerMesh single(points, corners, measures::mwUnitsFactory::METRIC);
+	slow.RemoveDuplicatesSlow();
+	fast.RemoveDuplicates();
+	single.RemoveDuplicates((float)(1e-12 * 1e-12), 1);
+	report("RemoveDuplicates", same_mesh(slow, fast) && same_mesh(slow, single));
+}
+
+//@brief: SetTrianglesRadixSort against SetTriangles, on the radix path and below its size limit
+//@ret: void
+static void check_radix_sort()
+{
+	const size_t sizes[2] = {1000, 40000};
+	for (int i = 0; i < 2; ++i)
+	{
+		const Mesh::TriangleVector triangles = random_soup(sizes[i], 7);
+		ContainerMesh sorted(measures::mwUnitsFactory::METRIC);
+		ContainerMesh radix(measures::mwUnitsFactory::METRIC);
+		ContainerMesh single(measures::mwUnitsFactory::METRIC);
+		sorted.SetTriangles(triangles);
+		radix.SetTrianglesRadixSort(triangles);
+		single.SetTrianglesRadixSort(triangles, 1);
+		report("SetTrianglesRadixSort of " + std::to_string(sizes[i]) + " triangles",
+			same_mesh(sorted, radix) && same_mesh(sorted, single));
+	}
+}
+
+//@brief: CollectAxisLine against a scan of all boxes, also with boxes that can not be split
+//@ret: void
+static void check_triangle_bvh()
+{
+	for (int equal_boxes = 0; equal_boxes < 2; ++equal_boxes)
+	{
+		const size_t num_boxes = 5000;
+		std::vector<float> box_min(3 * num_boxes), box_max(3 * num_boxes);
+		unsigned seed = 3;
+		for (size_t i = 0; i < 3 * num_boxes; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			box_min[i] = equal_boxes ? 10.f : (float)((seed >> 8) % 10000) * 0.01f;
+			box_max[i] = equal_boxes ? 90.f : box_min[i] + (float)(seed % 20) * 0.01f;
+		}
+		cadcam::mwTriangleBvh<float> bvh;
+		bvh.Build(box_min, box_max);
+
+		bool passed = true;
+		std::vector<unsigned> candidates;
+		for (int query = 0; query < 500 && passed; ++query)
+		{
+			float point[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				seed = seed * 1103515245 + 12345;
+				point[axis] = (float)((seed >> 8) % 10000) * 0.01f;
+			}
+			const int axis = query % 3, axis_a = axis == 0 ? 1 : 0, axis_b = axis == 2 ? 1 : 2;
+			bvh.CollectAxisLine(axis, point[0], point[1], point[2], candidates);
+			std::sort(candidates.begin(), candidates.end());
+			std::vector<unsigned> expected;
+			for (size_t i = 0; i < num_boxes; ++i)
+			{
+				if (point[axis_a] >= box_min[3 * i + axis_a] && point[axis_a] <= box_max[3 * i + axis_a]
+					&& point[axis_b] >= box_min[3 * i + axis_b] && point[axis_b] <= box_max[3 * i + axis_b])
+					expected.push_back((unsigned)i);
+			}
+			passed = candidates == expected;
+		}
+		report(equal_boxes ? "mwTriangleBvh of equal boxes" : "mwTriangleBvh", passed);
+	}
+}
+
+//@brief: ReadSTLBinaryMapped against the buffered ReadSTL of the same binary file
+//@ret: void
+static void check_mapped_stl()
+{
+	const char* file_name = "MeshPathsTest.stl";
+	const Mesh::TriangleVector triangles = torus(false, false, true);
+	{
+		std::ofstream file(file_name, std::ios::binary);
+		char header[80] = "MeshPathsTest";
+		const unsigned num_triangles = (unsigned)triangles.mTriangles->size();
+		file.write(header, sizeof(header));
+		file.write(reinterpret_cast<const char*>(&num_triangles), sizeof(num_triangles));
+		for (size_t i = 0; i < num_triangles; ++i)
+		{
+			Point record[4] = {(*triangles.mTriangles)[i].GetNormalVector(), (*triangles.mVertex)[3 * i],
+				(*triangles.mVertex)[3 * i + 1], (*triangles.mVertex)[3 * i + 2]};
+			// a degenerated triangle, both readers skip it
+			if (i % 97 == 0)
+				record[2] = record[1];
+			const unsigned short attribute = 0;
+			for (int k = 0; k < 4; ++k)
+				file.write(reinterpret_cast<const char*>(&record[k][0]), 3 * sizeof(float));
+			file.write(reinterpret_cast<const char*>(&attribute), sizeof(attribute));
+		}
+	}
+
+	const misc::mwFileName stl_file(file_name);
+	Mesh buffered(measures::mwUnitsFactory::METRIC), mapped(measures::mwUnitsFactory::METRIC);
+	cadcam::mwfSTLTranslator::HeaderData buffered_header, mapped_header;
+	cadcam::mwfSTLTranslator::ReadSTL(stl_file, buffered, buffered_header, true);
+	cadcam::mwfSTLTranslator::ReadSTLBinaryMapped(stl_file, mapped, mapped_header);
+	std::remove(file_name);
+
+	bool passed = buffered.GetNumberOfTriangles() == mapped.GetNumberOfTriangles()
+		&& buffered.GetNumberOfPoints() == mapped.GetNumberOfPoints();
+	for (size_t i = 0; passed && i < buffered.GetNumberOfTriangles(); ++i)
+	{
+		passed = buffered.GetTriangleFirstVertexPosition(i) == mapped.GetTriangleFirstVertexPosition(i)
+			&& buffered.GetTriangleSecondVertexPosition(i) == mapped.GetTriangleSecondVertexPosition(i)
+			&& buffered.GetTriangleThirdVertexPosition(i) == mapped.GetTriangleThirdVertexPosition(i)
+			&& buffered.GetTriangleNormalVector(i) == mapped.GetTriangleNormalVector(i);
+	}
+	report("ReadSTLBinaryMapped", passed);
+}
+
+int main()
+{
+	check_remove_duplicates();
+	check_radix_sort();
+
+	const char* torus_names[4] = {"a closed torus", "an open torus", "a flipped torus", "two flipped tori"};
+	for (int i = 0; i < 4; ++i)
+	{
+		const Mesh::TriangleVector triangles = torus(i == 1, i >= 2, i == 3);
+		Mesh source(measures::mwUnitsFactory::METRIC);
+		source.SetTriangles(triangles);
+		check_mesh_copy(torus_names[i], source, i == 3);
+		check_set_triangles(torus_names[i], triangles);
+	}
+	check_set_triangles("a shuffled torus", shuffled(torus(false, false, false)));
+	Mesh::pointArray cone_points;
+	Mesh::TriangleArray cone_triangles;
+	cone(200, cone_points, cone_triangles);
+	check_mesh_copy("a cone", Mesh(cone_points, cone_triangles, measures::mwUnitsFactory::METRIC), false);
+
+	check_triangle_bvh();
+	check_mapped_stl();
+	return num_failed;
+}
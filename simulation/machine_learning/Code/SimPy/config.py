@@ -35,6 +35,12 @@ simtoolpath_filename = 'SimPathData.txt'
 # mw cam simulation result based on simulated cnc data:
 result_sim_filename = 'SimResultData.txt'
 
+# mw cam simulation result in the binary columnar format (read by mwwrapper.read_binary_result):
+result_sim_bin_filename = 'SimResultData.bin'
+
+# format of the mw cam simulation result file, either 'text' or 'binary':
+result_format_mw = 'text'
+
 # generated CAD model based on simulated cnc data:
 mesh_sim_filename = 'SimMeshData.stl'
 
@@ -155,3 +161,53 @@ mwcamlib_path = os.path.join(os.path.dirname(
 
 # cycle time in millisecond in mw cam:
 cycleTime_mw = 10
+
+# merging of collinear sampled moves in mw cam: chord tolerance in mm (0 disables it), maximum merged move length
+# in mm (0 for no limit) and if the results of a merged move are spread back over the sampled points
+chordTolerance_mw = 0.
+maxMoveLength_mw = 0.
+redistributeMerged_mw = True
+
+# fitting of sampled arcs and helices (xy plane) into circular cuts in mw cam: tolerance in mm (0 disables it) and
+# minimum number of sampled moves per circular cut
+arcTolerance_mw = 0.
+arcMinMoves_mw = 4
+
+# air cut culling in mw cam: moves whose tool envelope (plus the margin in mm) stays outside the remaining stock are
+# not cut and report zero engagement. the stock box is recomputed at most every airCutRefresh_mw moves after cutting
+airCutCulling_mw = True
+airCutMargin_mw = 1.
+airCutRefresh_mw = 256
+
+# mesh snapshots in mw cam: every n simulated moves, every removed volume in mm^3 and every wall time in seconds
+# (0 disables a trigger). snapshotQueue_mw 0 writes every snapshot synchronously. a positive size writes them on a
+# background thread and drops new ones while that many are waiting instead of slowing the simulation down
+snapshotMoves_mw = 100
+snapshotVolume_mw = 0.
+snapshotSeconds_mw = 0.
+snapshotQueue_mw = 0
+# every n-th snapshot is a full mesh, the ones between only hold the region swept since the previous snapshot and are
+# listed in snapshots.idx (mwwrapper.reconstruct_snapshot rebuilds them). 0 writes full meshes only
+snapshotKeyframes_mw = 0
+
+# headless progress thumbnails of mw cam, rendered on the cpu into the snapshot folder (<cut_id>.png and progress.png)
+# every n simulated moves and every wall time in seconds (0 disables a trigger), image size in pixels
+thumbnailMoves_mw = 0
+thumbnailSeconds_mw = 0.
+thumbnailSize_mw = (256, 256)
+
+# encoding of the simulated mesh and the snapshots in mw cam: 'binary' or 'ascii'
+stl_format_mw = 'binary'
+
+# checkpoints of mw cam, written to the checkpoint folder next to the snapshots: every n simulated moves and every
+# wall time in seconds (0 disables a trigger). mwCamSim.sim(resume=True) continues from the last checkpoint
+checkpointMoves_mw = 0
+checkpointSeconds_mw = 0.
+
+# hot path statistics of mw cam (per phase latency histograms and counters): if the phases are timed and every how
+# many seconds they are written to stats.json next to the snapshots (0 writes them once the simulation finished)
+statsEnabled_mw = True
+statsDumpSeconds_mw = 0.
+
+# number of parts simulated at the same time by mwCamSim.sim_parallel, 0 for one per core:
+numThreads_mw = 0
@@ -45,7 +45,7 @@ class EvalSim:
         # visualization padding
         self.viewrange = 50
 
-        mwwrapper.init(self.mw_dll)
+        self.ctx = mwwrapper.create_context(self.mw_dll)
         self.simType = simType
 
     def __del__(self):
@@ -103,11 +103,11 @@ class EvalSim:
         :return: None
         """
 
-        mwwrapper.set_precision(self.mw_dll, 1)
+        mwwrapper.set_precision(self.mw_dll, self.ctx, 1)
 
         self.workpiece_pos = bounds
 
-        mwwrapper.set_stock(self.mw_dll,
+        mwwrapper.set_stock(self.mw_dll, self.ctx,
                             self.workpiece_pos["x_init"],
                             self.workpiece_pos["y_init"],
                             self.workpiece_pos["z_init"],
@@ -128,8 +128,8 @@ class EvalSim:
         :return: None
         """
 
-        mwwrapper.set_visualization(self.mw_dll, True)
-        mwwrapper.config(self.mw_dll)
+        mwwrapper.set_visualization(self.mw_dll, self.ctx, True)
+        mwwrapper.config(self.mw_dll, self.ctx)
         f_toolpath = open(self.toolpathfile, 'r')
         f_toolpath.readline()  # skip name row
 
@@ -159,7 +159,7 @@ class EvalSim:
 
         # ToDo: check the tool information before sim start
         # use first tool by default
-        mwwrapper.set_current_tool(self.mw_dll, 0)
+        mwwrapper.set_current_tool(self.mw_dll, self.ctx, 0)
 
         num_lines = sum(1 for _ in open(self.toolpathfile))
         current_line_idx = 1
@@ -173,8 +173,8 @@ class EvalSim:
 
         # move tool out of visualization:
         for tool_id_mw, tool_id_vnck in self.toolset.items():
-            mwwrapper.set_current_tool(self.mw_dll, int(tool_id_mw))
-            mwwrapper.DoCut(self.mw_dll,
+            mwwrapper.set_current_tool(self.mw_dll, self.ctx, int(tool_id_mw))
+            mwwrapper.DoCut(self.mw_dll, self.ctx,
                             0,
                             0,
                             1,
@@ -199,7 +199,7 @@ class EvalSim:
                 z_start = pos_list[3]
                 prev_tool_id_twincat = pos_list[6]
                 new_tool_id_mw = self._find_tool_id(prev_tool_id_twincat)
-                mwwrapper.set_current_tool(self.mw_dll, new_tool_id_mw)
+                mwwrapper.set_current_tool(self.mw_dll, self.ctx, new_tool_id_mw)
                 isstart = True
 
             line = f_toolpath.readline()
@@ -219,7 +219,7 @@ class EvalSim:
                 if curr_tool_id_twincat != prev_tool_id_twincat:
                         if self.simType == 'vnck':
                             # move out current tool
-                            mwwrapper.DoCut(self.mw_dll,
+                            mwwrapper.DoCut(self.mw_dll, self.ctx,
                                             x_start,
                                             y_start,
                                             z_start,
@@ -235,10 +235,10 @@ class EvalSim:
                                             False)
 
                         new_tool_id_mw = self._find_tool_id(curr_tool_id_twincat)
-                        mwwrapper.set_current_tool(self.mw_dll, new_tool_id_mw)
+                        mwwrapper.set_current_tool(self.mw_dll, self.ctx, new_tool_id_mw)
                         curr_tool_id = str(new_tool_id_mw)
 
-                mwwrapper.DoCut(self.mw_dll,
+                mwwrapper.DoCut(self.mw_dll, self.ctx,
                                 x_start,
                                 y_start,
                                 z_start,
@@ -255,7 +255,7 @@ class EvalSim:
 
                 if self.cut_id % 10 == 0:
                     # show the animation
-                    mwwrapper.visualization(self.mw_dll, True, self.viewrange)
+                    mwwrapper.visualization(self.mw_dll, self.ctx, True, self.viewrange)
 
                     # show the live updated graph
                     if len(plt.gca().lines):
@@ -283,7 +283,7 @@ class EvalSim:
                 self.cut_id += 1
 
         f_toolpath.close()
-        mwwrapper.window_close(self.mw_dll)
+        mwwrapper.window_close(self.mw_dll, self.ctx)
         plt.show()
         print(f"[\033[1;32mOK\033[0m]  CAM Simulation running {num_lines}/{num_lines}", end="\n")
 
@@ -303,10 +303,10 @@ class EvalSim:
         if 'cDiameterOut' in kwargs and 'taperangle' in kwargs:
             cDiameterOut = kwargs['cDiameterOut']
             taperangle = kwargs['taperangle']
-            mwwrapper.set_tool_chamfer(self.mw_dll, fDiameter, cDiameterOut, fDiameterTop, fShoulderHeight, fHeight, taperangle, self.tool_id)
+            mwwrapper.set_tool_chamfer(self.mw_dll, self.ctx, fDiameter, cDiameterOut, fDiameterTop, fShoulderHeight, fHeight, taperangle, self.tool_id)
             self.toolset[str(self.tool_id)] = (fDiameter, fHeight, machine_tool_id, cDiameterOut, taperangle)
         else:
-            mwwrapper.set_tool(self.mw_dll, fDiameter, fDiameterTop, fShoulderHeight, fHeight, self.tool_id)
+            mwwrapper.set_tool(self.mw_dll, self.ctx, fDiameter, fDiameterTop, fShoulderHeight, fHeight, self.tool_id)
             self.toolset[str(self.tool_id)] = (fDiameter, fHeight, machine_tool_id)
 
         self.tool_id += 1
@@ -1,6 +1,11 @@
 import os.path
 
-from .config import mwcamlib_path, data_rootpath, toolpath_filename, simtoolpath_filename, result_real_filename, result_sim_filename, mesh_sim_filename, mesh_real_filename, ToolDict, precision_default, cycleTime_mw
+from .config import mwcamlib_path, data_rootpath, toolpath_filename, simtoolpath_filename, result_real_filename, result_sim_filename, result_sim_bin_filename, result_format_mw, mesh_sim_filename, mesh_real_filename, ToolDict, precision_default, cycleTime_mw, numThreads_mw, \
+    chordTolerance_mw, maxMoveLength_mw, redistributeMerged_mw, arcTolerance_mw, arcMinMoves_mw, \
+    airCutCulling_mw, airCutMargin_mw, airCutRefresh_mw, \
+    snapshotMoves_mw, snapshotVolume_mw, snapshotSeconds_mw, snapshotQueue_mw, snapshotKeyframes_mw, stl_format_mw, \
+    thumbnailMoves_mw, thumbnailSeconds_mw, thumbnailSize_mw, \
+    checkpointMoves_mw, checkpointSeconds_mw, statsEnabled_mw, statsDumpSeconds_mw
 from . import mwwrapper
 import platform
 
@@ -23,6 +28,8 @@ class mwCamSim:
         self.simfile = None
         # file storage path of generated CAD model
         self.stlfile = None
+        # folder of the periodic mesh snapshots
+        self.root = None
         # tool number in mw cam simulation ToDo: for future work, here should be determined whether use tool id or tool number
         self.tool_id = 0
         # simulation step index
@@ -34,7 +41,8 @@ class mwCamSim:
         # visualization padding
         self.viewrange = 100
 
-        mwwrapper.init(self.mw_dll)
+        # every instance drives its own simulation context, so several parts can share one loaded dll
+        self.ctx = mwwrapper.create_context(self.mw_dll)
         self.simType = simType
 
     def __del__(self):
@@ -43,6 +51,7 @@ class mwCamSim:
         :return: None
         """
         # mwwrapper.unloadMwDll(self.mw_dll)
+        mwwrapper.destroy_context(self.mw_dll, self.ctx)
         del (self.mw_dll)
         print("[\033[1;32mOK\033[0m]  Shut down ModuleWork CAM Sim")
 
@@ -64,7 +73,7 @@ class mwCamSim:
             self.toolpathfile = os.path.join(
                 data_rootpath, partname, simtoolpath_filename)
             self.simfile = os.path.join(
-                data_rootpath, partname, result_sim_filename)
+                data_rootpath, partname, result_sim_bin_filename if result_format_mw == 'binary' else result_sim_filename)
             self.stlfile = os.path.join(
                 data_rootpath, partname, mesh_sim_filename)
             self.root = os.path.join(
@@ -72,7 +81,9 @@ class mwCamSim:
             os.makedirs(self.root, exist_ok=True)
 
         # need to encode in byte string
-        mwwrapper.load_file(self.mw_dll, self.simfile.encode())
+        result_format = mwwrapper.RESULT_FORMAT_BINARY if self.simType == 'vnck' and result_format_mw == 'binary' \
+            else mwwrapper.RESULT_FORMAT_TEXT
+        mwwrapper.load_file(self.mw_dll, self.ctx, self.simfile.encode(), result_format)
 
     def load_toolset(self):
         """
@@ -90,7 +101,7 @@ class mwCamSim:
                 fid = int(key)
 
                 mwwrapper.set_tool_endmill(
-                    self.mw_dll, self.tool_id, diameter, flute_length, shoulder_length)
+                    self.mw_dll, self.ctx, self.tool_id, diameter, flute_length, shoulder_length)
                 self.toolset[str(self.tool_id)] = (diameter, flute_length, fid)
 
             elif value['type'] == 'face_mill':
@@ -104,7 +115,7 @@ class mwCamSim:
                 taper_angle = value['taper_ang']
                 fid = int(key)
 
-                mwwrapper.set_tool_facemill(self.mw_dll, self.tool_id, diameter, flute_length,
+                mwwrapper.set_tool_facemill(self.mw_dll, self.ctx, self.tool_id, diameter, flute_length,
                                             shoulder_length, corner_radius, outside_diameter, taper_angle)
                 self.toolset[str(self.tool_id)] = (diameter, flute_length, fid)
 
@@ -118,7 +129,7 @@ class mwCamSim:
                 taper_angle = value['taper_ang']
                 outside_diameter = value['outside_dia']
                 fid = int(key)
-                mwwrapper.set_tool_chamfer(self.mw_dll, self.tool_id, diameter, flute_length,
+                mwwrapper.set_tool_chamfer(self.mw_dll, self.ctx, self.tool_id, diameter, flute_length,
                                            shoulder_length, corner_radius, taper_angle, outside_diameter)
                 self.toolset[str(self.tool_id)] = (diameter, flute_length, fid)
 
@@ -131,7 +142,7 @@ class mwCamSim:
                 fid = int(key)
 
                 mwwrapper.set_tool_drillmill(
-                    self.mw_dll, self.tool_id, diameter, flute_length, shoulder_length, tip_angle)
+                    self.mw_dll, self.ctx, self.tool_id, diameter, flute_length, shoulder_length, tip_angle)
                 self.toolset[str(self.tool_id)] = (diameter, flute_length, fid)
 
             elif value['type'] == 'ball_mill':
@@ -142,7 +153,7 @@ class mwCamSim:
                 fid = int(key)
 
                 mwwrapper.set_tool_ballmill(
-                    self.mw_dll, self.tool_id, diameter, flute_length, shoulder_length)
+                    self.mw_dll, self.ctx, self.tool_id, diameter, flute_length, shoulder_length)
                 self.toolset[str(self.tool_id)] = (diameter, flute_length, fid)
 
             elif value['type'] == 'barrel_mill':
@@ -155,11 +166,13 @@ class mwCamSim:
                 profile_radius = value['profile_rad']
                 fid = int(key)
 
-                mwwrapper.set_tool_barrelmill(self.mw_dll, self.tool_id, upper_diameter,
+                mwwrapper.set_tool_barrelmill(self.mw_dll, self.ctx, self.tool_id, upper_diameter,
                                               max_diameter, flute_length, shoulder_length, corner_radius, profile_radius)
                 self.toolset[str(self.tool_id)] = (
                     max_diameter, flute_length, fid)
 
+            if str(self.tool_id) in self.toolset:
+                mwwrapper.set_tool_number(self.mw_dll, self.ctx, self.tool_id, self.toolset[str(self.tool_id)][2])
             self.tool_id += 1
 
     def set_stock(self, bounds):
@@ -169,11 +182,11 @@ class mwCamSim:
         :return: None
         """
 
-        mwwrapper.set_precision(self.mw_dll, precision_default)
+        mwwrapper.set_precision(self.mw_dll, self.ctx, precision_default)
 
         self.workpiece_pos = bounds
 
-        mwwrapper.set_stock(self.mw_dll,
+        mwwrapper.set_stock(self.mw_dll, self.ctx,
                             self.workpiece_pos["x_init"],
                             self.workpiece_pos["y_init"],
                             self.workpiece_pos["z_init"],
@@ -187,120 +200,100 @@ class mwCamSim:
                               self.workpiece_pos["y_init"],
                               self.workpiece_pos["z_end"] - self.workpiece_pos["z_init"])
 
-    def sim(self, visualmode, writetrace):
+    def sim(self, visualmode, writetrace, resume=False):
         """
 
         :param visualmode: boolean, if pop up animation window
         :param writetrace: boolean, if record the simulation result
+        :param resume: boolean, continue from the last checkpoint of the part if there is one
         :return: None
         """
 
-        mwwrapper.set_visualization(self.mw_dll, visualmode)
-        mwwrapper.config(self.mw_dll)
-        f_toolpath = open(self.toolpathfile, 'r')
-        f_toolpath.readline()  # skip name row
-
-        x_start = None
-        y_start = None
-        z_start = None
-
-        # use first tool by default
-        mwwrapper.set_current_tool(self.mw_dll, 0)
-        # calculate hom many lines in tool path file
-        num_lines = sum(1 for _ in open(self.toolpathfile))
-        current_line_idx = 1
-        print(f"[]  CAM Simulation running {0}/{num_lines}", end="\r")
-        isstart = False
-        curr_tool_id_twincat = 0
-        prev_tool_id_twincat = 0
-        curr_tool_id = 0
-        block_nr = 0
-
-        while True:
-            if self.cut_id == 1 and not isstart:
-                line_start = f_toolpath.readline()
-                pos_list = list(map(float, line_start.strip().split(' ')))
-                x_start = pos_list[1]
-                y_start = pos_list[2]
-                z_start = pos_list[3]
-                prev_tool_id_twincat = pos_list[6]
-                new_tool_id_mw = self._find_tool_id(prev_tool_id_twincat)
-                mwwrapper.set_current_tool(self.mw_dll, new_tool_id_mw)
-                isstart = True
-
-            line = f_toolpath.readline()
-            current_line_idx += 1
-            if not line:
-                break
-
-            if current_line_idx % cycleTime_mw == 0 or current_line_idx == num_lines-1:
-                pos_list = list(map(float, line.strip().split(' ')))
-                timestamp = pos_list[0]
-                x_end = pos_list[1]
-                y_end = pos_list[2]
-                z_end = pos_list[3]
-                S1Actrev = pos_list[4]
-                Actfeed = pos_list[5]
-                curr_tool_id_twincat = pos_list[6]
-                if self.simType == 'vnck':
-                    block_nr = pos_list[7]
-
-                # check if tool is changed
-                if curr_tool_id_twincat != prev_tool_id_twincat:
-                    new_tool_id_mw = self._find_tool_id(curr_tool_id_twincat)
-                    mwwrapper.set_current_tool(self.mw_dll, new_tool_id_mw)
-                    curr_tool_id = str(new_tool_id_mw)
-
-                mwwrapper.DoCut(self.mw_dll,
-                                x_start,
-                                y_start,
-                                z_start,
-                                x_end,
-                                y_end,
-                                z_end,
-                                S1Actrev,
-                                Actfeed,
-                                int(timestamp),
-                                int(curr_tool_id_twincat),
-                                self.cut_id,
-                                True,
-                                writetrace,
-                                self.root.encode())
-                if writetrace:
-                    mwwrapper.engagement_analysis(self.mw_dll)
-
-                if visualmode:
-                    # for acceleration, only 1/10 steps will be updated in frame
-                    if self.cut_id % 10 == 0:
-                        mwwrapper.visualization(
-                            self.mw_dll, True, self.viewrange)
-                    else:
-                        mwwrapper.visualization(
-                            self.mw_dll, False, self.viewrange)
-                print(f"[]  CAM Simulation running {current_line_idx}/{num_lines}, current position: {x_end}, {y_end}, "
-                      f"{z_end}, current tool: (diameter, length, id): {self.toolset.get(str(curr_tool_id))} "
-                      f"nc block: {block_nr}", end="\r")
-                x_start = x_end
-                y_start = y_end
-                z_start = z_end
-                prev_tool_id_twincat = curr_tool_id_twincat
-
-                self.cut_id += 1
-
-        f_toolpath.close()
-        mwwrapper.window_close(self.mw_dll)
+        self.prepare_sim(visualmode)
+
+        def progress(bytes_read, bytes_total, cut_id, x, y, z, tool_number, block_nr):
+            if visualmode:
+                mwwrapper.visualization(self.mw_dll, self.ctx, True, self.viewrange)
+            print(f"[]  CAM Simulation running {100. * bytes_read / max(bytes_total, 1):.1f}%, current position: {x}, {y}, "
+                  f"{z}, current tool: (diameter, length, id): {self.toolset.get(str(self._find_tool_id(tool_number)))} "
+                  f"nc block: {block_nr}", end="\r")
+
+        # the tool path is parsed, decimated and simulated in the dll, only the progress comes back
+        progress_c = mwwrapper.set_progress_callback(self.mw_dll, self.ctx, progress)
+        print("[]  CAM Simulation running 0.0%", end="\r")
+        checkpoint_dir = self._checkpoint_dir()
+        if resume and os.path.isfile(os.path.join(checkpoint_dir, "checkpoint.bin")):
+            num_moves = mwwrapper.resume_from_checkpoint(self.mw_dll, self.ctx, checkpoint_dir.encode())
+        else:
+            num_moves = mwwrapper.simulate_toolpath(self.mw_dll, self.ctx, self.toolpathfile.encode(), cycleTime_mw,
+                                                    writetrace, (self.root or os.path.dirname(self.stlfile)).encode())
+        mwwrapper.set_progress_callback(self.mw_dll, self.ctx, None)
+        del progress_c
+        if num_moves < 0:
+            raise RuntimeError(f"CAM Simulation of {self.toolpathfile} failed")
+        self.cut_id += num_moves
+
+        mwwrapper.close_file(self.mw_dll, self.ctx)
+        mwwrapper.window_close(self.mw_dll, self.ctx)
 
         print(
-            f"[\033[1;32mOK\033[0m]  CAM Simulation running {num_lines}/{num_lines}", end="\n")
+            f"[\033[1;32mOK\033[0m]  CAM Simulation running 100.0%, {num_moves} moves, "
+            f"{mwwrapper.get_air_cut_count(self.mw_dll, self.ctx)} air moves skipped", end="\n")
+        self._print_stats()
         print(
             f"[\033[1;32mOK\033[0m]  Save the simulation result file in \033[1;34m{self.simfile}\033[0m")
         # need to encode in byte string
-        mwwrapper.export_mesh(self.mw_dll, self.stlfile.encode())
+        mwwrapper.export_mesh(self.mw_dll, self.ctx, self.stlfile.encode())
         print(
             f"[\033[1;32mOK\033[0m]  Save the simulated mesh file in \033[1;34m{self.stlfile}\033[0m")
 
+    def prepare_sim(self, visualmode):
+        """
+        configure the simulation without running it, e.g. before handing the context to sim_parallel
+        :param visualmode: boolean, if pop up animation window
+        :return: None
+        """
+        mwwrapper.set_visualization(self.mw_dll, self.ctx, visualmode)
+        mwwrapper.set_move_coalescing(self.mw_dll, self.ctx, chordTolerance_mw, maxMoveLength_mw, redistributeMerged_mw)
+        mwwrapper.set_arc_fitting(self.mw_dll, self.ctx, arcTolerance_mw, arcMinMoves_mw)
+        mwwrapper.set_air_cut_culling(self.mw_dll, self.ctx, airCutCulling_mw, airCutMargin_mw, airCutRefresh_mw)
+        mwwrapper.set_feature_time_step(self.mw_dll, self.ctx, cycleTime_mw / 1000.)
+        mwwrapper.set_snapshot_policy(self.mw_dll, self.ctx, snapshotMoves_mw, snapshotVolume_mw, snapshotSeconds_mw,
+                                      snapshotQueue_mw, snapshotKeyframes_mw)
+        mwwrapper.set_thumbnail_policy(self.mw_dll, self.ctx, thumbnailMoves_mw, thumbnailSeconds_mw, *thumbnailSize_mw)
+        mwwrapper.set_stl_format(self.mw_dll, self.ctx, mwwrapper.STL_FORMAT_ASCII if stl_format_mw == 'ascii'
+                                 else mwwrapper.STL_FORMAT_BINARY)
+        if checkpointMoves_mw > 0 or checkpointSeconds_mw > 0:
+            os.makedirs(self._checkpoint_dir(), exist_ok=True)
+            mwwrapper.set_checkpoint_policy(self.mw_dll, self.ctx, self._checkpoint_dir().encode(), checkpointMoves_mw,
+                                            checkpointSeconds_mw)
+        mwwrapper.set_stats(self.mw_dll, self.ctx, statsEnabled_mw,
+                            os.path.join(self.root or os.path.dirname(self.stlfile), "stats.json").encode(),
+                            statsDumpSeconds_mw)
+        mwwrapper.config(self.mw_dll, self.ctx)
+
     # private functions:
 
+    def _print_stats(self):
+        """
+        print the time spent per phase of the hot path, to tell if a slow part is bound by the kernel or the io
+        :return: None
+        """
+        stats = mwwrapper.get_stats(self.mw_dll, self.ctx)
+        for name, phase in stats["phases"].items():
+            if phase["count"]:
+                print(f"*  {name}: {phase['total_ns'] / 1e9:.2f} s in {phase['count']} passes, "
+                      f"p50 {phase['p50_ns'] / 1e3:.1f} us, p99 {phase['p99_ns'] / 1e3:.1f} us, "
+                      f"max {phase['max_ns'] / 1e3:.1f} us")
+        print(f"*  {stats['counters']}")
+
+    def _checkpoint_dir(self):
+        """
+        folder of the checkpoints of this part, next to the mesh snapshots
+        :return: str, checkpoint folder
+        """
+        return os.path.join(self.root or os.path.dirname(self.stlfile), "checkpoint")
+
     # def _set_tool(self, fDiameter, fHeight, machine_tool_id, **kwargs):
     #     """
     #     set each tool in simulation environment with give dimension
@@ -340,3 +333,38 @@ class mwCamSim:
 
         raise ValueError(
             "Don't find a tool that fixed the dimension, please check if all the tools are imported in mwcam")
+
+
+def sim_parallel(mwdll, partnames, bounds, simType='vnck', num_threads=numThreads_mw):
+    """
+    simulate several parts at once, every part runs on its own verifier in the shared dll
+    :param mwdll: dll
+    :param partnames: list, folder name of each workpiece
+    :param bounds: dict, stock diagnose point position, either shared by all parts or a dict per part name
+    :param simType: string, simulation type, it should be either 'vnck' or 'real'
+    :param num_threads: int, number of parts simulated at the same time, 0 for one per core
+    :return: int, number of successfully simulated parts
+    """
+    sims = []
+    for partname in partnames:
+        sim = mwCamSim(mwdll, simType)
+        sim.load_file(partname)
+        sim.set_stock(bounds.get(partname, bounds))
+        sim.load_toolset()
+        # the animation window can only be driven from a single thread
+        sim.prepare_sim(False)
+        sims.append(sim)
+
+    num_succeeded = mwwrapper.run_parallel(mwdll,
+                                           [sim.ctx for sim in sims],
+                                           [sim.toolpathfile.encode() for sim in sims],
+                                           [(sim.root or os.path.dirname(sim.stlfile)).encode() for sim in sims],
+                                           [sim.stlfile.encode() for sim in sims],
+                                           cycleTime_mw,
+                                           num_threads)
+    for sim in sims:
+        mwwrapper.close_file(sim.mw_dll, sim.ctx)
+
+    print(f"[\033[1;32mOK\033[0m]  CAM Simulation of {num_succeeded}/{len(sims)} parts finished")
+
+    return num_succeeded
@@ -1,8 +1,122 @@
 """
 MW CAM simulation interface
 """
+import os.path
 import ctypes as ct
 from ctypes import *
+import time
+import numpy as np
+import trimesh
+
+# per-move flags of DoCutBatch, see MwCamSimLib.h
+MOVE_FLAG_CUT = 0x01
+MOVE_FLAG_TRACE = 0x02
+
+# feature file formats of load_file, see EngagementWriter.h
+RESULT_FORMAT_TEXT = 0
+RESULT_FORMAT_BINARY = 1
+
+# mesh file encodings of set_stl_format, see StlWriter.h
+STL_FORMAT_BINARY = 0
+STL_FORMAT_ASCII = 1
+
+# layout of the binary feature file, see EngagementWriter.h
+RESULT_BINARY_MAGIC = 0x5245574d
+RESULT_BINARY_HEADER_SIZE = 64
+RESULT_BINARY_VERSION = 2
+_result_move_fields = [('Timestamp', '<i8'),
+                       ('XCurrPos', '<f4'),
+                       ('YCurrPos', '<f4'),
+                       ('ZCurrPos', '<f4'),
+                       ('S1Actrev', '<f4'),
+                       ('Actfeed', '<f4'),
+                       ('ToolID', '<i4'),
+                       ('Area', '<f4'),
+                       ('Depth', '<f4'),
+                       ('Width', '<f4'),
+                       ('Removal_Volume', '<f4')]
+# the derived feature columns are named like the ones of FeaturePreprocess
+result_record_dtype = np.dtype(_result_move_fields + [('Angle_Mean', '<f4'),
+                                                      ('Angle_Sin', '<f4'),
+                                                      ('Angle_Cos', '<f4'),
+                                                      ('ChipThickness', '<f4'),
+                                                      ('S1ActAccel', '<f4'),
+                                                      ('XCurrVel', '<f4'),
+                                                      ('YCurrVel', '<f4'),
+                                                      ('ZCurrVel', '<f4'),
+                                                      ('XCurrAccel', '<f4'),
+                                                      ('YCurrAccel', '<f4'),
+                                                      ('ZCurrAccel', '<f4'),
+                                                      ('Reserved', '<f4'),
+                                                      ('SegmentEnd', '<u8')])
+# records of files written before the derived features (version 1)
+result_record_v1_dtype = np.dtype(_result_move_fields + [('SegmentEnd', '<u8')])
+
+# raw cutting result record of drain_cutting_results, see CuttingResultRecord in CuttingResults.h
+cutting_result_dtype = np.dtype([('MoveId', '<f4'),
+                                 ('Axis', '<i4'),
+                                 ('X', '<f4'),
+                                 ('Y', '<f4'),
+                                 ('Z', '<f4'),
+                                 ('Length', '<f4'),
+                                 ('Area', '<f4'),
+                                 ('Distribution', '<i4')])
+
+# move record of the shared memory move ring, see MoveRecord in MoveRing.h
+move_record_dtype = np.dtype([('Timestamp', '<i8'),
+                              ('XCurrPos', '<f4'),
+                              ('YCurrPos', '<f4'),
+                              ('ZCurrPos', '<f4'),
+                              ('S1Actrev', '<f4'),
+                              ('Actfeed', '<f4'),
+                              ('ToolID', '<i4'),
+                              ('BlockNr', '<i4'),
+                              ('Flags', '<u4')], align=True)
+
+
+# counters of a move ring, see MoveRingStats in MoveRing.h
+class MoveRingStats(ct.Structure):
+    _fields_ = [('capacity', ct.c_ulonglong),
+                ('written', ct.c_ulonglong),
+                ('read', ct.c_ulonglong),
+                ('overruns', ct.c_ulonglong),
+                ('high_water', ct.c_ulonglong),
+                ('closed', ct.c_int),
+                ('reserved', ct.c_int)]
+
+
+# view of a pinned stock mesh of get_stock_mesh, see MeshBuffer.h
+class MeshView(ct.Structure):
+    _fields_ = [('points', ct.POINTER(ct.c_float)),
+                ('indices', ct.POINTER(ct.c_uint)),
+                ('normals', ct.POINTER(ct.c_float)),
+                ('num_points', ct.c_ulonglong),
+                ('num_triangles', ct.c_ulonglong)]
+
+
+# hot path statistics of get_stats, see SimStats.h
+STATS_PHASE_NAMES = ('frame', 'cut', 'engagement', 'serialize', 'snapshot')
+STATS_COUNTER_NAMES = ('moves', 'cuts', 'air_cuts', 'feature_bytes', 'snapshots')
+
+
+class PhaseStats(ct.Structure):
+    _fields_ = [('count', ct.c_ulonglong),
+                ('total_ns', ct.c_ulonglong),
+                ('max_ns', ct.c_ulonglong),
+                ('p50_ns', ct.c_ulonglong),
+                ('p90_ns', ct.c_ulonglong),
+                ('p99_ns', ct.c_ulonglong),
+                ('p999_ns', ct.c_ulonglong)]
+
+
+class SimStatsRecord(ct.Structure):
+    _fields_ = [('phases', PhaseStats * len(STATS_PHASE_NAMES)),
+                ('counters', ct.c_ulonglong * len(STATS_COUNTER_NAMES))]
+
+
+# progress callback of simulate_toolpath, see SimProgressCallback in MwCamSimLib.h
+progress_callback_type = ct.CFUNCTYPE(None, ct.c_longlong, ct.c_longlong, ct.c_int, ct.c_float, ct.c_float,
+                                      ct.c_float, ct.c_int, ct.c_int)
 
 
 def load(dllfile):
@@ -16,31 +130,168 @@ def load(dllfile):
     return mwdll
 
 
-def init(mwdll):
+def create_context(mwdll):
+    """
+    create an independent mw cam simulation, several contexts can be driven from different threads
+    :param mwdll: dll
+    :return: c_void_p, simulation context handle passed to every other function
+    """
+    mwdll.create_context.restype = ct.c_void_p
+    ctx = mwdll.create_context()
+    if not ctx:
+        raise RuntimeError("Could not create a mw cam simulation context")
+
+    return ct.c_void_p(ctx)
+
+
+def destroy_context(mwdll, ctx):
     """
-    init mw cam simulation
+    release a simulation context and everything it owns
     :param mwdll: dll
+    :param ctx: simulation context handle from create_context
     :return: None
     """
-    mwdll.init()
+    mwdll.destroy_context(ctx)
 
 
-def load_file(mwdll, featurefile):
+def load_file(mwdll, ctx, featurefile, result_format=RESULT_FORMAT_TEXT):
     """
     create result file and add to cam simulation
     :param mwdll: dll
+    :param ctx: simulation context handle from create_context
     :param featurefile: str, simulation result file path
+    :param result_format: int, RESULT_FORMAT_TEXT or RESULT_FORMAT_BINARY
     :return: None
     """
 
     file = ct.c_char_p(featurefile)
-    mwdll.load_file(file)
+    mwdll.load_file(ctx, file, ct.c_int(result_format))
 
 
-def set_stock(mwdll, init_x, init_y, init_z, end_x, end_y, end_z):
+def set_feature_time_step(mwdll, ctx, seconds):
+    """
+    time between two result rows, used for the velocity and acceleration columns of the binary result file
+    :param mwdll: dll
+    :param ctx: simulation context handle from create_context
+    :param seconds: float, row interval in s, the cycle time of the sampled tool path
+    :return: None
+    """
+    mwdll.set_feature_time_step(ctx, ct.c_float(seconds))
+
+
+def close_file(mwdll, ctx):
+    """
+    flush and close the result file
+    :param mwdll: dll
+    :param ctx: simulation context handle from create_context
+    :return: None
+    """
+    mwdll.close_file(ctx)
+
+
+def read_binary_result(featurefile):
+    """
+    map a binary result file written with RESULT_FORMAT_BINARY without copying
+    :param featurefile: str, simulation result file path
+    :return: tuple, (records, segment_ends, angles) numpy arrays. The angles of record i are
+             angles[segment_ends[j-1]:segment_ends[j]] for every segment j in
+             [records['SegmentEnd'][i-1], records['SegmentEnd'][i]). Files of version 2 also contain the derived
+             feature columns (Angle_Mean ... ZCurrAccel)
+    """
+    header = np.fromfile(featurefile, dtype='<u4', count=4)
+    record_dtype = result_record_v1_dtype if header[1] == 1 else result_record_dtype
+    if header[0] != RESULT_BINARY_MAGIC or header[2] != record_dtype.itemsize:
+        raise ValueError(f"{featurefile} is not a binary mw cam result file")
+    count = int(np.fromfile(featurefile, dtype='<u8', count=1, offset=16)[0])
+
+    records = np.memmap(featurefile, dtype=record_dtype, mode='r',
+                        offset=RESULT_BINARY_HEADER_SIZE, shape=(count,))
+    segment_count = int(records['SegmentEnd'][-1]) if count else 0
+    segment_ends = np.memmap(featurefile + '.seg', dtype='<u8', mode='r', shape=(segment_count,)) \
+        if segment_count else np.zeros(0, dtype='<u8')
+    value_count = int(segment_ends[-1]) if segment_count else 0
+    angles = np.memmap(featurefile + '.val', dtype='<f4', mode='r', shape=(value_count,)) \
+        if value_count else np.zeros(0, dtype='<f4')
+
+    return records, segment_ends, angles
+
+
+def binary_result_angle_lists(records, segment_ends, angles):
+    """
+    rebuild the nested engagement angle lists of the text feature file from a binary result
+    :return: list[list[list[float]]], per record the angle lists per tool profile segment
+    """
+    record_ends = records['SegmentEnd'].astype(np.int64)
+    record_begins = np.concatenate(([0], record_ends[:-1]))
+    value_ends = segment_ends.astype(np.int64)
+    value_begins = np.concatenate(([0], value_ends[:-1]))
+
+    return [[angles[value_begins[j]:value_ends[j]].tolist() for j in range(begin, end)]
+            for begin, end in zip(record_begins, record_ends)]
+
+
+def read_snapshot_index(folder):
+    """
+    read the index of the keyframe and delta mesh snapshots, see set_snapshot_policy
+    :param folder: str, snapshot folder
+    :return: list of tuple, (cut_id, is_delta, box_min, box_max) per written snapshot in simulation order
+    """
+    entries = []
+    with open(os.path.join(folder, 'snapshots.idx')) as index:
+        for line in index:
+            values = line.split()
+            if len(values) == 8:
+                entries.append((int(values[0]), values[1] == 'D', np.array(values[2:5], dtype=float),
+                                np.array(values[5:8], dtype=float)))
+    return entries
+
+
+def _clip_outside_box(mesh, box_min, box_max):
+    """
+    cut away the part of a mesh inside an axis aligned box, the cut faces stay open
+    :return: trimesh.Trimesh, part of the mesh outside the box
+    """
+    parts = []
+    inside = mesh
+    for axis in range(3):
+        normal = np.zeros(3)
+        normal[axis] = 1.
+        if len(inside.faces):
+            parts.append(trimesh.intersections.slice_mesh_plane(inside, -normal, box_min))
+        if len(inside.faces):
+            parts.append(trimesh.intersections.slice_mesh_plane(inside, normal, box_max))
+        if len(inside.faces):
+            inside = trimesh.intersections.slice_mesh_plane(inside, normal, box_min)
+        if len(inside.faces):
+            inside = trimesh.intersections.slice_mesh_plane(inside, -normal, box_max)
+    return trimesh.util.concatenate([part for part in parts if len(part.faces)])
+
+
+def reconstruct_snapshot(folder, cut_id):
+    """
+    rebuild the stock mesh of a snapshot step from the last keyframe before it and the following deltas
+    :param folder: str, snapshot folder
+    :param cut_id: int, step index of a written snapshot
+    :return: trimesh.Trimesh, stock mesh after the step
+    """
+    entries = [entry for entry in read_snapshot_index(folder) if entry[0] <= cut_id]
+    keyframes = [i for i, entry in enumerate(entries) if not entry[1]]
+    if not keyframes:
+        raise ValueError(f"{folder} has no keyframe snapshot before step {cut_id}")
+
+    first = keyframes[-1]
+    mesh = trimesh.load_mesh(os.path.join(folder, f"{entries[first][0]}.stl"))
+    for step, _, box_min, box_max in entries[first + 1:]:
+        delta = trimesh.load_mesh(os.path.join(folder, f"{step}_delta.stl"))
+        mesh = trimesh.util.concatenate([_clip_outside_box(mesh, box_min, box_max), delta])
+    return mesh
+
+
+def set_stock(mwdll, ctx, init_x, init_y, init_z, end_x, end_y, end_z):
     """
     create workpiece model
     :param mwdll: dll
+    :param ctx: simulation context handle from create_context
     :param init_x: int, x coordinate of start point in wcs
     :param init_y: int, y coordinate of start point in wcs
     :param init_z: int, z coordinate of start point in wcs
@@ -56,19 +307,19 @@ def set_stock(mwdll, init_x, init_y, init_z, end_x, end_y, end_z):
     end_y_c = ct.c_float(end_y)
     end_z_c = ct.c_float(end_z)
 
-    mwdll.set_stock(init_x_c, init_y_c, init_z_c, end_x_c, end_y_c, end_z_c)
+    mwdll.set_stock(ctx, init_x_c, init_y_c, init_z_c, end_x_c, end_y_c, end_z_c)
 
 
-def set_tool_endmill(mwdll, tool_id, diameter, flute_length, shoulder_length):
+def set_tool_endmill(mwdll, ctx, tool_id, diameter, flute_length, shoulder_length):
     diameter_c = ct.c_float(diameter)
     flute_length_c = ct.c_float(flute_length)
     shoulder_length_c = ct.c_float(shoulder_length)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_endmill(tool_id_c, diameter_c,
+    mwdll.set_tool_endmill(ctx, tool_id_c, diameter_c,
                            flute_length_c, shoulder_length_c)
 
 
-def set_tool_facemill(mwdll, tool_id, diameter, flute_length, shoulder_length, corner_radius, outside_diameter,
+def set_tool_facemill(mwdll, ctx, tool_id, diameter, flute_length, shoulder_length, corner_radius, outside_diameter,
                       taper_angle):
     diameter_c = ct.c_float(diameter)
     flute_length_c = ct.c_float(flute_length)
@@ -77,15 +328,16 @@ def set_tool_facemill(mwdll, tool_id, diameter, flute_length, shoulder_length, c
     outside_diameter_c = ct.c_float(outside_diameter)
     taper_angle_c = ct.c_float(taper_angle)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_facemill(tool_id_c, diameter_c, flute_length_c, shoulder_length_c, corner_radius_c,
+    mwdll.set_tool_facemill(ctx, tool_id_c, diameter_c, flute_length_c, shoulder_length_c, corner_radius_c,
                             outside_diameter_c, taper_angle_c)
 
 
-def set_tool_chamfer(mwdll, tool_id, diameter, flute_length, shoulder_length, corner_radius, taper_angle,
+def set_tool_chamfer(mwdll, ctx, tool_id, diameter, flute_length, shoulder_length, corner_radius, taper_angle,
                      outside_diameter):
     """
     create chamfer tool in mw cam simulation
     :param mwdll: dll
+    :param ctx: simulation context handle from create_context
     :param cDiameter: cutter diameter
     :param cDiameterOut: outside diameter
     :param cDiameterTop: holder diameter
@@ -102,31 +354,31 @@ def set_tool_chamfer(mwdll, tool_id, diameter, flute_length, shoulder_length, co
     taper_angle_c = ct.c_float(taper_angle)
     outside_diameter_c = ct.c_float(outside_diameter)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_chamfer(tool_id_c, diameter_c, flute_length_c, shoulder_length_c, corner_radius_c, taper_angle_c,
+    mwdll.set_tool_chamfer(ctx, tool_id_c, diameter_c, flute_length_c, shoulder_length_c, corner_radius_c, taper_angle_c,
                            outside_diameter_c)
 
 
-def set_tool_drillmill(mwdll, tool_id, diameter, flute_length, shoulder_length, tip_angle):
+def set_tool_drillmill(mwdll, ctx, tool_id, diameter, flute_length, shoulder_length, tip_angle):
     diameter_c = ct.c_float(diameter)
     flute_length_c = ct.c_float(flute_length)
     shoulder_length_c = ct.c_float(shoulder_length)
     tip_angle_c = ct.c_float(tip_angle)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_drillmill(tool_id_c, diameter_c,
+    mwdll.set_tool_drillmill(ctx, tool_id_c, diameter_c,
                              flute_length_c, shoulder_length_c, tip_angle_c)
 
 
-def set_tool_ballmill(mwdll, tool_id, diameter, flute_length, shoulder_length):
+def set_tool_ballmill(mwdll, ctx, tool_id, diameter, flute_length, shoulder_length):
     diameter_c = ct.c_float(diameter)
     shoulder_length_c = ct.c_float(shoulder_length)
     flute_length_c = ct.c_float(flute_length)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_ballmill(tool_id_c, diameter_c,
+    mwdll.set_tool_ballmill(ctx, tool_id_c, diameter_c,
                             flute_length_c, shoulder_length_c)
 
 
 # (self.mw_dll, shaftDiameter,shaftHeight, fluteDiameter,fluteHeight,cornerRadius,profileRadius,self.tool_id)
-def set_tool_barrelmill(mwdll, tool_id, upper_diameter, max_diameter, flute_length, shoulder_length, corner_radius,
+def set_tool_barrelmill(mwdll, ctx, tool_id, upper_diameter, max_diameter, flute_length, shoulder_length, corner_radius,
                         profile_radius):
     upper_diameter_c = ct.c_float(upper_diameter)
     max_diameter_c = ct.c_float(max_diameter)
@@ -135,34 +387,49 @@ def set_tool_barrelmill(mwdll, tool_id, upper_diameter, max_diameter, flute_leng
     corner_radius_c = ct.c_float(corner_radius)
     profile_radius_c = ct.c_float(profile_radius)
     tool_id_c = ct.c_int(tool_id)
-    mwdll.set_tool_barrelmill(tool_id_c, upper_diameter_c, max_diameter_c, flute_length_c, shoulder_length_c,
+    mwdll.set_tool_barrelmill(ctx, tool_id_c, upper_diameter_c, max_diameter_c, flute_length_c, shoulder_length_c,
                               corner_radius_c, profile_radius_c)
 
 
-def set_current_tool(mwdll, tool_id):
+def set_current_tool(mwdll, ctx, tool_id):
     """
     set cutting tool in current simulation step
     :param mwdll: dll
+    :param ctx: simulation context handle from create_context
     :param tool_id: tool id plan to be changed
     :return: None
     """
     tool_idx_c = ct.c_int(tool_id)
-    mwdll.set_current_tool(tool_idx_c)
+    mwdll.set_current_tool(ctx, tool_idx_c)
 
 
-def config(mwdll):
+def set_tool_number(mwdll, ctx, tool_id, nc_tool_number):
+    """
+    register the tool number the nc program uses for a tool of the simulation tool set
+    :param mwdll: dll
+    :param ctx: simulation context handle from create_context
+    :param tool_id: int, tool id in mw cam
+    :param nc_tool_number: int, tool number from nc program
+    :return: None
+    """
+    mwdll.set_tool_number(ctx, ct.c_int(tool_id), ct.c_int(nc_tool_number))
+
+
+def config(mwdll, ctx):
     """
     configure the simulation environment
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :return:
     """
-    mwdll.config()
+    mwdll.config(ctx)
 
 
-def DoCut(mwdll, x_start, y_start, z_start, x_end, y_end, z_end, s1actrev, actfeed, timestamp, tool_id, cut_id, iscut, istrace, path):
+def DoCut(mwdll, ctx, x_start, y_start, z_start, x_end, y_end, z_end, s1actrev, actfeed, timestamp, tool_id, cut_id, iscut, istrace, path):
     """
     execute a single step cutting simulation
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :param x_start: float, x coordinate in start point
     :param y_start: float, y coordinate in start point
     :param z_start: float, z coordinate in start point
@@ -199,72 +466,583 @@ def DoCut(mwdll, x_start, y_start, z_start, x_end, y_end, z_end, s1actrev, actfe
 
     path_c = ct.c_char_p(path)
 
-    mwdll.DoCut(x_start_c, y_start_c, z_start_c, x_end_c, y_end_c, z_end_c,
+    mwdll.DoCut(ctx, x_start_c, y_start_c, z_start_c, x_end_c, y_end_c, z_end_c,
                 s1actrev_c, actfeed_c, timestamp_c, tool_id_c, cut_id_c, iscut_c, istrace_c, path_c)
 
 
-def engagement_analysis(mwdll):
+def DoCutBatch(mwdll, ctx, start, x_end, y_end, z_end, s1actrev, actfeed, timestamp, tool_id, tool_idx, flags, first_cut_id, path):
+    """
+    execute the cutting simulation of a whole slice of moves in a single dll call
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param start: tuple, (x, y, z) start point of the first move
+    :param x_end: array, x coordinate of end point per move
+    :param y_end: array, y coordinate of end point per move
+    :param z_end: array, z coordinate of end point per move
+    :param s1actrev: array, target motor speed per move
+    :param actfeed: array, target feed rate per move
+    :param timestamp: array, timestamp per move
+    :param tool_id: array, tool number from nc program per move
+    :param tool_idx: array, tool id in mw cam per move
+    :param flags: array, combination of MOVE_FLAG_CUT and MOVE_FLAG_TRACE per move
+    :param first_cut_id: int, cutting step index of the first move
+    :param path: bytes, folder of the periodic mesh snapshots
+    :return: dict of numpy arrays with area, depth, width and removal volume per move
+    """
+    x_end = np.ascontiguousarray(x_end, dtype=np.float32)
+    y_end = np.ascontiguousarray(y_end, dtype=np.float32)
+    z_end = np.ascontiguousarray(z_end, dtype=np.float32)
+    s1actrev = np.ascontiguousarray(s1actrev, dtype=np.float32)
+    actfeed = np.ascontiguousarray(actfeed, dtype=np.float32)
+    timestamp = np.ascontiguousarray(timestamp, dtype=np.int64)
+    tool_id = np.ascontiguousarray(tool_id, dtype=np.int32)
+    tool_idx = np.ascontiguousarray(tool_idx, dtype=np.int32)
+    flags = np.ascontiguousarray(flags, dtype=np.uint8)
+    count = len(x_end)
+
+    result = {name: np.zeros(count, dtype=np.float32)
+              for name in ('Area', 'Depth', 'Width', 'Removal_Volume')}
+
+    def ptr(arr, ctype):
+        return arr.ctypes.data_as(ct.POINTER(ctype))
+
+    mwdll.DoCutBatch.restype = ct.c_int
+    simulated = mwdll.DoCutBatch(ctx, ct.c_float(start[0]), ct.c_float(start[1]), ct.c_float(start[2]),
+                                 ptr(x_end, ct.c_float), ptr(y_end, ct.c_float), ptr(z_end, ct.c_float),
+                                 ptr(s1actrev, ct.c_float), ptr(actfeed, ct.c_float),
+                                 ptr(timestamp, ct.c_longlong), ptr(tool_id, ct.c_int), ptr(tool_idx, ct.c_int),
+                                 ptr(flags, ct.c_ubyte), ct.c_int(count), ct.c_int(first_cut_id),
+                                 ct.c_char_p(path),
+                                 ptr(result['Area'], ct.c_float), ptr(result['Depth'], ct.c_float),
+                                 ptr(result['Width'], ct.c_float), ptr(result['Removal_Volume'], ct.c_float))
+    if simulated != count:
+        print(f"\033[1;31mERROR: Only {simulated}/{count} moves of the batch were simulated\033[0m")
+
+    return result
+
+
+def set_progress_callback(mwdll, ctx, callback):
+    """
+    set the function called by simulate_toolpath after every simulated batch
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param callback: callable(bytes_read, bytes_total, cut_id, x, y, z, tool_number, block_nr) or None
+    :return: ctypes function object, has to be kept alive as long as the callback is set
+    """
+    callback_c = progress_callback_type(callback) if callback else progress_callback_type()
+    mwdll.set_progress_callback(ctx, callback_c)
+
+    return callback_c
+
+
+def simulate_toolpath(mwdll, ctx, toolpathfile, sample_interval, istrace, path):
+    """
+    simulate a whole tool path file, parsing and decimation run in the dll
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param toolpathfile: bytes, space separated tool path file
+    :param sample_interval: int, every sample_interval-th row is simulated
+    :param istrace: bool, if record the data
+    :param path: bytes, folder of the periodic mesh snapshots
+    :return: int, number of simulated moves, -1 on error
+    """
+    mwdll.simulate_toolpath.restype = ct.c_int
+    return mwdll.simulate_toolpath(ctx, ct.c_char_p(toolpathfile), ct.c_int(sample_interval), ct.c_bool(istrace),
+                                   ct.c_char_p(path))
+
+
+def set_checkpoint_policy(mwdll, ctx, checkpoint_dir, every_moves, every_seconds):
+    """
+    set when simulate_toolpath writes a checkpoint to continue the simulation from with resume_from_checkpoint
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param checkpoint_dir: bytes, existing checkpoint folder, None disables the checkpoints
+    :param every_moves: int, checkpoint after this many simulated moves, 0 disables
+    :param every_seconds: float, checkpoint after this wall time in seconds, 0 disables
+    :return: None
+    """
+    mwdll.set_checkpoint_policy(ctx, ct.c_char_p(checkpoint_dir), ct.c_int(every_moves), ct.c_float(every_seconds))
+
+
+def load_checkpoint(mwdll, ctx, checkpoint_dir):
+    """
+    restore the stock, the feature file and the current tool of a checkpoint without continuing its tool path
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context, tools and config set up like for the checkpointed run
+    :param checkpoint_dir: bytes, checkpoint folder
+    :return: int, last simulated move of the checkpoint, -1 on error
+    """
+    mwdll.load_checkpoint.restype = ct.c_int
+    return mwdll.load_checkpoint(ctx, ct.c_char_p(checkpoint_dir))
+
+
+def resume_from_checkpoint(mwdll, ctx, checkpoint_dir):
+    """
+    continue the tool path simulation of a checkpoint where it was taken
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context, tools and config set up like for the checkpointed run
+    :param checkpoint_dir: bytes, checkpoint folder
+    :return: int, last simulated move of the whole run, -1 on error
+    """
+    mwdll.resume_from_checkpoint.restype = ct.c_int
+    return mwdll.resume_from_checkpoint(ctx, ct.c_char_p(checkpoint_dir))
+
+
+def ring_create(mwdll, name, capacity):
+    """
+    create a shared memory move ring, collectors in other processes open it with ring_open and write moves into it
+    :param mwdll: dll file
+    :param name: bytes, name of the shared memory block
+    :param capacity: int, number of moves the ring holds, rounded up to a power of two
+    :return: c_void_p, ring handle
+    """
+    mwdll.ring_create.restype = ct.c_void_p
+    ring = mwdll.ring_create(ct.c_char_p(name), ct.c_longlong(capacity))
+    if not ring:
+        raise RuntimeError(f"Could not create the move ring {name}")
+
+    return ct.c_void_p(ring)
+
+
+def ring_open(mwdll, name):
+    """
+    open a move ring created by another process
+    :param mwdll: dll file
+    :param name: bytes, name of the shared memory block
+    :return: c_void_p, ring handle
+    """
+    mwdll.ring_open.restype = ct.c_void_p
+    ring = mwdll.ring_open(ct.c_char_p(name))
+    if not ring:
+        raise RuntimeError(f"Could not open the move ring {name}")
+
+    return ct.c_void_p(ring)
+
+
+def ring_release(mwdll, ring):
+    """
+    unmap a move ring, the shared memory block is removed when its creator releases it
+    :param mwdll: dll file
+    :param ring: ring handle from ring_create or ring_open
+    :return: None
+    """
+    mwdll.ring_release(ring)
+
+
+def ring_write(mwdll, ring, records, timeout_ms=100):
+    """
+    producer side, append moves to a ring. moves that still do not fit after the timeout are counted as overruns
+    :param mwdll: dll file
+    :param ring: ring handle from ring_create or ring_open
+    :param records: numpy record array with move_record_dtype, the first move of a stream is the start position
+    :param timeout_ms: int, longest wait for free space, 0 to never wait
+    :return: int, number of moves written
+    """
+    records = np.ascontiguousarray(records, dtype=move_record_dtype)
+    mwdll.ring_write.restype = ct.c_int
+    return mwdll.ring_write(ring, records.ctypes.data_as(ct.c_void_p), ct.c_int(len(records)), ct.c_int(timeout_ms))
+
+
+def ring_close(mwdll, ring):
+    """
+    producer side, no further moves follow and simulate_ring returns once the ring is drained
+    :param mwdll: dll file
+    :param ring: ring handle from ring_create or ring_open
+    :return: None
+    """
+    mwdll.ring_close(ring)
+
+
+def ring_stats(mwdll, ring):
+    """
+    read the counters of a ring
+    :param mwdll: dll file
+    :param ring: ring handle from ring_create or ring_open
+    :return: MoveRingStats, capacity, written, read, overruns, high_water and closed
+    """
+    stats = MoveRingStats()
+    mwdll.ring_stats(ring, ct.byref(stats))
+
+    return stats
+
+
+def simulate_ring(mwdll, ctx, ring, idle_timeout_ms, path):
+    """
+    simulate the moves of a ring while the collectors write them, the moves available at once are cut as one batch
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context, stock, tools and config set up
+    :param ring: ring handle from ring_create or ring_open
+    :param idle_timeout_ms: int, end when no move arrives for this long, -1 to run until the ring is closed
+    :param path: bytes, folder of the periodic mesh snapshots
+    :return: int, last simulated move, -1 on error
+    """
+    mwdll.simulate_ring.restype = ct.c_int
+    return mwdll.simulate_ring(ctx, ring, ct.c_int(idle_timeout_ms), ct.c_char_p(path))
+
+
+def replay_toolpath(mwdll, ring, toolpathfile, sample_interval=1, rate=0., batch_size=256, istrace=True, timeout_ms=1000):
+    """
+    collector that writes a recorded tool path file into a move ring, e.g. to test the live simulation without a machine
+    :param mwdll: dll file
+    :param ring: ring handle from ring_create or ring_open
+    :param toolpathfile: str, space separated tool path file with a name row
+    :param sample_interval: int, every sample_interval-th row is written, the start and the end row are always kept
+    :param rate: float, moves per second, 0 to write as fast as the ring is drained
+    :param batch_size: int, number of moves written at once
+    :param istrace: bool, if the simulation records the moves in the feature file
+    :param timeout_ms: int, longest wait for free space per write, a batch is retried until it is written
+    :return: int, number of moves written
+    """
+    rows = np.loadtxt(toolpathfile, skiprows=1, ndmin=2)
+    if sample_interval > 1 and len(rows) > 0:
+        # the start row is kept like in the decimation of simulate_toolpath, the end row so the path is cut completely
+        keep = np.arange(0, len(rows), sample_interval)
+        if keep[-1] != len(rows) - 1:
+            keep = np.append(keep, len(rows) - 1)
+        rows = rows[keep]
+    records = np.zeros(len(rows), dtype=move_record_dtype)
+    records['Timestamp'] = rows[:, 0]
+    records['XCurrPos'] = rows[:, 1]
+    records['YCurrPos'] = rows[:, 2]
+    records['ZCurrPos'] = rows[:, 3]
+    records['S1Actrev'] = rows[:, 4]
+    records['Actfeed'] = rows[:, 5]
+    records['ToolID'] = rows[:, 6]
+    if rows.shape[1] > 7:
+        records['BlockNr'] = rows[:, 7]
+    records['Flags'] = MOVE_FLAG_CUT | MOVE_FLAG_TRACE if istrace else MOVE_FLAG_CUT
+
+    written = 0
+    start = time.monotonic()
+    for begin in range(0, len(records), batch_size):
+        if rate > 0:
+            delay = begin / rate - (time.monotonic() - start)
+            if delay > 0:
+                time.sleep(delay)
+        batch = records[begin:begin + batch_size]
+        # a full ring only takes a part of the batch, the rest is retried while the consumer drains it
+        while len(batch) > 0:
+            n = ring_write(mwdll, ring, batch, timeout_ms)
+            written += n
+            batch = batch[n:]
+            if len(batch) > 0 and ring_stats(mwdll, ring).closed:
+                raise RuntimeError(f"Move ring was closed with {len(records) - written} moves of {toolpathfile} unwritten")
+    ring_close(mwdll, ring)
+
+    return written
+
+
+def set_stats(mwdll, ctx, enabled, dump_path=None, dump_seconds=0.):
+    """
+    enable the hot path statistics and their json dump
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param enabled: bool, if time the phases, the counters are always kept
+    :param dump_path: bytes, json file rewritten every dump_seconds and when a tool path simulation ends, None disables it
+    :param dump_seconds: float, wall time between two dumps in seconds, 0 only dumps at the end
+    :return: None
+    """
+    mwdll.set_stats(ctx, ct.c_bool(enabled), ct.c_char_p(dump_path), ct.c_float(dump_seconds))
+
+
+def get_stats(mwdll, ctx):
+    """
+    read the latency summaries per phase and the counters, may be called while another thread simulates
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :return: dict, {"phases": {name: {count, total_ns, max_ns, p50_ns, p90_ns, p99_ns, p999_ns}}, "counters": {name: value}}
+    """
+    record = SimStatsRecord()
+    mwdll.get_stats(ctx, ct.byref(record))
+
+    phases = {name: {field: getattr(record.phases[i], field) for field, _ in PhaseStats._fields_}
+              for i, name in enumerate(STATS_PHASE_NAMES)}
+    counters = {name: record.counters[i] for i, name in enumerate(STATS_COUNTER_NAMES)}
+    return {"phases": phases, "counters": counters}
+
+
+def reset_stats(mwdll, ctx):
+    """
+    clear the histograms and counters
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :return: None
+    """
+    mwdll.reset_stats(ctx)
+
+
+def dump_stats(mwdll, ctx, path):
+    """
+    write the statistics as json
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param path: bytes, json file
+    :return: bool, False if the file could not be written
+    """
+    mwdll.dump_stats.restype = ct.c_bool
+    return mwdll.dump_stats(ctx, ct.c_char_p(path))
+
+
+def run_parallel(mwdll, ctxs, toolpathfiles, paths, stlfiles, sample_interval, num_threads=0):
+    """
+    simulate several independent parts at once on a work-stealing thread pool in the dll
+    :param mwdll: dll file
+    :param ctxs: list, prepared simulation context handle per part
+    :param toolpathfiles: list of bytes, tool path file per part
+    :param paths: list of bytes, folder of the periodic mesh snapshots per part
+    :param stlfiles: list of bytes, final mesh file per part (None to skip the export)
+    :param sample_interval: int, every sample_interval-th row is simulated
+    :param num_threads: int, number of parts simulated at the same time, 0 for one per core
+    :return: int, number of successfully simulated parts
+    """
+    count = len(ctxs)
+    ctxs_c = (ct.c_void_p * count)(*[ctx.value for ctx in ctxs])
+    toolpathfiles_c = (ct.c_char_p * count)(*toolpathfiles)
+    paths_c = (ct.c_char_p * count)(*paths)
+    stlfiles_c = (ct.c_char_p * count)(*stlfiles)
+
+    mwdll.run_parallel.restype = ct.c_int
+    return mwdll.run_parallel(ctxs_c, toolpathfiles_c, paths_c, stlfiles_c, ct.c_int(count),
+                              ct.c_int(sample_interval), ct.c_int(num_threads))
+
+
+def engagement_analysis(mwdll, ctx):
     """
     execute engagement analysis and record the result
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :return: None
     """
-    mwdll.engagement_analysis()
+    mwdll.engagement_analysis(ctx)
 
 
-def set_precision(mwdll, precision):
+def set_precision(mwdll, ctx, precision):
     """
     set modeling precision
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :param precision: float, precision value
     :return: None
     """
     precision_c = ct.c_float(precision)
-    mwdll.set_precision(precision_c)
+    mwdll.set_precision(ctx, precision_c)
 
 
-def set_visualization(mwdll, isvisual):
+def set_move_coalescing(mwdll, ctx, chord_tolerance, max_length, redistribute):
+    """
+    merge consecutive collinear moves into longer linear cuts before simulating them
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param chord_tolerance: float, maximum distance of a merged sample point from the merged move, 0 disables the merging
+    :param max_length: float, maximum length of a merged move, 0 for no limit
+    :param redistribute: boolean, spread the results of a merged move over its original moves or report them on the
+                         last move only, every traced sampled point gets a feature row either way
+    :return: None
+    """
+    mwdll.set_move_coalescing(ctx, ct.c_float(chord_tolerance), ct.c_float(max_length), ct.c_bool(redistribute))
+
+
+def set_arc_fitting(mwdll, ctx, tolerance, min_moves):
+    """
+    replace sampled arcs and helices in the xy plane by circular cuts before simulating them
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param tolerance: float, maximum distance of a sample point from the fitted arc or helix, 0 disables the fitting
+    :param min_moves: int, minimum number of sampled moves replaced by one circular cut
+    :return: None
+    """
+    mwdll.set_arc_fitting(ctx, ct.c_float(tolerance), ct.c_int(min_moves))
+
+
+def set_air_cut_culling(mwdll, ctx, enabled, margin, refresh_moves):
+    """
+    skip the moves whose swept tool envelope stays outside the remaining stock, they report zero engagement
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param enabled: bool, if cull the air moves
+    :param margin: float, safety distance around the tool envelope in mm
+    :param refresh_moves: int, recompute the stock box at most every refresh_moves moves, 0 at every batch
+    :return: None
+    """
+    mwdll.set_air_cut_culling(ctx, ct.c_bool(enabled), ct.c_float(margin), ct.c_int(refresh_moves))
+
+
+def get_air_cut_count(mwdll, ctx):
+    """
+    number of moves culled as air moves since set_air_cut_culling
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :return: int, number of culled moves
+    """
+    mwdll.get_air_cut_count.restype = ct.c_longlong
+    return mwdll.get_air_cut_count(ctx)
+
+
+def set_snapshot_policy(mwdll, ctx, every_moves, every_volume, every_seconds, queue_size, keyframe_interval=0):
+    """
+    set when the simulation writes the periodic mesh snapshots into the snapshot folder
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param every_moves: int, snapshot on every step index that is a multiple of every_moves, 0 disables
+    :param every_volume: float, snapshot after this removed volume (mm^3), 0 disables
+    :param every_seconds: float, snapshot after this wall time (s), 0 disables
+    :param queue_size: int, snapshots waiting for the writer thread before new ones are dropped, 0 writes them
+                       synchronously
+    :param keyframe_interval: int, every n-th snapshot is a full mesh, the others only hold the region swept since
+                              the previous snapshot (rebuild them with reconstruct_snapshot). 0 for full meshes only
+    :return: None
+    """
+    mwdll.set_snapshot_policy(ctx, ct.c_int(every_moves), ct.c_float(every_volume), ct.c_float(every_seconds),
+                              ct.c_int(queue_size), ct.c_int(keyframe_interval))
+
+
+def set_thumbnail_policy(mwdll, ctx, every_moves, every_seconds, width=256, height=256):
+    """
+    render headless progress thumbnails (no display or OpenGL needed) into the snapshot folder as <cut_id>.png, the
+    latest one is also copied to progress.png
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param every_moves: int, thumbnail after this many simulated moves, 0 disables
+    :param every_seconds: float, thumbnail after this wall time (s), 0 disables
+    :param width: int, image width in pixels
+    :param height: int, image height in pixels
+    :return: None
+    """
+    mwdll.set_thumbnail_policy(ctx, ct.c_int(every_moves), ct.c_float(every_seconds), ct.c_int(width), ct.c_int(height))
+
+
+def render_thumbnail(mwdll, ctx, pngfile):
+    """
+    render the current stock into a png file without a display
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param pngfile: bytes, encoded image file path
+    :return: bool, False if the file could not be written
+    """
+    mwdll.render_thumbnail.restype = ct.c_bool
+    return mwdll.render_thumbnail(ctx, ct.c_char_p(pngfile))
+
+
+def set_stl_format(mwdll, ctx, stl_format):
+    """
+    select the encoding of the exported mesh and of the mesh snapshots
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param stl_format: int, STL_FORMAT_BINARY or STL_FORMAT_ASCII
+    :return: None
+    """
+    mwdll.set_stl_format(ctx, ct.c_int(stl_format))
+
+
+def enable_cutting_results(mwdll, ctx, capacity):
+    """
+    stream the removed stock intervals of every cut into a buffer of the dll, call it after set_stock
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param capacity: int, number of records buffered until they are drained, 0 disables the stream
+    :return: None
+    """
+    mwdll.enable_cutting_results(ctx, ct.c_int(capacity))
+
+
+def drain_cutting_results(mwdll, ctx, max_count=65536):
+    """
+    take the oldest cutting results out of the buffer of the dll
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :param max_count: int, maximum number of records to take
+    :return: numpy record array with cutting_result_dtype, number of records dropped since the last call
+    """
+    records = np.zeros(max_count, dtype=cutting_result_dtype)
+    dropped = ct.c_longlong(0)
+    mwdll.drain_cutting_results.restype = ct.c_int
+    count = mwdll.drain_cutting_results(ctx, records.ctypes.data_as(ct.c_void_p), ct.c_int(max_count),
+                                        ct.byref(dropped))
+    if dropped.value > 0:
+        print(f"\033[1;33mWARNING: {dropped.value} cutting results were dropped, drain them more often\033[0m")
+    return records[:count], dropped.value
+
+
+def set_visualization(mwdll, ctx, isvisual):
     """
     set if show the simulation animation
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :param isvisual: boolean, setting mode
     :return: None
     """
     isvisual_c = ct.c_bool(isvisual)
-    mwdll.set_visualization(isvisual_c)
+    mwdll.set_visualization(ctx, isvisual_c)
 
 
-def visualization(mwdll, ishow_in_this_turn, viewrange):
+def visualization(mwdll, ctx, ishow_in_this_turn, viewrange):
     """
     update frame in visualization
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :param ishow_in_this_turn: boolean, if update the frame
     :param viewrange: visualized coordinate range
     :return: None
     """
     ishow_in_this_turn_c = ct.c_bool(ishow_in_this_turn)
     viewrange_c = ct.c_int(viewrange)
-    mwdll.visualization(ishow_in_this_turn_c, viewrange_c)
+    mwdll.visualization(ctx, ishow_in_this_turn_c, viewrange_c)
 
 
-def export_mesh(mwdll, stlfile):
+def export_mesh(mwdll, ctx, stlfile):
     """
     save generated CAD model
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :param stlfile: str, model file save path
     :return: None
     """
     stlfile_c = ct.c_char_p(stlfile)
-    mwdll.export_mesh(stlfile_c)
+    mwdll.export_mesh(ctx, stlfile_c)
+
+
+def get_stock_mesh(mwdll, ctx):
+    """
+    mesh the current stock and wrap it with numpy without a file. the arrays point into the dll and stay valid until
+    release_mesh is called with the handle, copy them (or build e.g. trimesh.Trimesh(points, indices)) before that
+    :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
+    :return: tuple, (handle, points, indices, normals) with the c_void_p handle, points (n, 3) float32, indices (m, 3) uint32 and face
+             normals (m, 3) float32. (None, None, None, None) if the stock could not be meshed
+    """
+    view = MeshView()
+    mwdll.get_stock_mesh.restype = ct.c_void_p
+    handle = mwdll.get_stock_mesh(ctx, ct.byref(view))
+    if not handle:
+        return None, None, None, None
+
+    def wrap(pointer, count, dtype):
+        if not count:
+            return np.zeros((0, 3), dtype=dtype)
+        return np.ctypeslib.as_array(pointer, shape=(count, 3))
+
+    return ct.c_void_p(handle), wrap(view.points, view.num_points, np.float32), wrap(view.indices, view.num_triangles, np.uint32), \
+        wrap(view.normals, view.num_triangles, np.float32)
+
+
+def release_mesh(mwdll, handle):
+    """
+    release a mesh of get_stock_mesh, its arrays must not be used afterwards
+    :param mwdll: dll file
+    :param handle: handle of get_stock_mesh
+    :return: None
+    """
+    mwdll.release_mesh(handle)
 
 
-def window_close(mwdll):
+def window_close(mwdll, ctx):
     """
     close the animation window
     :param mwdll: dll file
+    :param ctx: simulation context handle from create_context
     :return: None
     """
-    mwdll.window_close()
+    mwdll.window_close(ctx)
 
 
 def unloadMwDll(mwdll):
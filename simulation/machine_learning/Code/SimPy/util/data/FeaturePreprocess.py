@@ -3,9 +3,10 @@ import numpy as np
 import os
 import json
 
-from ...config import data_rootpath, feature_cols, label_cols, bounds, cycleTime_mw, params_lstm, \
-    train_feature_filename, std_train_feature_filename, std_padding_train_feature_filename, std_eval_feature_filename, \
-    std_padding_eval_feature_filename, eval_feature_filename
+from ... import mwwrapper
+from ...config import data_rootpath, result_sim_filename, result_sim_bin_filename, result_format_mw, feature_cols, \
+    label_cols, bounds, cycleTime_mw, params_lstm, train_feature_filename, std_train_feature_filename, \
+    std_padding_train_feature_filename, std_eval_feature_filename, std_padding_eval_feature_filename, eval_feature_filename
 
 
 class FeaturePreprocess:
@@ -25,9 +26,24 @@ class FeaturePreprocess:
             self.path = os.path.join(data_rootpath, partname, 'ResultData.txt')
         # vnck indicates data from vnck simulation result
         elif simtype == 'vnck':
-            self.path = os.path.join(data_rootpath, partname, 'SimResultData.txt')
-        self.df = pd.read_csv(self.path, sep=";", index_col='Timestamp')
+            # read the result file the simulation writes in the configured format, a file left over
+            # from a run in the other format is ignored
+            self.path = os.path.join(data_rootpath, partname, result_sim_bin_filename
+                                     if result_format_mw == 'binary' else result_sim_filename)
+
+        if self.path.endswith('.bin'):
+            records, segment_ends, angles = mwwrapper.read_binary_result(self.path)
+            self.df = pd.DataFrame({name: records[name] for name in records.dtype.names
+                                    if name not in ('SegmentEnd', 'Reserved')})
+            # binary result files since version 2 already contain the derived features computed by the simulator,
+            # the nested angle lists are then neither needed nor exported with the features
+            if 'Angle_Mean' not in self.df.columns:
+                self.df['Angles'] = mwwrapper.binary_result_angle_lists(records, segment_ends, angles)
+            self.df.set_index('Timestamp', inplace=True)
+        else:
+            self.df = pd.read_csv(self.path, sep=";", index_col='Timestamp')
 
+        self.native_features = 'Angle_Mean' in self.df.columns
 
         print(f"[\033[1;32mOK\033[0m]  Start feature preprocessing on the file {partname}.")
         print(f"*  the raw feature file has \033[1;35m{len(self.df)}\033[0m rows")
@@ -38,7 +54,11 @@ class FeaturePreprocess:
         :param col_name: str, column name for engagement angles
         :return: None
         """
-        self.df[col_name] = self.df[col_name].apply(self.str2list)
+        if self.native_features:
+            return
+        # the binary result file already provides the angles as lists
+        if self.df[col_name].map(lambda x: isinstance(x, str)).any():
+            self.df[col_name] = self.df[col_name].apply(self.str2list)
 
         print("[\033[1;32mOK\033[0m]  Convert string representation to numerical value")
 
@@ -104,6 +124,9 @@ class FeaturePreprocess:
         :param col_name: column name for engagement angles
         :return: None
         """
+        if self.native_features:
+            print(f"[\033[1;32mOK\033[0m]  {col_name} already summed up by the simulator")
+            return
         self.df[col_name] = self.df[col_name].apply(self.sum_up)
 
         print(f"[\033[1;32mOK\033[0m]  down size the list of list feature: {col_name}")
@@ -140,6 +163,9 @@ class FeaturePreprocess:
         design new feature for model learning
         :return: None
         """
+        if self.native_features:
+            print("[\033[1;32mOK\033[0m]  new features already designed by the simulator")
+            return
         self.df['Angle_Mean'] = self.df['Angles'].apply(lambda x: float(sum(x)/len(x) if x else 0))
         self.df['Angle_Sin'] = self.df['Angles'].apply(lambda x: float(sum([np.sin(i) for i in x])/len(x) if x else 0))
         self.df['Angle_Cos'] = self.df['Angles'].apply(lambda x: float(sum([np.cos(i) for i in x])/len(x) if x else 0))
@@ -153,6 +179,11 @@ class FeaturePreprocess:
         compute velocity and acceleration of every axis and spindle motor
         :return: None
         """
+        # the left merge of integrate keeps every row in order, so the differences of the simulator are still valid
+        if self.native_features:
+            print("[\033[1;32mOK\033[0m]  acceleration of various axis motors already computed by the simulator")
+            return
+
         # compute spindle acceleration
         self.df['S1ActAccel'] = self.df['S1Actrev'].diff()
         self.df['S1ActAccel'].fillna(0, inplace=True)
@@ -12,7 +12,9 @@ import sys
 import shutil
 import ctypes as ct
 from ctypes import *
-from .helper_tasks import copyDll, listStlFiles
+from simulation.machine_learning.Code.SimPy import mwwrapper
+from simulation.machine_learning.Code.SimPy.config import mwcamlib_path
+from .helper_tasks import listStlFiles
 from django.conf import settings
 
 
@@ -59,12 +61,10 @@ def runSimulation():
     instanceKey = ''.join(random.choices(
         string.ascii_uppercase + string.digits, k=10))
     print("Path to Fileparent is: ", pathToFileParent)
-    copyDll(fileName)
-    time.sleep(2)
-    mwdll2 = ct.cdll.LoadLibrary(
-        str(Path(settings.MEDIA_ROOT) / fileName / "MwCamSimLib.dll"))
+    # the dll keeps its state in a context per simulation, so all jobs share the loaded library
+    mwdll = mwwrapper.load(mwcamlib_path)
 
-    SimHandler(fileName, mwdll2, instanceKey)
+    SimHandler(fileName, mwdll, instanceKey)
 
     # pathToCsv = Path(settings.MEDIA_ROOT) / fileName / "PredData.csv"
 